@@ -29,11 +29,16 @@
 #include "tools.h"
 #include "bsy.h"
 #include "protocol.h"
+#include "protoco2.h"
+#include "binlog.h"
+#include "inbound.h"
 #include "setpttl.h"
 #include "sem.h"
 #include "ftnnode.h"
+#include "ftnq.h"
 #include "ftnaddr.h"
 #include "rfc2553.h"
+#include "iptools.h"
 #include "srv_gai.h"
 
 #ifdef HAVE_GETOPT
@@ -181,7 +186,7 @@ void usage (void)
 #elif defined(WIN32) && !defined(BINKD9X)
 	  "T"
 #endif
-	  "pqrsvmh] [-P node]"
+	  "kpqrsvmh] [-P node]"
 #if defined(WIN32)
 	  " [-S name] [-t cmd]"
 #endif
@@ -215,6 +220,8 @@ void usage (void)
 	  "  -v       be verbose / dump version and quit\n"
 	  "  -vv      dump version with compilation flags and quit\n"
 	  "  -d       dump parsed config and exit\n"
+	  "  -k       write compiled config image (config.img) and exit\n"
+	  "  -kk      check that config image is up to date and exit\n"
 	  "  -m       disable CRAM-MD5 authorization\n"
 	  "  -n       don't run binkd-client and binkd-server (check config, make polls)\n"
 	  "  -h       print this help\n"
@@ -248,6 +255,7 @@ int poll_flag = 0;		       /* Run clientmgr, make all jobs, quit
 int quiet_flag = 0;		       /* Be quiet (-q) */
 int verbose_flag = 0;		       /* Be verbose / print version (-v) */
 int dumpcfg_flag = 0;		       /* Dump parsed config */
+int cfgimg_flag = 0;		       /* Write (1) or check (2) config image (-k) */
 int checkcfg_flag = 0;		       /* exit(3) on config change (-C) */
 int no_MD5 = 0;			       /* disable MD5 flag (-m) */
 int no_crypt = 0;		       /* disable CRYPT (-r) */
@@ -266,7 +274,7 @@ int tray_flag = 0;                     /* minimize to tray */
 #endif
 #endif
 
-const char *optstring = "CchmP:pqrsvd-:?n"
+const char *optstring = "CchkmP:pqrsvd-:?n"
 #ifdef BINKD_DAEMONIZE
 			"D"
 #endif
@@ -392,6 +400,10 @@ char *parseargs (int argc, char *argv[])
 	      ++dumpcfg_flag;
 	      break;
 
+	    case 'k': /* write or check config image */
+	      ++cfgimg_flag;
+	      break;
+
 #ifdef BINKD_DAEMONIZE
 	    case 'D': /* run as unix daemon */
 	      daemon_flag = 1;
@@ -520,6 +532,18 @@ int main (int argc, char *argv[])
   /* Init for ftnnode.c */
   nodes_init ();
 
+  /* Init for ftnq.c */
+  q_init ();
+
+  /* Init for resolver cache in iptools.c */
+  dns_cache_init ();
+
+  /* Init for admission control in server.c */
+  admit_init ();
+
+  /* Init for partial files index in inbound.c */
+  inb_init ();
+
   /* Needed for getaddrinfo() in find_port() */
   if (sock_init ())
     Log (0, "sock_init: %s", TCPERR ());
@@ -534,8 +558,14 @@ int main (int argc, char *argv[])
       debug_readcfg ();
       exit(0);
     }
+    if (cfgimg_flag)
+    {
+      if (cfgimg_flag > 1)
+        Log (-1, "config image is up to date\n");
+      exit(0);
+    }
     InitLog(current_config->loglevel, current_config->conlog,
-            current_config->logpath, current_config->nolog.first);
+            current_config->logpath, current_config->nolog_set, current_config->logcat);
   }
   else if (verbose_flag)
   {
@@ -707,6 +737,9 @@ int main (int argc, char *argv[])
   signal (SIGHUP, sighandler);
 #endif
 
+  log_start ();
+  binlog_start ();
+
   if (client_flag && !server_flag)
   {
     clientmgr (0);
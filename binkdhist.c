@@ -0,0 +1,414 @@
+/*
+ *  binkdhist.c -- query the session history store of binkd
+ *
+ *  binkdhist.c is a part of binkd project
+ *
+ *  Copyright (C) 2026  Binkd development team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version. See COPYING.
+ */
+
+/*
+ * Usage: binkdhist [options] <history-file>
+ *
+ * Sums up the sessions in the store written by the "history" keyword,
+ * grouped by node (default), day, IP or status, or lists them. The time
+ * range is found with a binary search, only the records in the range are
+ * read.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "Config.h"
+#include "sys.h"
+#include "binkdhist.h"
+
+int xpmatch (char *pattern, char *string, int ncase);
+
+#define MAXMASKS 64
+
+enum { G_NODE, G_DAY, G_IP, G_STATUS, G_TOTAL, G_LIST };
+
+typedef struct {
+  char *key;
+  unsigned long sessions, failed, out;
+  unsigned long frcvd, fsent;
+  uintmax_t brcvd, bsent;
+  unsigned long time;
+} AGGR;
+
+static AGGR  *aggr;
+static int    naggr, aggr_alloc;
+static int   *hash;                     /* indexes into aggr, -1 if free */
+static int    hash_size;
+
+static FILE  *fh;
+static long   recsize;
+
+static void usage (void)
+{
+  fprintf (stderr,
+    "usage: binkdhist [-a mask]... [-f from] [-t to] [-s ok|failed]\n"
+    "                 [-g node|day|ip|status|total] [-l] history-file\n"
+    "  -a mask  only nodes matching the mask (e.g. 2:5020/*), may be repeated\n"
+    "  -f from  sessions ended at or after `from'\n"
+    "  -t to    sessions ended before `to'\n"
+    "           time is YYYY-MM-DD[ HH:MM[:SS]] or N[smhdw] back from now\n"
+    "  -s ok|failed  only successful or failed sessions\n"
+    "  -g ...   group by node (default), day, ip, status or total\n"
+    "  -l       list the sessions\n");
+  exit (1);
+}
+
+static void *xmalloc (size_t size)
+{
+  void *p = malloc (size);
+
+  if (p == NULL)
+  {
+    fprintf (stderr, "binkdhist: out of memory\n");
+    exit (2);
+  }
+  return p;
+}
+
+static unsigned get16 (unsigned char *p)
+{
+  return p[0] + p[1] * 0x100u;
+}
+
+static unsigned long get32 (unsigned char *p)
+{
+  return get16 (p) + get16 (p + 2) * 0x10000ul;
+}
+
+static uintmax_t get64 (unsigned char *p)
+{
+  return get32 (p) + (uintmax_t) get32 (p + 4) * 0x10000 * 0x10000;
+}
+
+/* Parses a time argument, returns (time_t) -1 if it is wrong */
+static time_t parse_time (char *s, time_t now)
+{
+  struct tm tm;
+  char *end;
+  long n;
+
+  memset (&tm, 0, sizeof (tm));
+  if (sscanf (s, "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+              &tm.tm_hour, &tm.tm_min, &tm.tm_sec) >= 3)
+  {
+    tm.tm_year -= 1900;
+    tm.tm_mon--;
+    tm.tm_isdst = -1;
+    return mktime (&tm);
+  }
+  n = strtol (s, &end, 10);
+  if (end == s || n < 0)
+    return (time_t) -1;
+  switch (tolower (*end))
+  {
+    case 'w': n *= 7;   /* fall through */
+    case 'd': n *= 24;  /* fall through */
+    case 'h': n *= 60;  /* fall through */
+    case 'm': n *= 60;  /* fall through */
+    case 's':
+    case '\0': break;
+    default: return (time_t) -1;
+  }
+  return now - n;
+}
+
+/* Reads the record i into buf, returns 0 on success */
+static int read_rec (long i, unsigned char *buf)
+{
+  if (fseek (fh, HIST_HDRSIZE + i * recsize, SEEK_SET) != 0)
+    return -1;
+  return fread (buf, HIST_RECSIZE, 1, fh) == 1 ? 0 : -1;
+}
+
+static unsigned long rec_end (unsigned char *rec)
+{
+  return get32 (rec + HIST_START) + get32 (rec + HIST_DURATION);
+}
+
+/* Returns the first record which ended at or after t */
+static long find_first (long n, time_t t)
+{
+  unsigned char rec[HIST_RECSIZE];
+  long lo = 0, hi = n, mid;
+
+  while (lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+    if (read_rec (mid, rec) != 0)
+      break;
+    if ((time_t) rec_end (rec) < t)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static unsigned long strhash (char *s)
+{
+  unsigned long h = 5381;
+
+  while (*s)
+    h = h * 33 + (unsigned char) *s++;
+  return h;
+}
+
+static AGGR *get_aggr (char *key)
+{
+  unsigned long i;
+  int j;
+
+  if (naggr * 2 >= hash_size)
+  {
+    int *old = hash, old_size = hash_size;
+
+    hash_size = hash_size ? hash_size * 2 : 1024;
+    hash = xmalloc (hash_size * sizeof (*hash));
+    for (j = 0; j < hash_size; j++)
+      hash[j] = -1;
+    for (j = 0; j < old_size; j++)
+      if (old[j] != -1)
+      {
+        for (i = strhash (aggr[old[j]].key) % hash_size; hash[i] != -1; i = (i + 1) % hash_size);
+        hash[i] = old[j];
+      }
+    free (old);
+  }
+  for (i = strhash (key) % hash_size; hash[i] != -1; i = (i + 1) % hash_size)
+    if (!strcmp (aggr[hash[i]].key, key))
+      return aggr + hash[i];
+  if (naggr == aggr_alloc)
+  {
+    AGGR *p;
+
+    aggr_alloc = aggr_alloc ? aggr_alloc * 2 : 256;
+    p = xmalloc (aggr_alloc * sizeof (*aggr));
+    if (naggr)
+      memcpy (p, aggr, naggr * sizeof (*aggr));
+    free (aggr);
+    aggr = p;
+  }
+  memset (aggr + naggr, 0, sizeof (*aggr));
+  aggr[naggr].key = strcpy (xmalloc (strlen (key) + 1), key);
+  hash[i] = naggr;
+  return aggr + naggr++;
+}
+
+static int cmp_aggr (const void *a, const void *b)
+{
+  return strcmp (((AGGR *) a)->key, ((AGGR *) b)->key);
+}
+
+static char *fmt_time (unsigned long t, char *buf, size_t size, char *fmt)
+{
+  time_t tt = (time_t) t;
+  struct tm *tm = localtime (&tt);
+
+  if (tm == NULL || strftime (buf, size, fmt, tm) == 0)
+    strcpy (buf, "?");
+  return buf;
+}
+
+int main (int argc, char *argv[])
+{
+  char *masks[MAXMASKS], *file = NULL, *p;
+  char addr[80], full[80 + HIST_DOMAINSZ + 1], domain[HIST_DOMAINSZ + 1];
+  char buf[64], key[128];
+  unsigned char hdr[HIST_HDRSIZE], rec[HIST_RECSIZE];
+  int nmasks = 0, status = -1, group = G_NODE, i, st;
+  time_t now = time (NULL), from = 0, to = (time_t) -1;
+  long n, first, scanned = 0;
+  unsigned long end;
+  AGGR *a, total;
+
+  for (i = 1; i < argc; i++)
+  {
+    if (argv[i][0] != '-' || argv[i][1] == '\0')
+    {
+      if (file)
+        usage ();
+      file = argv[i];
+      continue;
+    }
+    if (argv[i][2] != '\0')
+      usage ();
+    if (argv[i][1] == 'l')
+    {
+      group = G_LIST;
+      continue;
+    }
+    if (i + 1 >= argc)
+      usage ();
+    p = argv[++i];
+    switch (argv[i - 1][1])
+    {
+      case 'a':
+        if (nmasks == MAXMASKS)
+          usage ();
+        masks[nmasks++] = p;
+        break;
+      case 'f':
+      case 't':
+        if (parse_time (p, now) == (time_t) -1)
+        {
+          fprintf (stderr, "binkdhist: bad time `%s'\n", p);
+          return 1;
+        }
+        if (argv[i - 1][1] == 'f')
+          from = parse_time (p, now);
+        else
+          to = parse_time (p, now);
+        break;
+      case 's':
+        if (!strcmp (p, "ok"))
+          status = 0;
+        else if (!strcmp (p, "failed"))
+          status = 1;
+        else
+          usage ();
+        break;
+      case 'g':
+        if (!strcmp (p, "node"))
+          group = G_NODE;
+        else if (!strcmp (p, "day"))
+          group = G_DAY;
+        else if (!strcmp (p, "ip"))
+          group = G_IP;
+        else if (!strcmp (p, "status"))
+          group = G_STATUS;
+        else if (!strcmp (p, "total"))
+          group = G_TOTAL;
+        else
+          usage ();
+        break;
+      default:
+        usage ();
+    }
+  }
+  if (file == NULL)
+    usage ();
+
+  if ((fh = fopen (file, "rb")) == NULL)
+  {
+    fprintf (stderr, "binkdhist: cannot open %s: %s\n", file, strerror (errno));
+    return 2;
+  }
+  if (fread (hdr, sizeof (hdr), 1, fh) != 1 || memcmp (hdr, HIST_MAGIC, 8) != 0 ||
+      (recsize = get16 (hdr + 10)) < HIST_RECSIZE)
+  {
+    fprintf (stderr, "binkdhist: %s is not a binkd history file\n", file);
+    return 2;
+  }
+  if (get16 (hdr + 8) > HIST_VERSION)
+    fprintf (stderr, "binkdhist: warning: %s has version %u\n", file, get16 (hdr + 8));
+  fseek (fh, 0, SEEK_END);
+  n = (ftell (fh) - HIST_HDRSIZE) / recsize;
+  first = from > HIST_SLACK ? find_first (n, from - HIST_SLACK) : 0;
+
+  if (group == G_LIST)
+    printf ("%-19s %8s  %-24s %-15s %6s %12s %6s %12s %8s\n", "start", "time",
+            "address", "ip", "f.in", "bytes.in", "f.out", "bytes.out", "status");
+  for (; first < n && read_rec (first, rec) == 0; first++)
+  {
+    end = rec_end (rec);
+    if (to != (time_t) -1 && (time_t) end >= to + HIST_SLACK)
+      break;
+    scanned++;
+    if ((time_t) end < from || (to != (time_t) -1 && (time_t) end >= to))
+      continue;
+    st = rec[HIST_STATUS];
+    if (status != -1 && st != status)
+      continue;
+
+    if (get16 (rec + HIST_ADDR + 6))
+      sprintf (addr, "%u:%u/%u.%u", get16 (rec + HIST_ADDR), get16 (rec + HIST_ADDR + 2),
+               get16 (rec + HIST_ADDR + 4), get16 (rec + HIST_ADDR + 6));
+    else
+      sprintf (addr, "%u:%u/%u", get16 (rec + HIST_ADDR), get16 (rec + HIST_ADDR + 2),
+               get16 (rec + HIST_ADDR + 4));
+    memcpy (domain, rec + HIST_DOMAIN, HIST_DOMAINSZ);
+    domain[HIST_DOMAINSZ] = '\0';
+    sprintf (full, "%s@%s", addr, domain[0] ? domain : "?");
+    rec[HIST_IP + HIST_IPSZ - 1] = '\0';
+    if (nmasks)
+    {
+      for (i = 0; i < nmasks; i++)
+        if (xpmatch (masks[i], addr, 1) || xpmatch (masks[i], full, 1))
+          break;
+      if (i == nmasks)
+        continue;
+    }
+
+    switch (group)
+    {
+      case G_LIST:
+        printf ("%-19s %8lu  %-24s %-15s %6u %12" PRIuMAX " %6u %12" PRIuMAX " %8s\n",
+                fmt_time (get32 (rec + HIST_START), buf, sizeof (buf), "%Y-%m-%d %H:%M:%S"),
+                get32 (rec + HIST_DURATION), full, (char *) rec + HIST_IP,
+                get16 (rec + HIST_FRCVD), get64 (rec + HIST_RCVD),
+                get16 (rec + HIST_FSENT), get64 (rec + HIST_SENT),
+                st ? "failed" : "OK");
+        continue;
+      case G_NODE:   strcpy (key, full); break;
+      case G_DAY:    fmt_time (end, key, sizeof (key), "%Y-%m-%d"); break;
+      case G_IP:     strcpy (key, (char *) rec + HIST_IP); break;
+      case G_STATUS: strcpy (key, st ? "failed" : "OK"); break;
+      default:       strcpy (key, "total"); break;
+    }
+    a = get_aggr (key);
+    a->sessions++;
+    if (st)
+      a->failed++;
+    if (rec[HIST_FLAGS] & HIST_F_OUT)
+      a->out++;
+    a->frcvd += get16 (rec + HIST_FRCVD);
+    a->fsent += get16 (rec + HIST_FSENT);
+    a->brcvd += get64 (rec + HIST_RCVD);
+    a->bsent += get64 (rec + HIST_SENT);
+    a->time += get32 (rec + HIST_DURATION);
+  }
+  fclose (fh);
+  if (group == G_LIST)
+    return 0;
+
+  qsort (aggr, naggr, sizeof (*aggr), cmp_aggr);
+  memset (&total, 0, sizeof (total));
+  printf ("%-32s %6s %6s %6s %6s %14s %6s %14s %8s\n", "", "sess", "out",
+          "failed", "f.in", "bytes.in", "f.out", "bytes.out", "cps");
+  for (i = 0; i <= naggr; i++)
+  {
+    if (i < naggr)
+    {
+      a = aggr + i;
+      total.sessions += a->sessions; total.out += a->out;
+      total.failed += a->failed; total.frcvd += a->frcvd;
+      total.fsent += a->fsent; total.brcvd += a->brcvd;
+      total.bsent += a->bsent; total.time += a->time;
+    }
+    else if (naggr > 1 && group != G_TOTAL)
+    {
+      a = &total;
+      a->key = "total";
+    }
+    else
+      break;
+    printf ("%-32s %6lu %6lu %6lu %6lu %14" PRIuMAX " %6lu %14" PRIuMAX " %8" PRIuMAX "\n",
+            a->key, a->sessions, a->out, a->failed, a->frcvd, a->brcvd,
+            a->fsent, a->bsent, (a->brcvd + a->bsent) / (a->time ? a->time : 1));
+  }
+  fprintf (stderr, "%ld of %ld sessions read\n", scanned, n);
+  return 0;
+}
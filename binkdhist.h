@@ -0,0 +1,56 @@
+/*--------------------------------------------------------------------*/
+/*       B i n k d H i s t . h                                        */
+/*                                                                    */
+/*       Part of BinkD project                                        */
+/*       Session history store format                                 */
+/*                                                                    */
+/*       Definition file.                                             */
+/*--------------------------------------------------------------------*/
+#ifndef __BINKDHIST_H__
+#define __BINKDHIST_H__
+
+/*
+ * The session history store ("history" keyword) is a header followed by
+ * fixed-size records, one per session, appended when the session ends.
+ * The records are ordered by the end time of the session, so a time
+ * range is found with a binary search. All integers are in intel byte
+ * order, times are UTC.
+ *
+ * Header:
+ *   0  char[8]  "binkdhst"
+ *   8  u16      version
+ *  10  u16      record size
+ *  12  u32      reserved
+ */
+#define HIST_MAGIC      "binkdhst"
+#define HIST_VERSION    1
+#define HIST_HDRSIZE    16
+
+/* Record */
+#define HIST_START      0       /* u32, session start */
+#define HIST_DURATION   4       /* u32, seconds */
+#define HIST_RCVD       8       /* u32 low, u32 high, bytes received */
+#define HIST_SENT       16      /* u32 low, u32 high, bytes sent */
+#define HIST_CPS        24      /* u32, average cps of the session */
+#define HIST_FRCVD      28      /* u16, files received */
+#define HIST_FSENT      30      /* u16, files sent */
+#define HIST_ADDR       32      /* u16 zone, net, node, point */
+#define HIST_STATUS     40      /* u8, 0 OK, 1 failed */
+#define HIST_FLAGS      41      /* u8, HIST_F_* */
+#define HIST_DOMAIN     48      /* char[32], not always 0-terminated */
+#define HIST_IP         80      /* char[48], remote IP, 0-terminated */
+#define HIST_RECSIZE    128
+
+#define HIST_DOMAINSZ   32
+#define HIST_IPSZ       48
+
+#define HIST_F_OUT      1       /* outgoing session */
+#define HIST_F_SECURE   2       /* password protected session */
+
+/*
+ * Writers on several processes may append records a little out of order,
+ * readers widen the binary search by this many seconds
+ */
+#define HIST_SLACK      300
+
+#endif
@@ -22,6 +22,9 @@
 /*--------------------------------------------------------------------*/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 
 /*--------------------------------------------------------------------*/
 /*                        Local include files                         */
@@ -29,33 +32,211 @@
 
 #include "sys.h"
 #include "readcfg.h"
+#include "common.h"
 #include "iphdr.h"
 #include "protoco2.h"
+#include "protocol.h"
+#include "binkdhist.h"
 #include "binlog.h"
 #include "tools.h"
 #include "sem.h"
 
-/* Write 16-bit integer to file in intel bytes order */
-static int fput16(u16 arg, FILE *file)
+/* Store 16-bit integer to buffer in intel bytes order */
+static char *put16(char *p, u16 arg)
 {
-	if (fputc(arg & 0xff, file) == EOF) return EOF;
-	return fputc(arg >> 8, file);
+	*p++ = (char)(arg & 0xff);
+	*p++ = (char)(arg >> 8);
+	return p;
 }
 
-/* Write 32-bit integer to file in intel bytes order */
-static int fput32(u32 arg, FILE *file)
+/* Store 32-bit integer to buffer in intel bytes order */
+static char *put32(char *p, u32 arg)
 {
-	if (fput16((u16)(arg & 0xffff), file) == EOF) return EOF;
-	return fput16((u16)(arg/0x10000), file);
+	p = put16(p, (u16)(arg & 0xffff));
+	return put16(p, (u16)(arg/0x10000));
+}
+
+/*
+ * Records queued for one history file. In threaded builds with
+ * binlog-flush set, records of all sessions are collected here and
+ * appended with one write per flush interval. blsem protects the list.
+ */
+typedef struct _HISTQ HISTQ;
+struct _HISTQ {
+	HISTQ  *next;
+	char   *path;
+	char   *buf;
+	size_t  len, alloc;
+	time_t  first;          /* when the oldest queued record was added */
+	int     flush;          /* binlog-flush in effect for the file */
+	int     sync;           /* binlog-fsync in effect for the file */
+	int     store;          /* session history store, needs a header */
+};
+
+static HISTQ *histq;
+#ifdef HAVE_THREADS
+static int      hist_writer;    /* 1 running, 2 stopped */
+static EVENTSEM histwake;
+#endif
+
+/* Appends buf to the file with one write. Must be called with blsem locked */
+static int hist_write(char *path, char *buf, size_t len, int sync, int store)
+{
+	FILE *fl;
+	char hdr[HIST_HDRSIZE], *p;
+	int rc = 0;
+
+	if ((fl = fopen(path, "ab")) == NULL)
+		return -1;
+	if (store && fseek(fl, 0, SEEK_END) == 0 && ftell(fl) == 0)
+	{
+		memset(hdr, 0, sizeof(hdr));
+		memcpy(hdr, HIST_MAGIC, 8);
+		p = put16(hdr + 8, HIST_VERSION);
+		put16(p, HIST_RECSIZE);
+		if (fwrite(hdr, sizeof(hdr), 1, fl) != 1)
+			rc = -1;
+	}
+	if (rc != 0 || fwrite(buf, len, 1, fl) != 1 || fflush(fl) != 0)
+		rc = -1;
+#ifdef UNIX
+	else if (sync && fsync(fileno(fl)) != 0)
+		rc = -1;
+#else
+	UNUSED_ARG(sync);
+#endif
+	if (fclose(fl) != 0)
+		rc = -1;
+	return rc;
+}
+
+/* Writes the queued records out. Must be called with blsem locked */
+static void hist_drain(HISTQ *q)
+{
+	if (q->len && hist_write(q->path, q->buf, q->len, q->sync, q->store) != 0)
+		Log(1, "failed to write to %s: %s", q->path, strerror(errno));
+	q->len = 0;
+}
+
+/*
+ * Adds a record to a history file. Records are written at once unless
+ * the history writer is running and binlog-flush is set.
+ */
+static void hist_add(char *path, char *rec, size_t len, int store, BINKD_CONFIG *config)
+{
+	HISTQ *q;
+
+	LockSem(&blsem);
+	for (q = histq; q; q = q->next)
+		if (!strcmp(q->path, path))
+			break;
+#ifdef HAVE_THREADS
+	if (hist_writer == 1 && config->binlog_flush > 0)
+	{
+		if (q == NULL)
+		{
+			q = xalloc(sizeof(*q));
+			memset(q, 0, sizeof(*q));
+			q->path = xstrdup(path);
+			q->next = histq;
+			histq = q;
+		}
+		if (q->len + len > q->alloc)
+		{
+			q->alloc = max(q->alloc * 2, q->len + len + 1024);
+			q->buf = xrealloc(q->buf, q->alloc);
+		}
+		if (q->len == 0)
+			q->first = safe_time();
+		memcpy(q->buf + q->len, rec, len);
+		q->len += len;
+		q->flush = config->binlog_flush;
+		q->sync = config->binlog_fsync;
+		q->store = store;
+		ReleaseSem(&blsem);
+		return;
+	}
+#endif
+	if (q)
+		hist_drain(q);  /* keep the order after binlog-flush is reset */
+	if (hist_write(path, rec, len, config->binlog_fsync, store) != 0)
+		Log(1, "failed to write to %s: %s", path, strerror(errno));
+	ReleaseSem(&blsem);
+}
+
+#ifdef HAVE_THREADS
+static void hist_thread(void *arg)
+{
+	HISTQ *q;
+	time_t now;
+	int stop;
+
+	UNUSED_ARG(arg);
+	for (;;)
+	{
+		WaitSem(&histwake, 1);
+		now = safe_time();
+		LockSem(&blsem);
+		stop = hist_writer != 1;
+		for (q = histq; q; q = q->next)
+			if (q->len && (stop || now - q->first >= q->flush))
+				hist_drain(q);
+		ReleaseSem(&blsem);
+		if (stop)
+			break;
+	}
+}
+#endif
+
+/*
+ * Starts the history writer thread
+ */
+void binlog_start(void)
+{
+#ifdef HAVE_THREADS
+	if (hist_writer)
+		return;
+	InitEventSem(&histwake);
+	hist_writer = 1;
+	if (branch(hist_thread, NULL, 0) < 0)
+		hist_writer = 0;
+#endif
+}
+
+/*
+ * Writes out all queued records, call it on exit
+ */
+void binlog_stop(void)
+{
+	HISTQ *q;
+
+	LockSem(&blsem);
+#ifdef HAVE_THREADS
+	if (hist_writer == 1)
+		hist_writer = 2;
+#endif
+	while ((q = histq) != NULL)
+	{
+		hist_drain(q);
+		histq = q->next;
+		xfree(q->path);
+		xfree(q->buf);
+		free(q);
+	}
+	ReleaseSem(&blsem);
+#ifdef HAVE_THREADS
+	if (hist_writer == 2)
+		PostSem(&histwake);
+#endif
 }
 
 /*--------------------------------------------------------------------*/
-/*    static void TLogStat (char*, STATE*, char*, int)                */
+/*    static void TLogStat (int, STATE*, BINKD_CONFIG*)               */
 /*                                                                    */
 /*    Add record to T-Mail style binary log.                          */
 /*--------------------------------------------------------------------*/
 
-static void TLogStat (int status, STATE *state, char *binlogpath, int tzoff)
+static void TLogStat (int status, STATE *state, BINKD_CONFIG *config)
 {
 	struct {
 		u16    fZone;
@@ -71,9 +252,9 @@ static void TLogStat (int status, STATE *state, char *binlogpath, int tzoff)
 		u16    fStatus;
 	} TS;
 
-	FILE *fl;
+	char rec[32], *p;
 
-	if (binlogpath[0]) {
+	if (config->binlogpath[0]) {
 		TS.fStatus = 0;
 
 		if (state->to) {
@@ -99,44 +280,34 @@ static void TLogStat (int status, STATE *state, char *binlogpath, int tzoff)
 		TS.fBSent = (u32)state->bytes_sent;
 		TS.fFReceive = (u8)state->files_rcvd;
 		TS.fFSent = (u8)state->files_sent;
-		TS.fSTime = (u32)(state->start_time + tz_off(state->start_time, tzoff)*60);
+		TS.fSTime = (u32)(state->start_time + tz_off(state->start_time, config->tzoff)*60);
 		TS.fLTime = (u32)(safe_time() - state->start_time);
 		if (status) {
 			TS.fStatus |= 3;
 		}
-		LockSem(&blsem);
-		if ((fl = fopen(binlogpath,"ab")) != NULL) {
-			/* fwrite(&TS, sizeof(TS), 1, fl); */
-			/* FIXME: check retcode and set original file size
-			 * if write failed */
-			fput16(TS.fZone,     fl);
-			fput16(TS.fNet,      fl);
-			fput16(TS.fNode,     fl);
-			fput16(TS.fPoint,    fl);
-			fput32(TS.fSTime,    fl);
-			fput32(TS.fLTime,    fl);
-			fput32(TS.fBReceive, fl);
-			fput32(TS.fBSent,    fl);
-			fputc (TS.fFReceive, fl);
-			fputc (TS.fFSent,    fl);
-			fput16(TS.fStatus,   fl);
-			fclose(fl);
-			ReleaseSem(&blsem);
-		} else {
-			ReleaseSem(&blsem);
-			Log(1,"unable to open binary log file `%s'",binlogpath);
-		}
+		p = put16(rec, TS.fZone);
+		p = put16(p, TS.fNet);
+		p = put16(p, TS.fNode);
+		p = put16(p, TS.fPoint);
+		p = put32(p, TS.fSTime);
+		p = put32(p, TS.fLTime);
+		p = put32(p, TS.fBReceive);
+		p = put32(p, TS.fBSent);
+		*p++ = (char)TS.fFReceive;
+		*p++ = (char)TS.fFSent;
+		p = put16(p, TS.fStatus);
+		hist_add(config->binlogpath, rec, p - rec, 0, config);
 	}
 
 }
 
 /*--------------------------------------------------------------------*/
-/*    static void FDLogStat (STATE*, char*, char*, int)               */
+/*    static void FDLogStat (STATE*, BINKD_CONFIG*)                   */
 /*                                                                    */
 /*    Add record to FrontDoor-style binary log.                       */
 /*--------------------------------------------------------------------*/
 
-static void FDLogStat (STATE *state, char *fdinhist, char *fdouthist, int tzoff)
+static void FDLogStat (STATE *state, BINKD_CONFIG *config)
 {
 	struct
 	{
@@ -154,15 +325,15 @@ static void FDLogStat (STATE *state, char *fdinhist, char *fdouthist, int tzoff)
 		u32    Cost;
 	} std;
 
-	FILE *fp;
+	char rec[128], *p;
 	time_t t;
 
-	if (!state->fa || ((state->to && !fdouthist[0]) || (!state->to && !fdinhist[0])))
+	if (!state->fa || ((state->to && !config->fdouthist[0]) || (!state->to && !config->fdinhist[0])))
             return; /* nothing to do */
 
 	t = safe_time();
-	std.TimeStart = (u32)(state->start_time + tz_off(state->start_time, tzoff)*60);
-	std.TimeEnd = (u32)(t + tz_off(t, tzoff)*60);
+	std.TimeStart = (u32)(state->start_time + tz_off(state->start_time, config->tzoff)*60);
+	std.TimeEnd = (u32)(t + tz_off(t, config->tzoff)*60);
 	std.Zone = (u16)state->fa->z;
 	std.Net = (u16)state->fa->net;
 	std.Node = (u16)state->fa->node;
@@ -174,32 +345,66 @@ static void FDLogStat (STATE *state, char *fdinhist, char *fdouthist, int tzoff)
 	std.Sent = (u32)(state->bytes_sent);
 	std.Cost = 0; /* Let it be free :) */
 
-	LockSem(&blsem);
-	if ((fp = fopen ( state->to ? fdouthist : fdinhist, "ab" )) != NULL)
-	{
-		/* fwrite ( &std, (size_t) sizeof(std), (size_t) 1, fp); */
-		/* FIXME: check retcode and set original file size
-		 * if write failed */
-		fput16(std.Zone,       fp);
-		fput16(std.Net,        fp);
-		fput16(std.Node,       fp);
-		fput16(std.Point,      fp);
-		fwrite(std.Domain,     sizeof(std.Domain), 1, fp);
-		fput32(std.TimeStart,  fp);
-		fput32(std.TimeEnd,    fp);
-		fwrite(std.StationName,sizeof(std.StationName), 1, fp);
-		fwrite(std.StationLoc, sizeof(std.StationLoc),  1, fp);
-		fput32(std.Received,   fp);
-		fput32(std.Sent,       fp);
-		fput32(std.Cost,       fp);
-		fclose( fp );
-		ReleaseSem(&blsem);
-	}
-	else
+	p = put16(rec, std.Zone);
+	p = put16(p, std.Net);
+	p = put16(p, std.Node);
+	p = put16(p, std.Point);
+	memcpy(p, std.Domain, sizeof(std.Domain));
+	p += sizeof(std.Domain);
+	p = put32(p, std.TimeStart);
+	p = put32(p, std.TimeEnd);
+	memcpy(p, std.StationName, sizeof(std.StationName));
+	p += sizeof(std.StationName);
+	memcpy(p, std.StationLoc, sizeof(std.StationLoc));
+	p += sizeof(std.StationLoc);
+	p = put32(p, std.Received);
+	p = put32(p, std.Sent);
+	p = put32(p, std.Cost);
+	hist_add(state->to ? config->fdouthist : config->fdinhist, rec, p - rec, 0, config);
+}
+
+/*--------------------------------------------------------------------*/
+/*    static void HistStat (int, STATE*, BINKD_CONFIG*)               */
+/*                                                                    */
+/*    Add record to the session history store (see binkdhist.h).      */
+/*--------------------------------------------------------------------*/
+
+static void HistStat (int status, STATE *state, BINKD_CONFIG *config)
+{
+	char rec[HIST_RECSIZE], *p;
+	FTN_ADDR *fa = state->to ? &state->to->fa : state->fa;
+	time_t t;
+	u32 duration;
+
+	if (!config->history[0])
+		return;
+
+	t = safe_time();
+	duration = t > state->start_time ? (u32)(t - state->start_time) : 0;
+	memset(rec, 0, sizeof(rec));
+	p = put32(rec + HIST_START, (u32)state->start_time);
+	p = put32(p, duration);
+	p = put32(p, (u32)(state->bytes_rcvd & 0xffffffffUL));
+	p = put32(p, (u32)(state->bytes_rcvd / 0x10000 / 0x10000));
+	p = put32(p, (u32)(state->bytes_sent & 0xffffffffUL));
+	p = put32(p, (u32)(state->bytes_sent / 0x10000 / 0x10000));
+	p = put32(p, (u32)((state->bytes_rcvd + state->bytes_sent) / (duration ? duration : 1)));
+	p = put16(p, (u16)state->files_rcvd);
+	p = put16(p, (u16)state->files_sent);
+	if (fa)
 	{
-		ReleaseSem(&blsem);
-		Log (1, "failed to write to %s", (state->to ? fdouthist : fdinhist));
+		p = put16(p, (u16)fa->z);
+		p = put16(p, (u16)fa->net);
+		p = put16(p, (u16)fa->node);
+		put16(p, (u16)fa->p);
+		memcpy(rec + HIST_DOMAIN, fa->domain, min(strlen(fa->domain), HIST_DOMAINSZ));
 	}
+	rec[HIST_STATUS] = status ? 1 : 0;
+	rec[HIST_FLAGS] = (state->to ? HIST_F_OUT : 0) |
+	                  (state->state == P_SECURE ? HIST_F_SECURE : 0);
+	if (state->ipaddr)
+		strnzcpy(rec + HIST_IP, state->ipaddr, HIST_IPSZ);
+	hist_add(config->history, rec, sizeof(rec), 1, config);
 }
 
 /*--------------------------------------------------------------------*/
@@ -210,7 +415,8 @@ static void FDLogStat (STATE *state, char *fdinhist, char *fdouthist, int tzoff)
 
 void BinLogStat (int status, STATE *state, BINKD_CONFIG *config)
 {
-	TLogStat (status, state, config->binlogpath, config->tzoff);
-	FDLogStat (state, config->fdinhist, config->fdouthist, config->tzoff);
+	TLogStat (status, state, config);
+	FDLogStat (state, config);
+	HistStat (status, state, config);
 }
 
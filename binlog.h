@@ -10,5 +10,7 @@
 #define __BINLOG_H__
 
 void BinLogStat (int status, STATE *state, BINKD_CONFIG *config);
+void binlog_start (void);
+void binlog_stop (void);
 
 #endif
@@ -51,6 +51,108 @@ static void *thread_start(void *arg)
   F(args);
   return NULL;
 }
+
+/*
+ * Pool of session workers. Up to pool_size threads are created in
+ * advance and wait for jobs. A job is queued only if some worker is
+ * idle, otherwise a thread is branched as usual, so a long session
+ * never delays the next one.
+ */
+#define POOL_MAX 256
+
+typedef struct {
+    void (*F) (void *);
+    void *args;
+  } pool_job_t;
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+static pool_job_t pool_queue[POOL_MAX];
+static int pool_head, pool_len;
+static int pool_size, pool_workers, pool_idle;
+
+static void pool_worker (void *arg)
+{
+  pool_job_t job;
+
+  UNUSED_ARG(arg);
+  pthread_mutex_lock (&pool_mutex);
+  for (;;)
+  {
+    while (pool_len == 0 && pool_workers <= pool_size && !binkd_exit)
+    {
+      pool_idle++;
+      pthread_cond_wait (&pool_cond, &pool_mutex);
+      pool_idle--;
+    }
+    if (pool_len == 0)
+      break; /* the pool has been shrunk */
+    job = pool_queue[pool_head];
+    pool_head = (pool_head + 1) % POOL_MAX;
+    pool_len--;
+    pthread_mutex_unlock (&pool_mutex);
+    job.F (job.args);
+    pthread_mutex_lock (&pool_mutex);
+  }
+  pool_workers--;
+  pthread_mutex_unlock (&pool_mutex);
+}
+
+void pool_resize (int nworkers)
+{
+  int n;
+
+  if (nworkers > POOL_MAX)
+    nworkers = POOL_MAX;
+  else if (nworkers < 0)
+    nworkers = 0;
+  pthread_mutex_lock (&pool_mutex);
+  if (nworkers < pool_size)
+    pthread_cond_broadcast (&pool_cond);
+  pool_size = nworkers;
+  n = pool_size - pool_workers;
+  if (n > 0)
+    pool_workers += n;
+  pthread_mutex_unlock (&pool_mutex);
+  if (n > 0)
+    Log (6, "starting %i pool worker(s)", n);
+  for (; n > 0; n--)
+    if (branch (pool_worker, NULL, 0) < 0)
+    {
+      pthread_mutex_lock (&pool_mutex);
+      pool_workers -= n;
+      pthread_mutex_unlock (&pool_mutex);
+      break;
+    }
+}
+
+int pool_branch (void (*F) (void *), void *arg, size_t size)
+{
+  void *tmp = NULL;
+
+  if (size > 0)
+  {
+    if ((tmp = malloc (size)) == NULL)
+    {
+      Log (1, "malloc failed");
+      return -1;
+    }
+    memcpy (tmp, arg, size);
+  }
+  pthread_mutex_lock (&pool_mutex);
+  if (pool_idle > pool_len)
+  {
+    pool_queue[(pool_head + pool_len) % POOL_MAX].F = F;
+    pool_queue[(pool_head + pool_len) % POOL_MAX].args = tmp;
+    pool_len++;
+    pthread_cond_signal (&pool_cond);
+    pthread_mutex_unlock (&pool_mutex);
+    return 0;
+  }
+  pthread_mutex_unlock (&pool_mutex);
+  xfree (tmp);
+  return branch (F, arg, size);
+}
 #endif
 
 int branch (register void (*F) (void *), register void *arg, register size_t size)
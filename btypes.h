@@ -58,6 +58,7 @@ typedef struct _FTN_NODE FTN_NODE;
 struct _FTN_NODE
 {
   int listed;                          /* listed or added by defnode? */
+  int pwdfile;                         /* password from the passwords file */
   char *hosts;			       /* "host1:port1,host2:port2,*" */
 
   FTN_ADDR fa;
@@ -85,6 +86,9 @@ struct _FTN_NODE
   time_t recheck;
 };
 
+/* Compiled set of shell masks (readcfg.c) */
+typedef struct _MASKSET MASKSET;
+
 typedef struct _FTNQ FTNQ;
 struct _FTNQ
 {
@@ -55,14 +55,6 @@ int n_clients = 0;
 #endif
 static struct sockaddr invalidAddresses[NO_INVALID_ADDRESSES];
 
-#if defined(HAVE_FORK) && !defined(HAVE_THREADS)
-
-static void alrm (int signo)
-{
-}
-
-#endif
-
 #if defined(HAVE_THREADS)
 #define SLEEP(x) WaitSem(&wakecmgr, x)
 #else
@@ -77,7 +69,7 @@ void rel_grow_handles(int nh)
   LockSem(&fhsem);
   if (curmaxfh == 0)
   { if (DosSetRelMaxFH(&addfh, &curmaxfh))
-    { Log(1, "Cannot DosSetRelMaxFH");
+    { Logc(LOGC_NET, 1, "Cannot DosSetRelMaxFH");
       return;
     }
   }
@@ -87,9 +79,9 @@ void rel_grow_handles(int nh)
   addfh=nh;
   if (DosSetRelMaxFH(&addfh, &curmaxfh))
 #endif
-    Log(1, "Cannot grow handles to %ld (now %ld): %s", curmaxfh, addfh, strerror(errno));
+    Logc(LOGC_NET, 1, "Cannot grow handles to %ld (now %ld): %s", curmaxfh, addfh, strerror(errno));
   else
-    Log(6, "Set MaxFH to %ld (res %ld)", curmaxfh, addfh);
+    Logc(LOGC_NET, 6, "Set MaxFH to %ld (res %ld)", curmaxfh, addfh);
   ReleaseSem(&fhsem);
 }
 #endif
@@ -100,6 +92,20 @@ struct call_args
     BINKD_CONFIG *config;
 };
 
+#ifdef HAVE_THREADS
+/*
+ * Warms up the resolver cache for nodes which will be called soon
+ */
+static int prefetch_node (FTN_NODE *fn, void *arg)
+{
+  char flvr = MAXFLVR (fn->mail_flvr, fn->files_flvr);
+
+  if (flvr && tolower (flvr) != 'h' && !fn->busy && fn->hold_until < safe_time ())
+    resolve_node_prefetch (fn, (BINKD_CONFIG *) arg);
+  return 0;
+}
+#endif
+
 /*
  * Run one client loop. Return -1 to exit
  */
@@ -112,15 +118,18 @@ static int do_client(BINKD_CONFIG *config)
   {
     q_free (SCAN_LISTED, config);
     if (config->printq)
-      Log (-1, "scan\r");
+      Logc (LOGC_NET, -1, "scan\r");
     q_scan (SCAN_LISTED, config);
     config->q_present = 1;
+#ifdef HAVE_THREADS
+    foreach_node (prefetch_node, config, config);
+#endif
     if (config->printq)
     {
       LockSem (&lsem);
       q_list (stderr, SCAN_LISTED, config);
       ReleaseSem (&lsem);
-      Log (-1, "idle\r");
+      Logc (LOGC_NET, -1, "idle\r");
     }
   }
   if (n_clients < config->max_clients)
@@ -135,7 +144,7 @@ static int do_client(BINKD_CONFIG *config)
         char szDestAddr[FTN_ADDR_SZ + 1];
 
         ftnaddress_to_str (szDestAddr, &r->fa);
-        Log (4, "%s busy, skipping", szDestAddr);
+        Logc (LOGC_NET, 4, "%s busy, skipping", szDestAddr);
         return 0; /* go to the next node */
       }
       rel_grow_handles (6);
@@ -143,19 +152,22 @@ static int do_client(BINKD_CONFIG *config)
       lock_config_structure(config);
       args.node   = r;
       args.config = config;
-      if ((pid = branch (call, &args, sizeof (args))) < 0)
+      if ((pid = pool_branch (call, &args, sizeof (args))) < 0)
       {
         unlock_config_structure(config, 0);
         rel_grow_handles (-6);
         threadsafe(--n_clients);
         PostSem(&eothread);
-        Log (1, "cannot branch out");
+        Logc (LOGC_NET, 1, "cannot branch out");
         SLEEP(1);
       }
 #if !defined(DEBUGCHILD)
       else
       {
-        Log (5, "started client #%i, id=%i", n_clients, pid);
+        if (pid)
+          Logc (LOGC_NET, 5, "started client #%i, id=%i", n_clients, pid);
+        else
+          Logc (LOGC_NET, 5, "started client #%i in pool", n_clients);
 #if defined(HAVE_FORK) && !defined(HAVE_THREADS) && !defined(AMIGA)
         unlock_config_structure(config, 0); /* Forked child has own copy */
 #endif
@@ -180,7 +192,7 @@ static int do_client(BINKD_CONFIG *config)
           blocksig();
           if (q_not_empty(config) == 0)
           {
-            Log (4, "the queue is empty, quitting...");
+            Logc (LOGC_NET, 4, "the queue is empty, quitting...");
             return -1;
           }
           unblocksig();
@@ -244,7 +256,7 @@ void clientmgr (void *arg)
 #ifndef HAVE_THREADS
   setproctitle ("client manager");
 #endif
-  Log (4, "clientmgr started");
+  Logc (LOGC_NET, 4, "clientmgr started");
 
   for (;;)
   {
@@ -262,6 +274,8 @@ void clientmgr (void *arg)
         cperl = perl_init_clone(config);
 #endif
     }
+    pool_resize ((server_flag ? config->max_servers : 0) +
+                 (client_flag && !poll_flag ? config->max_clients : 0));
     status = do_client(config);
 
     if (status != 0 || binkd_exit) break;
@@ -274,7 +288,7 @@ void clientmgr (void *arg)
       checkcfg();
   }
 
-  Log (5, "downing clientmgr...");
+  Logc (LOGC_NET, 5, "downing clientmgr...");
 
 #if defined(WITH_PERL) && defined(HAVE_THREADS)
   if (server_flag && cperl)
@@ -294,25 +308,323 @@ void clientmgr (void *arg)
   exit (0);
 }
 
+/*
+ * Connection attempts to the addresses of one host are raced (RFC 8305):
+ * the next address is tried each CONN_DELAY ms while the previous
+ * attempts are still in progress, the first one that succeeds wins.
+ */
+#define CONN_DELAY      250     /* ms */
+#define CONN_MAXTRIES   4       /* simultaneous attempts per call */
+
+#ifdef WIN32
+#define CONN_INPROGRESS(e) ((e) == WSAEWOULDBLOCK)
+#define CONN_ETIMEDOUT     WSAETIMEDOUT
+#define CONN_ERR(e)        w32err(e)
+#else
+#define CONN_INPROGRESS(e) ((e) == EINPROGRESS || (e) == TCPERR_WOULDBLOCK)
+#define CONN_ETIMEDOUT     ETIMEDOUT
+#define CONN_ERR(e)        strerror(e)
+#endif
+
+struct conn_try
+{
+  int fd;
+  struct addrinfo *ai;
+  struct timeval start;
+  char addr[BINKD_FQDNLEN + 1];
+  char serv[MAXSERVNAME + 1];
+};
+
+static long ms_since (struct timeval *tv)
+{
+  struct timeval now;
+
+  gettvtime (&now);
+  return (long)(now.tv_sec - tv->tv_sec) * 1000L +
+         (long)(now.tv_usec - tv->tv_usec) / 1000L;
+}
+
+static int invalid_address (struct addrinfo *ai)
+{
+  char addrbuf[BINKD_FQDNLEN + 1];
+  int j, rc;
+
+  for (j = 0; j < NO_INVALID_ADDRESSES; j++)
+    if (0 == sockaddr_cmp_addr(ai->ai_addr, &invalidAddresses[j]))
+    {
+#ifdef AF_INET6
+      const int l = invalidAddresses[j].sa_family == AF_INET6 
+                  ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+#else
+      const int l = sizeof(struct sockaddr_in);
+#endif
+      rc = getnameinfo( &invalidAddresses[j], l, addrbuf, sizeof(addrbuf)
+                      , NULL, 0, NI_NUMERICHOST );
+      if (rc != 0)
+        Logc(LOGC_NET, 2, "Error in getnameinfo(): %s (%d)", gai_strerror(rc), rc);
+      else
+        Logc(LOGC_NET, 1, "Invalid address: %s", addrbuf);
+      return 1;
+    }
+  return 0;
+}
+
+static void conn_close (struct conn_try *t)
+{
+  del_socket(t->fd);
+  soclose (t->fd);
+  t->fd = INVALID_SOCKET;
+}
+
+static void conn_failed (struct conn_try *t, FTN_NODE *node, char *szDestAddr,
+                         const char *err, BINKD_CONFIG *config)
+{
+  if (!binkd_exit)
+  {
+    Logc (LOGC_NET, 1, "connection to %s failed: %s", szDestAddr, err);
+    Logc (LOGC_NET, 5, "%s: gave up after %li ms", t->addr, ms_since (&t->start));
+    bad_try (&node->fa, err, BAD_CALL, config);
+  }
+  conn_close (t);
+}
+
+/*
+ * Starts a non-blocking connect to t->ai.
+ * Returns 1 if connected at once, 0 if in progress, -1 on error.
+ */
+static int conn_start (struct conn_try *t, FTN_NODE *node, char *szDestAddr,
+                       char *host, char *port, int defport, char *via,
+                       BINKD_CONFIG *config)
+{
+  struct addrinfo *ai = t->ai;
+  int rc, aiErr;
+
+  if ((t->fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) == INVALID_SOCKET)
+  {
+    Logc (LOGC_NET, 1, "socket: %s", TCPERR ());
+    return -1;
+  }
+  add_socket(t->fd);
+  /* Was the socket created after close_sockets loop in exitfunc()? */
+  if (binkd_exit)
+  {
+    conn_close (t);
+    return -1;
+  }
+  rc = getnameinfo(ai->ai_addr, ai->ai_addrlen, t->addr, sizeof(t->addr),
+                   t->serv, sizeof(t->serv), NI_NUMERICHOST | NI_NUMERICSERV);
+  if (rc != 0) {
+    Logc (LOGC_NET, 2, "Error in getnameinfo(): %s (%d)", gai_strerror(rc), rc);
+    snprintf(t->addr, BINKD_FQDNLEN, "invalid");
+    *t->serv = '\0';
+  }
+
+  if (via)
+  {
+    if (defport)
+      Logc (LOGC_NET, 4, "trying %s via %s %s:%s...", host, via, t->addr, t->serv);
+    else
+      Logc (LOGC_NET, 4, "trying %s:%s via %s %s:%s...", host, port, via, t->addr, t->serv);
+  }
+  else if (defport)
+    Logc (LOGC_NET, 4, "trying %s [%s]...", host, t->addr);
+  else
+    Logc (LOGC_NET, 4, "trying %s [%s]:%s...", host, t->addr, t->serv);
+
+  /* find bind addr with matching address family */
+  if (config->bindaddr[0])
+  {
+    struct addrinfo *src_ai, src_hints;
+
+    memset((void *)&src_hints, 0, sizeof(src_hints));
+    src_hints.ai_socktype = SOCK_STREAM;
+    src_hints.ai_family = ai->ai_family;
+    src_hints.ai_protocol = IPPROTO_TCP;
+    if ((aiErr = getaddrinfo(config->bindaddr, NULL, &src_hints, &src_ai)) == 0)
+    {
+      if (bind(t->fd, src_ai->ai_addr, src_ai->ai_addrlen))
+        Logc(LOGC_NET, 4, "bind: %s", TCPERR());
+      freeaddrinfo(src_ai);
+    }
+    else
+      if (aiErr == EAI_FAMILY)
+      {
+        /* address family of target and bind address don't match */
+        conn_close (t);
+        return -1;
+      }
+      else
+        /* otherwise just warn and don't bind() */
+        Logc(LOGC_NET, 2, "bind -- getaddrinfo: %s (%d)", gai_strerror(aiErr), aiErr);
+  }
+
+  setsockopts (t->fd);
+  gettvtime (&t->start);
+  if (connect (t->fd, ai->ai_addr, ai->ai_addrlen) == 0)
+    return 1;
+  if (CONN_INPROGRESS (TCPERRNO))
+    return 0;
+  conn_failed (t, node, szDestAddr, TCPERR (), config);
+  return -1;
+}
+
+/*
+ * Connects to one of the addresses in aiHead, alternating address
+ * families; each attempt is limited by connect-timeout.
+ * Returns the connected socket (in blocking mode) or INVALID_SOCKET,
+ * numeric address and port of the peer are stored to addrbuf and servbuf.
+ */
+static int try_connect (struct addrinfo *aiHead, FTN_NODE *node, char *szDestAddr,
+                        char *host, char *port, int defport, char *via,
+                        char *addrbuf, char *servbuf, BINKD_CONFIG *config)
+{
+  struct addrinfo *ai, **cand;
+  struct conn_try t[CONN_MAXTRIES], tw;
+  struct timeval last, tv;
+  fd_set wfds, efds;
+  int n, n1, n2, i1, i2, next, nact, k, rc, err, maxfd;
+  socklen_t len;
+  long wait, left;
+  const char *errstr;
+
+  for (n = 0, ai = aiHead; ai; ai = ai->ai_next)
+    n++;
+  if (n == 0)
+    return INVALID_SOCKET;
+  cand = xalloc (n * 3 * sizeof (*cand));
+  /* split by address family: the first returned one, and the others */
+  for (n1 = n2 = 0, ai = aiHead; ai; ai = ai->ai_next)
+  {
+    if (invalid_address (ai))
+      continue;
+    if (ai->ai_family == aiHead->ai_family)
+      cand[n + n1++] = ai;
+    else
+      cand[2 * n + n2++] = ai;
+  }
+  /* and interleave them into cand[0..n) */
+  for (next = i1 = i2 = 0; i1 < n1 || i2 < n2; )
+  {
+    if (i1 < n1)
+      cand[next++] = cand[n + i1++];
+    if (i2 < n2)
+      cand[next++] = cand[2 * n + i2++];
+  }
+  n = next;
+
+  tw.fd = INVALID_SOCKET;
+  next = nact = 0;
+  while (tw.fd == INVALID_SOCKET && !binkd_exit && (next < n || nact > 0))
+  {
+    if (next < n && nact < CONN_MAXTRIES &&
+        (nact == 0 || ms_since (&last) >= CONN_DELAY))
+    {
+      t[nact].ai = cand[next++];
+      rc = conn_start (t + nact, node, szDestAddr, host, port, defport,
+                       via, config);
+      gettvtime (&last);
+      if (rc == 1)
+        tw = t[nact];
+      else if (rc == 0)
+        nact++;
+      continue;
+    }
+
+    wait = 1000;
+    if (next < n && nact < CONN_MAXTRIES)
+      wait = CONN_DELAY - ms_since (&last);
+    FD_ZERO (&wfds);
+    FD_ZERO (&efds);
+    for (maxfd = k = 0; k < nact; k++)
+    {
+      FD_SET (t[k].fd, &wfds);
+      FD_SET (t[k].fd, &efds);
+      if (t[k].fd > maxfd)
+        maxfd = t[k].fd;
+      if (config->connect_timeout)
+      {
+        left = config->connect_timeout * 1000L - ms_since (&t[k].start);
+        if (left < wait)
+          wait = left;
+      }
+    }
+    if (wait < 0)
+      wait = 0;
+    tv.tv_sec = wait / 1000;
+    tv.tv_usec = (wait % 1000) * 1000;
+    rc = select (maxfd + 1, NULL, &wfds, &efds, &tv);
+    if (rc < 0 && TCPERRNO != EINTR)
+    {
+      if (!binkd_exit)
+        Logc (LOGC_NET, 1, "select: %s", TCPERR ());
+      break;
+    }
+
+    for (k = 0; k < nact; )
+    {
+      if (rc > 0 && (FD_ISSET (t[k].fd, &wfds) || FD_ISSET (t[k].fd, &efds)))
+      {
+        err = 0;
+        len = sizeof (err);
+        if (getsockopt (t[k].fd, SOL_SOCKET, SO_ERROR, (char *) &err, &len))
+          err = TCPERRNO;
+        if (err == 0)
+        {
+          tw = t[k];
+          t[k] = t[--nact];
+          break;
+        }
+        errstr = CONN_ERR (err);
+      }
+      else if (config->connect_timeout &&
+               ms_since (&t[k].start) >= config->connect_timeout * 1000L)
+        errstr = CONN_ERR (CONN_ETIMEDOUT);
+      else
+      {
+        k++;
+        continue;
+      }
+      conn_failed (t + k, node, szDestAddr, errstr, config);
+      t[k] = t[--nact];
+    }
+  }
+
+  /* drop the attempts which lost the race */
+  for (k = 0; k < nact; k++)
+  {
+    Logc (LOGC_NET, 6, "%s: cancelled after %li ms", t[k].addr, ms_since (&t[k].start));
+    conn_close (t + k);
+  }
+  free (cand);
+
+  if (tw.fd != INVALID_SOCKET)
+  {
+    Logc (LOGC_NET, 5, "%s: connected in %li ms", tw.addr, ms_since (&tw.start));
+    setsockblock (tw.fd);
+    strnzcpy (addrbuf, tw.addr, BINKD_FQDNLEN + 1);
+    strnzcpy (servbuf, tw.serv, MAXSERVNAME + 1);
+  }
+  return tw.fd;
+}
+
 static int call0 (FTN_NODE *node, BINKD_CONFIG *config)
 {
   int sockfd = INVALID_SOCKET;
   int sock_out;
   char szDestAddr[FTN_ADDR_SZ + 1];
-  int i, j, rc, pid = -1;
+  int i, rc, pid = -1;
   char host[BINKD_FQDNLEN + 5 + 1];       /* current host/port */
   char addrbuf[BINKD_FQDNLEN + 1];
   char servbuf[MAXSERVNAME + 1];
   char *hosts;
   char *port;
   char *dst_ip = NULL;
-  const char *save_err;
 #ifdef HTTPS
   int use_proxy;
   char *proxy, *socks;
   struct addrinfo *aiProxyHead;
 #endif
-  struct addrinfo *ai, *aiNodeHead, *aiHead, hints;
+  struct addrinfo *aiNodeHead, *aiHead, hints;
   int aiErr;
 
   /* setup hints for getaddrinfo */
@@ -332,7 +644,7 @@ static int call0 (FTN_NODE *node, BINKD_CONFIG *config)
                     , &proxy, &socks
 #endif
                     )) {
-    Log(1, "call aborted by Perl on_call()");
+    Logc(LOGC_NET, 1, "call aborted by Perl on_call()");
     return 0;
   }
 #else
@@ -344,7 +656,7 @@ static int call0 (FTN_NODE *node, BINKD_CONFIG *config)
 #endif
 
   ftnaddress_to_str (szDestAddr, &node->fa);
-  Log (2, "call to %s", szDestAddr);
+  Logc (LOGC_NET, 2, "call to %s", szDestAddr);
 #ifndef HAVE_THREADS
   setproctitle ("call to %s", szDestAddr);
 #endif
@@ -369,14 +681,14 @@ static int call0 (FTN_NODE *node, BINKD_CONFIG *config)
       sport = proxy[0] ? "squid" : "socks"; /* default port */
     }
     /* resolve proxy host */
-    if ( (aiErr = srv_getaddrinfo(host, sport, &hints, &aiProxyHead)) != 0)
+    if ( (aiErr = cached_getaddrinfo(host, sport, &hints, &aiProxyHead, config)) != 0)
     {
-        Log(2, "Port %s not found, try default %d", sp, proxy[0] ? 3128 : 1080);
-        aiErr = getaddrinfo(host, proxy[0] ? "3128" : "1080", &hints, &aiProxyHead);
+        Logc(LOGC_NET, 2, "Port %s not found, try default %d", sp, proxy[0] ? 3128 : 1080);
+        aiErr = cached_getaddrinfo(host, proxy[0] ? "3128" : "1080", &hints, &aiProxyHead, config);
     }
     if (aiErr != 0)
     {
-      Log(1, "%s host %s not found", proxy[0] ? "Proxy" : "Socks", host);
+      Logc(LOGC_NET, 1, "%s host %s not found", proxy[0] ? "Proxy" : "Socks", host);
 #ifdef WITH_PERL
       xfree(hosts);
       xfree(proxy);
@@ -387,13 +699,13 @@ static int call0 (FTN_NODE *node, BINKD_CONFIG *config)
   }
 #endif
 
-  for (i = 1; sockfd == INVALID_SOCKET
+  for (i = 1; sockfd == INVALID_SOCKET && !binkd_exit
        && (rc = get_host_and_port
            (i, host, &port, hosts, &node->fa, config)) != -1; ++i)
   {
     if (rc == 0)
     {
-      Log (1, "%s: %i: error parsing host list", hosts, i);
+      Logc (LOGC_NET, 1, "%s: %i: error parsing host list", hosts, i);
       continue;
     }
 
@@ -407,13 +719,13 @@ static int call0 (FTN_NODE *node, BINKD_CONFIG *config)
       free(cmdline);
       if (pid != -1)
       {
-        Log (4, "connected");
+        Logc (LOGC_NET, 4, "connected");
         add_socket(sock_out);
         break;
       }
       if (!binkd_exit)
       {
-        Log (1, "connection to %s failed");
+        Logc (LOGC_NET, 1, "connection to %s failed");
         /* bad_try (&node->fa, "exec error", BAD_CALL, config); */
       }
       sockfd = INVALID_SOCKET;
@@ -426,11 +738,11 @@ static int call0 (FTN_NODE *node, BINKD_CONFIG *config)
     else /* don't resolve if proxy or socks specified */
 #endif
     {
-      aiErr = srv_getaddrinfo(host, port, &hints, &aiNodeHead);
+      aiErr = cached_getaddrinfo(host, port, &hints, &aiNodeHead, config);
 
       if (aiErr != 0)
       {
-        Log(2, "getaddrinfo failed: %s (%d)", gai_strerror(aiErr), aiErr);
+        Logc(LOGC_NET, 2, "getaddrinfo failed: %s (%d)", gai_strerror(aiErr), aiErr);
         bad_try(&node->fa, "Cannot getaddrinfo", BAD_CALL, config);
         continue;
       }
@@ -439,143 +751,35 @@ static int call0 (FTN_NODE *node, BINKD_CONFIG *config)
 
     /* Trying... */
 
-    for (ai = aiHead; ai != NULL && sockfd == INVALID_SOCKET; ai = ai->ai_next)
+#ifdef HTTPS
+    if (use_proxy)
     {
-      for (j = 0; j < NO_INVALID_ADDRESSES; j++)
-        if (0 == sockaddr_cmp_addr(ai->ai_addr, &invalidAddresses[j]))
-        {
-#ifdef AF_INET6
-          const int l = invalidAddresses[j].sa_family == AF_INET6 
-                      ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
-#else
-          const int l = sizeof(struct sockaddr_in);
+      char *sp = strchr(host, ':');
+      if (sp) *sp = '\0';
+    }
 #endif
-          rc = getnameinfo( &invalidAddresses[j], l, addrbuf, sizeof(addrbuf)
-                          , NULL, 0, NI_NUMERICHOST );
-          if (rc != 0)
-            Log(2, "Error in getnameinfo(): %s (%d)", gai_strerror(rc), rc);
-          else
-            Log(1, "Invalid address: %s", addrbuf);
-
-          break;
-        }
-      if (j < NO_INVALID_ADDRESSES)
-        /* try possible next address */
-        continue;
-
-      if ((sockfd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) == INVALID_SOCKET)
-      {
-        Log (1, "socket: %s", TCPERR ());
-
-        /* try possible next address */
-        continue;
-      }
-      add_socket(sockfd);
-      /* Was the socket created after close_sockets loop in exitfunc()? */
-      if (binkd_exit)
-      {
-#ifdef WITH_PERL
-        xfree(hosts);
+    sockfd = try_connect(aiHead, node, szDestAddr, host, port,
+                         port == config->oport,
 #ifdef HTTPS
-        xfree(proxy);
-        xfree(socks);
+                         use_proxy ? (proxy[0] ? "proxy" : "socks") :
 #endif
-#endif
-        freeaddrinfo(aiHead);
-        return 0;
-      }
-      rc = getnameinfo(ai->ai_addr, ai->ai_addrlen, addrbuf, sizeof(addrbuf),
-                       servbuf, sizeof(servbuf), NI_NUMERICHOST | NI_NUMERICSERV);
-      if (rc != 0) {
-        Log (2, "Error in getnameinfo(): %s (%d)", gai_strerror(rc), rc);
-        snprintf(addrbuf, BINKD_FQDNLEN, "invalid");
-        *servbuf = '\0';
-      }
-
+                         NULL, addrbuf, servbuf, config);
+    if (sockfd != INVALID_SOCKET)
+    {
+      Logc (LOGC_NET, 4, "connected");
+      sock_out = sockfd;
 #ifdef HTTPS
-      if (use_proxy)
-      {
-        char *sp = strchr(host, ':');
-        if (sp) *sp = '\0';
-        if (port == config->oport)
-          Log (4, "trying %s via %s %s:%s...", host,
-               proxy[0] ? "proxy" : "socks", addrbuf, servbuf);
-        else
-          Log (4, "trying %s:%s via %s %s:%s...", host, port,
-               proxy[0] ? "proxy" : "socks", addrbuf, servbuf);
-      }
-      else
+      if (!use_proxy)
 #endif
       {
-        if (port == config->oport)
-          Log (4, "trying %s [%s]...", host, addrbuf);
-        else
-          Log (4, "trying %s [%s]:%s...", host, addrbuf, servbuf);
         dst_ip = addrbuf;
         port = servbuf;
       }
-      /* find bind addr with matching address family */
-      if (config->bindaddr[0])
-      {
-        struct addrinfo *src_ai, src_hints;
-
-        memset((void *)&src_hints, 0, sizeof(src_hints));
-        src_hints.ai_socktype = SOCK_STREAM;
-        src_hints.ai_family = ai->ai_family;
-        src_hints.ai_protocol = IPPROTO_TCP;
-        if ((aiErr = getaddrinfo(config->bindaddr, NULL, &src_hints, &src_ai)) == 0)
-        {
-          if (bind(sockfd, src_ai->ai_addr, src_ai->ai_addrlen))
-            Log(4, "bind: %s", TCPERR());
-          freeaddrinfo(src_ai);
-        }
-        else
-          if (aiErr == EAI_FAMILY)
-            /* address family of target and bind address don't match */
-            continue;
-          else
-            /* otherwise just warn and don't bind() */
-            Log(2, "bind -- getaddrinfo: %s (%d)", gai_strerror(aiErr), aiErr);
-      }
-#if defined(HAVE_FORK) && !defined(HAVE_THREADS)
-      if (config->connect_timeout)
-      {
-        signal(SIGALRM, alrm);
-        alarm(config->connect_timeout);
-      }
-#endif
-      if (connect (sockfd, ai->ai_addr, ai->ai_addrlen) == 0)
-      {
-#if defined(HAVE_FORK) && !defined(HAVE_THREADS)
-        alarm(0);
-#endif
-        Log (4, "connected");
-        sock_out = sockfd;
-        break;
-      }
-
-#if defined(HAVE_FORK) && !defined(HAVE_THREADS)
-      if (errno == EINTR && config->connect_timeout)
-        save_err = strerror (ETIMEDOUT);
-      else
-        save_err = TCPERR ();
-      alarm(0);
-#else
-      save_err = TCPERR ();
-#endif
-      if (!binkd_exit)
-      {
-        Log (1, "connection to %s failed: %s", szDestAddr, save_err);
-        bad_try (&node->fa, save_err, BAD_CALL, config);
-      }
-      del_socket(sockfd);
-      soclose (sockfd);
-      sockfd = INVALID_SOCKET;
     }
 #ifdef HTTPS
     if (!use_proxy)
 #endif
-      freeaddrinfo(aiNodeHead);
+      cached_freeaddrinfo(aiNodeHead);
 #ifdef HTTPS
     if (sockfd != INVALID_SOCKET && use_proxy) {
       if (h_connect(sockfd, host, port, config, proxy, socks) != 0) {
@@ -590,7 +794,7 @@ static int call0 (FTN_NODE *node, BINKD_CONFIG *config)
   }
 #ifdef HTTPS
   if (use_proxy)
-    freeaddrinfo(aiProxyHead);
+    cached_freeaddrinfo(aiProxyHead);
 #endif
 #ifdef WITH_PERL
   xfree(hosts);
@@ -611,14 +815,14 @@ static int call0 (FTN_NODE *node, BINKD_CONFIG *config)
 #ifdef HAVE_WAITPID
     if (waitpid (pid, &rc, 0) == -1)
     {
-      Log (1, "waitpid(%u) error: %s", pid, strerror(errno));
+      Logc (LOGC_NET, 1, "waitpid(%u) error: %s", pid, strerror(errno));
     }
     else
     {
       if (WIFSIGNALED(rc))
-        Log (2, "process %u exited by signal %u", pid, WTERMSIG(rc));
+        Logc (LOGC_NET, 2, "process %u exited by signal %u", pid, WTERMSIG(rc));
       else
-        Log (4, "rc(%u)=%u", pid, WEXITSTATUS(rc));
+        Logc (LOGC_NET, 4, "rc(%u)=%u", pid, WEXITSTATUS(rc));
     }
 #endif
     close(sockfd);
@@ -650,7 +854,7 @@ static void call (void *arg)
   else
   {
     ftnaddress_to_str (szDestAddr, &a->node->fa);
-    Log (4, "%s busy, skipping", szDestAddr);
+    Logc (LOGC_NET, 4, "%s busy, skipping", szDestAddr);
   }
 #if defined(WITH_PERL) && defined(HAVE_THREADS)
   perl_done_clone(cperl);
@@ -663,7 +867,6 @@ static void call (void *arg)
   PostSem(&eothread);
   if (poll_flag)
     PostSem(&wakecmgr);
-  ENDTHREAD();
 #elif defined(DOS) || defined(DEBUGCHILD)
   --n_clients;
 #endif
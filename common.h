@@ -58,6 +58,18 @@ int set_break_handlers (void);
  */
 int branch (void (*) (void *), void *, size_t);
 
+/*
+ * Runs F in an idle pooled worker or branches a new one (returns 0 if
+ * the job went to the pool); pool_resize() sets the number of workers
+ */
+#ifdef WITH_PTHREADS
+int pool_branch (void (*) (void *), void *, size_t);
+void pool_resize (int);
+#else
+#define pool_branch(F, arg, size) branch (F, arg, size)
+#define pool_resize(n)
+#endif
+
 /*
  * From breaksig.c -- binkd runs this from exitlist or
  * from signal handler (Under NT)
@@ -82,6 +94,7 @@ extern int poll_flag;
 extern int inetd_flag;
 extern int quiet_flag;
 extern int verbose_flag;
+extern int cfgimg_flag;
 #ifdef BINKD_DAEMONIZE
 extern int daemon_flag;
 #endif
@@ -17,10 +17,16 @@
 #include "readcfg.h"
 #include "common.h"
 #include "ftnnode.h"
+#include "ftnq.h"
+#include "iphdr.h"
+#include "iptools.h"
 #include "bsy.h"
 #include "tools.h"
 #include "sem.h"
 #include "server.h"
+#include "protoco2.h"
+#include "binlog.h"
+#include "inbound.h"
 #ifdef WITH_PERL
 #include "perlhooks.h"
 #endif
@@ -125,6 +131,7 @@ void exitfunc (void)
       else
       {
 	Log(8, "exitfunc(): all threads finished");
+	pool_resize (0);
 	break;
       }
   }
@@ -143,6 +150,10 @@ void exitfunc (void)
     bsy_remove_all (config);
   sock_deinit ();
   nodes_deinit ();
+  q_deinit ();
+  dns_cache_deinit ();
+  admit_deinit ();
+  inb_deinit ();
   if (config)
   {
     if (*config->pid_file && pidsmgr == (int) getpid ())
@@ -154,6 +165,8 @@ void exitfunc (void)
     unlock_config_structure(config, 1);
 #endif
   }
+  binlog_stop ();
+  log_stop ();
   CleanSem (&config_sem);
   CleanSem (&hostsem);
   CleanSem (&resolvsem);
@@ -13,6 +13,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
 #include "sys.h"
 #include "readcfg.h"
@@ -23,7 +24,7 @@
 #include "ftnq.h"
 #include "iphdr.h"
 #include "rfc2553.h"
-#include "srv_gai.h"
+#include "iptools.h"
 
 #if defined(HAVE_THREADS) || defined(AMIGA)
 static MUTEXSEM NSem;
@@ -69,6 +70,109 @@ static void sort_nodes (BINKD_CONFIG *config)
   config->nNodSorted = 1;
 }
 
+/*
+ * Sorted snapshot of the node array for foreach_node(). Nodes are never
+ * freed before the config itself, so the snapshot only has to keep the
+ * array of pointers alive. It is built on demand, shared by all
+ * iterations until a node is added, and freed by the last user.
+ */
+struct _NODE_SNAP
+{
+  int refs;                     /* users + 1 while current */
+  int nNod;
+  FTN_NODE *pNod[1];
+};
+
+/*
+ * Drops a reference to the snapshot. Must be called with NSem locked.
+ */
+static void node_snap_put (struct _NODE_SNAP *snap)
+{
+  if (--snap->refs == 0)
+    free (snap);
+}
+
+/*
+ * Node hash, keyed by the address. Lookups don't depend on the order
+ * of pNodArray, so it has to be sorted only for foreach_node().
+ */
+static unsigned node_hash (FTN_ADDR *fa)
+{
+  unsigned h = 0;
+  char *s;
+
+  for (s = fa->domain; *s; s++)
+    h = h * 31 + tolower ((unsigned char) *s);
+  h = h * 31 + (unsigned) fa->z;
+  h = h * 31 + (unsigned) fa->net;
+  h = h * 31 + (unsigned) fa->node;
+  h = h * 31 + (unsigned) fa->p;
+  return h ^ (h >> 16);
+}
+
+static void node_hash_add (FTN_NODE *pn, BINKD_CONFIG *config)
+{
+  unsigned i, mask = config->nNodHash - 1;
+
+  for (i = node_hash (&pn->fa) & mask; config->pNodHash[i]; i = (i + 1) & mask);
+  config->pNodHash[i] = pn;
+}
+
+/*
+ * Keeps the hash at most half full for nNod + n nodes
+ */
+static void node_hash_grow (int n, BINKD_CONFIG *config)
+{
+  int i, size;
+
+  if ((config->nNod + n) * 2 < config->nNodHash)
+    return;
+  for (size = config->nNodHash ? config->nNodHash : 64; (config->nNod + n) * 2 >= size; size *= 2);
+  xfree (config->pNodHash);
+  config->nNodHash = size;
+  config->pNodHash = xalloc (config->nNodHash * sizeof (FTN_NODE *));
+  memset (config->pNodHash, 0, config->nNodHash * sizeof (FTN_NODE *));
+  for (i = 0; i < config->nNod; i++)
+    node_hash_add (config->pNodArray[i], config);
+}
+
+static FTN_NODE *search_for_node (FTN_ADDR *fa, BINKD_CONFIG *config)
+{
+  unsigned i, mask = config->nNodHash - 1;
+  FTN_NODE *pn;
+
+  if (config->nNodHash == 0)
+    return NULL;
+  for (i = node_hash (fa) & mask; (pn = config->pNodHash[i]) != NULL; i = (i + 1) & mask)
+    if (!ftnaddress_cmp (&pn->fa, fa))
+      return pn;
+  return NULL;
+}
+
+/*
+ * Appends a new node to pNodArray and to the hash
+ */
+static void node_insert (FTN_NODE *pn, BINKD_CONFIG *config)
+{
+  if (config->nNod >= config->nNodAlloc)
+  {
+    config->nNodAlloc = config->nNodAlloc ? config->nNodAlloc * 2 : 64;
+    config->pNodArray = xrealloc (config->pNodArray, sizeof (FTN_NODE *) * config->nNodAlloc);
+  }
+  /* before pn is counted, a rehash must not add it */
+  node_hash_grow (1, config);
+  config->pNodArray[config->nNod++] = pn;
+
+  /* We've broken the order... */
+  config->nNodSorted = 0;
+  if (config->pNodSnap)
+  {
+    node_snap_put (config->pNodSnap);
+    config->pNodSnap = NULL;
+  }
+  node_hash_add (pn, config);
+}
+
 /*
  * Add a new node, or edit old settings for a node
  */
@@ -81,21 +185,12 @@ static FTN_NODE *add_node_nolock (FTN_ADDR *fa, char *hosts, char *pwd, char *pk
 #endif
               BINKD_CONFIG *config)
 {
-  int cn;
-  FTN_NODE *pn = NULL; /* avoid compiler warning */
+  FTN_NODE *pn;
 
-  for (cn = 0; cn < config->nNod; ++cn)
-  {
-    pn = config->pNodArray[cn];
-    if (!ftnaddress_cmp (&(pn->fa), fa))
-      break;
-  }
   /* Node not found, create new entry */
-  if (cn >= config->nNod)
+  if ((pn = search_for_node (fa, config)) == NULL)
   {
-    cn = config->nNod;
-    config->pNodArray = xrealloc (config->pNodArray, sizeof (FTN_NODE *) * ++(config->nNod));
-    config->pNodArray[cn] = pn = xalloc(sizeof(FTN_NODE));
+    pn = xalloc(sizeof(FTN_NODE));
     memset (pn, 0, sizeof (FTN_NODE));
     memcpy (&(pn->fa), fa, sizeof (FTN_ADDR));
     strcpy (pn->pwd, "-");
@@ -112,12 +207,10 @@ static FTN_NODE *add_node_nolock (FTN_ADDR *fa, char *hosts, char *pwd, char *pk
 #ifdef BW_LIM
     pn->bw_send = bw_send; pn->bw_recv = bw_recv;
 #endif
-
-    /* We've broken the order... */
-    config->nNodSorted = 0;
+    node_insert (pn, config);
   }
 
-  pn->recheck = safe_time() + RESOLVE_TTL;
+  pn->recheck = safe_time() + (config->dns_cache_ttl > 0 ? config->dns_cache_ttl : RESOLVE_TTL);
   if (MD_flag != MD_USE_OLD)
     pn->MD_flag = MD_flag;
   if (restrictIP != RIP_USE_OLD)
@@ -210,51 +303,24 @@ FTN_NODE *add_node (FTN_ADDR *fa, char *hosts, char *pwd, char *pkt_pwd, char *o
   return pn;
 }
 
-static FTN_NODE *search_for_node(FTN_NODE *np, BINKD_CONFIG *config)
-{
-  FTN_NODE **npp;
-
-  npp = (FTN_NODE **) bsearch (&np, config->pNodArray, config->nNod, sizeof (FTN_NODE *),
-                               (int (*) (const void *, const void *)) node_cmp);
-  return npp ? *npp : NULL;
-}
-
 static FTN_NODE *get_defnode_info(FTN_ADDR *fa, FTN_NODE *on, BINKD_CONFIG *config)
 {
-  struct addrinfo *ai, hints;
-  int aiErr;
   FTN_NODE n, *np;
-  char host[BINKD_FQDNLEN + 1];       /* current host/port */
+  char host[BINKD_FQDNLEN + 5 + 1];   /* current host/port */
   char *port;
   int i;
 
-  /* setup hints for getaddrinfo */
-  memset((void *)&hints, 0, sizeof(hints));
-  hints.ai_family = PF_UNSPEC;
-  hints.ai_socktype = SOCK_STREAM;
-  hints.ai_protocol = IPPROTO_TCP;
-
   strcpy(n.fa.domain, "defnode");
   n.fa.z=n.fa.net=n.fa.node=n.fa.p=0;
-  np = search_for_node(&n, config);
+  np = search_for_node(&n.fa, config);
 
   if (!np) /* we don't have defnode info */
     return on;
 
+  /* warm up the resolver cache for a probable call, don't wait for it */
   for (i=1; np->hosts && get_host_and_port(i, host, &port, np->hosts, fa, config)==1; i++)
-  {
-    if (!strcmp(host, "-"))
-      continue;
+    resolve_prefetch(host, port, np->IP_afamily, config);
 
-    aiErr = srv_getaddrinfo(host, port ? port : NULL, &hints, &ai);
-    if (aiErr != 0) continue;
-    freeaddrinfo(ai);
-    sprintf (host+strlen(host), ":%s", port);
-    i=0;
-    break;
-  }
-  if (i)
-    strcpy(host, "-");
   /* following section will copy defnode parameters to the node record */
   if (on)
   { /* on contains only passwd */
@@ -280,23 +346,114 @@ static FTN_NODE *get_defnode_info(FTN_ADDR *fa, FTN_NODE *on, BINKD_CONFIG *conf
        np->bw_send, np->bw_recv,
 #endif
        config);
+  return search_for_node(fa, config);
+}
+/*
+ * Return the node as it is defined in config (no defnode lookup)
+ */
+FTN_NODE *find_node (FTN_ADDR *fa, BINKD_CONFIG *config)
+{
+  FTN_NODE *n;
+
+  locknodesem();
+  n = search_for_node(fa, config);
+  releasenodesem();
+  return n;
+}
+
+/*
+ * Copies the nodes listed in binkd config from src to dst. Passwords
+ * taken from the passwords file are not copied, so the file can be
+ * applied to dst again.
+ */
+void copy_listed_nodes (BINKD_CONFIG *dst, BINKD_CONFIG *src)
+{
+  int i;
+  FTN_NODE *pn, *on;
+
+  locknodesem();
+  for (i = 0; i < src->nNod; i++)
+  {
+    on = src->pNodArray[i];
+    if (on->listed != NL_NODE)
+      continue;
+    pn = xalloc(sizeof(FTN_NODE));
+    memcpy (pn, on, sizeof (FTN_NODE));
+    pn->hosts = on->hosts ? xstrdup (on->hosts) : NULL;
+    pn->obox = on->obox ? xstrdup (on->obox) : NULL;
+    pn->ibox = on->ibox ? xstrdup (on->ibox) : NULL;
+    pn->pipe = on->pipe ? xstrdup (on->pipe) : NULL;
+    if (on->pwdfile)
+    {
+      strcpy (pn->pwd, "-");
+      pn->pkt_pwd = pn->out_pwd = NULL;
+      pn->pwdfile = 0;
+    }
+    else
+    {
+      if (on->pkt_pwd && on->pkt_pwd != (char*)&(on->pwd))
+        pn->pkt_pwd = xstrdup (on->pkt_pwd);
+      else if (on->pkt_pwd)
+        pn->pkt_pwd = (char*)&(pn->pwd);
+      if (on->out_pwd && on->out_pwd != (char*)&(on->pwd))
+        pn->out_pwd = xstrdup (on->out_pwd);
+      else if (on->out_pwd)
+        pn->out_pwd = (char*)&(pn->pwd);
+    }
+    /* the outbound will be rescanned */
+    pn->hold_until = 0;
+    pn->busy = pn->mail_flvr = pn->files_flvr = 0;
+    node_insert (pn, dst);
+  }
+  releasenodesem();
+}
+
+/*
+ * Sets the passwords of n nodes from the passwords file. The node array
+ * and the hash are grown once for all of them, and the array is sorted
+ * once at the end.
+ */
+void add_pwd_nodes (FTN_PWD *pw, int n, BINKD_CONFIG *config)
+{
+  FTN_NODE *pn;
+  int i, had_pwd;
+
+  locknodesem();
+  if (config->nNod + n > config->nNodAlloc)
+  {
+    config->nNodAlloc = config->nNod + n;
+    config->pNodArray = xrealloc (config->pNodArray, sizeof (FTN_NODE *) * config->nNodAlloc);
+  }
+  node_hash_grow (n, config);
+  for (i = 0; i < n; i++)
+  {
+    pn = search_for_node (&pw[i].fa, config);
+    had_pwd = pn && strcmp (pn->pwd, "-");
+    pn = add_node_nolock (&pw[i].fa, NULL, pw[i].pwd, pw[i].pkt_pwd, pw[i].out_pwd,
+                  '-', NULL, NULL, NR_USE_OLD, ND_USE_OLD, MD_USE_OLD, RIP_USE_OLD,
+                  HC_USE_OLD, NP_USE_OLD, NULL, AF_USE_OLD,
+#ifdef BW_LIM
+                  BW_DEF, BW_DEF,
+#endif
+                  config);
+    if (!pn->listed)
+      pn->listed = NL_PASSWORDS;
+    if (!had_pwd && strcmp (pn->pwd, "-"))
+      pn->pwdfile = 1;
+  }
   sort_nodes (config);
-  memcpy (&n.fa, fa, sizeof (FTN_ADDR));
-  return search_for_node(&n, config);
+  releasenodesem();
 }
+
 /*
  * Return up/downlink info by fidoaddress. 0 == node not found
  */
 static FTN_NODE *get_node_info_nolock (FTN_ADDR *fa, BINKD_CONFIG *config)
 {
-  FTN_NODE n, *np;
-
-  if (!config->nNodSorted)
-    sort_nodes (config);
-  memcpy (&n.fa, fa, sizeof (FTN_ADDR));
+  FTN_NODE *np;
 
   /* search from previously stored nodes */
-  np = search_for_node(&n, config);
+  np = search_for_node(fa, config);
 
   /* not found or not in config file and recheck required ... */
   if (( !np || 
@@ -328,24 +485,28 @@ FTN_NODE *get_node_info (FTN_ADDR *fa, BINKD_CONFIG *config)
  */
 int foreach_node (int (*func) (FTN_NODE *, void *), void *arg, BINKD_CONFIG *config)
 {
-  int nNod, i, rc = 0;
-  FTN_NODE **pNodArray;
-
-  locknodesem();
-
-  if (!config->nNodSorted)
-    sort_nodes (config);
+  int i, rc = 0;
+  struct _NODE_SNAP *snap;
 
-  /* copy node array and release semaphore */
+  /* take the current snapshot and release semaphore */
   /* avoid deadlock if get_node_info() used by func() */
-  nNod = config->nNod;
-  pNodArray = xalloc(nNod * sizeof(FTN_NODE *));
-  memcpy(pNodArray, config->pNodArray, nNod * sizeof(FTN_NODE *));
+  locknodesem();
+  if ((snap = config->pNodSnap) == NULL)
+  {
+    if (!config->nNodSorted)
+      sort_nodes (config);
+    snap = xalloc (sizeof (*snap) + config->nNod * sizeof (FTN_NODE *));
+    snap->refs = 1;
+    snap->nNod = config->nNod;
+    memcpy (snap->pNod, config->pNodArray, config->nNod * sizeof (FTN_NODE *));
+    config->pNodSnap = snap;
+  }
+  snap->refs++;
   releasenodesem();
 
-  for (i = 0; i < nNod; ++i)
+  for (i = 0; i < snap->nNod; ++i)
   {
-    FTN_NODE *n = pNodArray[i];
+    FTN_NODE *n = snap->pNod[i];
 
     if (!n->hosts)
       rc = func (get_node_info(&(n->fa), config), arg);
@@ -354,7 +515,10 @@ int foreach_node (int (*func) (FTN_NODE *, void *), void *arg, BINKD_CONFIG *con
     if (rc != 0)
       break;
   }
-  xfree(pNodArray);
+
+  locknodesem();
+  node_snap_put (snap);
+  releasenodesem();
   return rc;
 }
 
@@ -412,5 +576,8 @@ void free_nodes(BINKD_CONFIG *config)
     free(node);
   }
   xfree(config->pNodArray);
+  xfree(config->pNodHash);
+  if (config->pNodSnap)
+    node_snap_put(config->pNodSnap);
 }
 
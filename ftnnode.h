@@ -31,6 +31,16 @@ void nodes_deinit (void);
  */
 FTN_NODE *get_node_info (FTN_ADDR *fa, BINKD_CONFIG *config);
 
+/*
+ * Return the node as it is defined in config (no defnode lookup)
+ */
+FTN_NODE *find_node (FTN_ADDR *fa, BINKD_CONFIG *config);
+
+/*
+ * Copy nodes listed in config without passwords from the passwords file
+ */
+void copy_listed_nodes (BINKD_CONFIG *dst, BINKD_CONFIG *src);
+
 /*
  * Add a new node, or edit old settings for a node
  */
@@ -43,6 +53,20 @@ FTN_NODE *add_node (FTN_ADDR *fa, char *hosts, char *pwd, char *pkt_pwd, char *o
 #endif
               BINKD_CONFIG *config);
 
+/*
+ * Passwords file entry
+ */
+typedef struct
+{
+  FTN_ADDR fa;
+  char *pwd, *pkt_pwd, *out_pwd;
+} FTN_PWD;
+
+/*
+ * Set the passwords of n nodes from the passwords file at once
+ */
+void add_pwd_nodes (FTN_PWD *pw, int n, BINKD_CONFIG *config);
+
 #define NL_UNLISTED  0                 /* node is unlisted (dynamically added) */
 #define NL_NODE      1                 /* node is listed in binkd config */
 #define NL_PASSWORDS 2                 /* node is listed in passwords file */
@@ -78,7 +102,7 @@ FTN_NODE *add_node (FTN_ADDR *fa, char *hosts, char *pwd, char *pkt_pwd, char *o
 #define BW_DEF     -100                /* default value: 100% */
 #endif
 
-#define RESOLVE_TTL 3600               /* DNS resolution again after 1 hour */
+#define RESOLVE_TTL 3600               /* defnode recheck if dns-cache-ttl is 0 */
 
 /*
  * Iterates through nodes while func() == 0.
@@ -25,6 +25,8 @@
 #include "tools.h"
 #include "readdir.h"
 #include "iphdr.h"
+#include "sem.h"
+#include "common.h"
 #ifdef WITH_PERL
 #include "perlhooks.h"
 #endif
@@ -36,6 +38,294 @@ static const char out_flvrs[] = "icdohICDOH";
 static FTNQ *q_add_dir (FTNQ *q, char *dir, FTN_ADDR *fa1, BINKD_CONFIG *config);
 FTNQ *q_add_file (FTNQ *q, char *filename, FTN_ADDR *fa1, char flvr, char action, char type, BINKD_CONFIG *config);
 
+/*
+ * Cache of ?lo totals for q_get_sizes(). An entry is keyed by the path
+ * of the ?lo and is valid while the ?lo keeps its mtime and size.
+ * Files may be appended (arcmail bundles) without touching the ?lo,
+ * so entries also expire after LOSIZE_TTL seconds.
+ */
+#define LOSIZE_HASH  256
+#define LOSIZE_MAX   4096
+#define LOSIZE_TTL   300
+
+typedef struct _LOSIZE LOSIZE;
+struct _LOSIZE
+{
+  LOSIZE *next;
+  time_t lo_mtime;              /* mtime of the ?lo */
+  boff_t lo_size;               /* size of the ?lo */
+  time_t checked;               /* when the totals were computed */
+  boff_t size;                  /* total size of attached files */
+  time_t time;                  /* latest mtime of attached files */
+  char path[1];
+};
+
+static LOSIZE *losize_tab[LOSIZE_HASH];
+static int losize_num;
+
+#if defined(HAVE_THREADS) || defined(AMIGA)
+static MUTEXSEM LSSem;
+static MUTEXSEM QSem;          /* node flags set by the outbound scan */
+static MUTEXSEM QDSem;
+static MUTEXSEM CSem;          /* call statistics and the call journal */
+#endif
+
+/*
+ * Call this before all others functions from this file.
+ */
+void q_init (void)
+{
+  InitSem (&LSSem);
+  InitSem (&QSem);
+  InitSem (&QDSem);
+  InitSem (&CSem);
+}
+
+static void losize_flush (void)
+{
+  int i;
+  LOSIZE *ls;
+
+  for (i = 0; i < LOSIZE_HASH; i++)
+    while ((ls = losize_tab[i]) != NULL)
+    {
+      losize_tab[i] = ls->next;
+      free (ls);
+    }
+  losize_num = 0;
+}
+
+static void qdir_flush (void);
+static void calls_close (void);
+static int calls_sync (BINKD_CONFIG *config);
+static time_t calls_hold (FTN_ADDR *fa);
+
+void q_deinit (void)
+{
+  losize_flush ();
+  qdir_flush ();
+  calls_close ();
+  CleanSem (&LSSem);
+  CleanSem (&QSem);
+  CleanSem (&QDSem);
+  CleanSem (&CSem);
+}
+
+static unsigned losize_hash (const char *path)
+{
+  unsigned h = 0;
+
+  while (*path)
+    h = h * 31 + (unsigned char) *path++;
+  return h % LOSIZE_HASH;
+}
+
+/*
+ * Looks the ?lo up in the cache. Returns 1 and fills size and mtime if
+ * the cached totals are still good, 0 otherwise.
+ */
+static int losize_get (const char *path, struct stat *lo, boff_t *size, time_t *mtime)
+{
+  LOSIZE *ls;
+  int rc = 0;
+
+  LockSem (&LSSem);
+  for (ls = losize_tab[losize_hash (path)]; ls; ls = ls->next)
+    if (!strcmp (ls->path, path))
+    {
+      if (ls->lo_mtime == lo->st_mtime && ls->lo_size == lo->st_size &&
+          ls->checked > ls->lo_mtime && safe_time () - ls->checked < LOSIZE_TTL)
+      {
+        *size = ls->size;
+        *mtime = ls->time;
+        rc = 1;
+      }
+      break;
+    }
+  ReleaseSem (&LSSem);
+  return rc;
+}
+
+static void losize_put (const char *path, struct stat *lo, time_t checked,
+                        boff_t size, time_t mtime)
+{
+  LOSIZE *ls;
+  unsigned h = losize_hash (path);
+
+  LockSem (&LSSem);
+  for (ls = losize_tab[h]; ls; ls = ls->next)
+    if (!strcmp (ls->path, path))
+      break;
+  if (!ls)
+  {
+    if (losize_num >= LOSIZE_MAX)
+      losize_flush ();
+    ls = xalloc (sizeof (LOSIZE) + strlen (path));
+    strcpy (ls->path, path);
+    ls->next = losize_tab[h];
+    losize_tab[h] = ls;
+    losize_num++;
+  }
+  ls->lo_mtime = lo->st_mtime;
+  ls->lo_size = lo->st_size;
+  ls->checked = checked;
+  ls->size = size;
+  ls->time = mtime;
+  ReleaseSem (&LSSem);
+}
+
+/*
+ * Outbound directory snapshots. q_add_dir() is called by every session
+ * for every aka and by the client manager on each rescan, each time
+ * for a whole zone outbound. A listing of the directory is kept and
+ * reused while the mtime of the directory (which changes whenever an
+ * entry is added or removed) is the same; the mtime acts as the
+ * version of the snapshot. Sessions hold a reference on the version
+ * they use, so a newer one may replace it meanwhile.
+ */
+#define QDIR_MAX     256
+
+typedef struct _QDIR QDIR;
+struct _QDIR
+{
+  QDIR *next;
+  time_t mtime;                 /* mtime of the directory */
+  time_t listed;                /* when the listing was read */
+  int refs;                     /* users + 1 while in qdir_tab */
+  int len;                      /* bytes used in names */
+  /* entries as "<t>name\0", t is 'd' for a .pnt directory, 'f' else */
+  char *names;
+  char path[1];
+};
+
+static QDIR *qdir_tab;
+static int qdir_num;
+
+static void qdir_put (QDIR *qd)
+{
+  int refs;
+
+  LockSem (&QDSem);
+  refs = --qd->refs;
+  ReleaseSem (&QDSem);
+  if (refs == 0)
+  {
+    xfree (qd->names);
+    free (qd);
+  }
+}
+
+static void qdir_flush (void)
+{
+  QDIR *qd;
+
+  while ((qd = qdir_tab) != NULL)
+  {
+    qdir_tab = qd->next;
+    qdir_put (qd);
+  }
+  qdir_num = 0;
+}
+
+static QDIR *qdir_read (char *dir)
+{
+  DIR *dp;
+  struct dirent *de;
+  QDIR *qd;
+  char buf[MAXPATHLEN + 1], *s;
+  int size = 0, l;
+
+  if ((dp = opendir (dir)) == 0)
+  {
+    Logc (LOGC_QUEUE, 1, "cannot opendir %s: %s", dir, strerror (errno));
+    return NULL;
+  }
+  qd = xalloc (sizeof (QDIR) + strlen (dir));
+  memset (qd, 0, sizeof (QDIR));
+  strcpy (qd->path, dir);
+  strnzcpy (buf, dir, sizeof (buf));
+  strnzcat (buf, PATH_SEPARATOR, sizeof (buf));
+  s = buf + strlen (buf);
+  while ((de = readdir (dp)) != 0)
+  {
+    l = strlen (de->d_name);
+    if (qd->len + l + 2 > size)
+    {
+      size = (size + l + 2) * 2;
+      qd->names = xrealloc (qd->names, size);
+    }
+    qd->names[qd->len] = 'f';
+    if (l == 12 && !STRICMP (de->d_name + 9, "pnt"))
+    {
+      strnzcpy (s, de->d_name, sizeof (buf) - (s - buf));
+      if (de_isdir (dp, de, buf) == 1)
+        qd->names[qd->len] = 'd';
+    }
+    memcpy (qd->names + qd->len + 1, de->d_name, l + 1);
+    qd->len += l + 2;
+  }
+  closedir (dp);
+  return qd;
+}
+
+/*
+ * Returns the current snapshot of the directory, qdir_put() it after use.
+ */
+static QDIR *qdir_get (char *dir)
+{
+  struct stat st;
+  QDIR *qd, **pqd;
+  time_t now = safe_time ();
+
+  if (stat (dir, &st) != 0)
+    st.st_mtime = now;          /* will not be trusted */
+  LockSem (&QDSem);
+  for (pqd = &qdir_tab; *pqd; pqd = &(*pqd)->next)
+    if (!strcmp ((*pqd)->path, dir))
+      break;
+  if ((qd = *pqd) != NULL && qd->mtime == st.st_mtime && qd->listed > qd->mtime)
+  {
+    qd->refs++;
+    ReleaseSem (&QDSem);
+    return qd;
+  }
+  ReleaseSem (&QDSem);
+
+  if ((qd = qdir_read (dir)) == NULL)
+    return NULL;
+  qd->mtime = st.st_mtime;
+  qd->listed = now;
+  qd->refs = 1;
+
+  LockSem (&QDSem);
+  for (pqd = &qdir_tab; *pqd; pqd = &(*pqd)->next)
+    if (!strcmp ((*pqd)->path, dir))
+      break;
+  if (*pqd)
+  { /* replace the old version */
+    QDIR *old = *pqd;
+
+    qd->next = old->next;
+    *pqd = qd;
+    qd->refs++;
+    if (--old->refs == 0)
+    {
+      xfree (old->names);
+      free (old);
+    }
+  }
+  else if (qdir_num < QDIR_MAX)
+  {
+    qd->next = qdir_tab;
+    qdir_tab = qd;
+    qd->refs++;
+    qdir_num++;
+  }
+  ReleaseSem (&QDSem);
+  Logc (LOGC_QUEUE, 7, "outbound snapshot of %s updated", dir);
+  return qd;
+}
+
 /*
  * q_free(): frees memory allocated by q_scan()
  */
@@ -80,28 +370,150 @@ void q_free (FTNQ *q, BINKD_CONFIG *config)
 
 /*
  * q_scan: scans outbound. Return value must be q_free()'d.
+ *
+ * The scan is split into units: one per zone outbound and one per node
+ * for its fileboxes. Each unit builds its own queue; the queues are
+ * joined in the order the units were created, so the result does not
+ * depend on whether the units were run one by one or by several
+ * threads (see scan-threads).
  */
 
-/* Need to pass two parameters: queue and config */
-struct qn_scan_params
+typedef struct
+{
+  FTN_ADDR fa;
+  char *path;                   /* outbound dir, NULL for node fileboxes */
+  FTNQ *q;
+} QSCAN_UNIT;
+
+typedef struct
 {
-  FTNQ **pq;
+  QSCAN_UNIT *units;
+  int nunits, next;
+  FTNQ *q0;                     /* SCAN_LISTED or NULL */
   BINKD_CONFIG *config;
-};
+#ifdef HAVE_THREADS
+  int running;
+  MUTEXSEM sem;
+  EVENTSEM done;
+#endif
+} QSCAN_JOB;
+
+static void qscan_add_unit (QSCAN_JOB *job, char *path, FTN_ADDR *fa)
+{
+  QSCAN_UNIT *u;
+
+  if ((job->nunits & 63) == 0)
+    job->units = xrealloc (job->units, (job->nunits + 64) * sizeof (QSCAN_UNIT));
+  u = job->units + job->nunits++;
+  memcpy (&u->fa, fa, sizeof (FTN_ADDR));
+  u->path = path ? xstrdup (path) : NULL;
+  u->q = job->q0;
+}
+
 static int qn_scan (FTN_NODE *fn, void *arg)
 {
-  struct qn_scan_params *params = arg;
+  time_t hold_until;
 
-  *(params->pq) = q_scan_boxes (*(params->pq), &fn->fa, 1, 1, params->config);
+  if ((hold_until = calls_hold (&fn->fa)) != 0)
+  {
+    LockSem (&QSem);
+    if (hold_until > fn->hold_until)
+      fn->hold_until = hold_until;
+    ReleaseSem (&QSem);
+  }
+  qscan_add_unit ((QSCAN_JOB *) arg, NULL, &fn->fa);
   return 0;
 }
 
+static void qscan_run (QSCAN_JOB *job, QSCAN_UNIT *u)
+{
+  if (u->path)
+    u->q = q_add_dir (u->q, u->path, &u->fa, job->config);
+  else
+    u->q = q_scan_boxes (u->q, &u->fa, 1, 1, job->config);
+}
+
+#ifdef HAVE_THREADS
+static void qscan_work (QSCAN_JOB *job)
+{
+  int i;
+
+  for (;;)
+  {
+    LockSem (&job->sem);
+    i = job->next++;
+    ReleaseSem (&job->sem);
+    if (i >= job->nunits)
+      break;
+    qscan_run (job, job->units + i);
+  }
+}
+
+static void qscan_thread (void *arg)
+{
+  QSCAN_JOB *job = *(QSCAN_JOB **) arg;
+
+  free (arg);
+  qscan_work (job);
+  LockSem (&job->sem);
+  job->running--;
+  ReleaseSem (&job->sem);
+  PostSem (&job->done);
+}
+
+static void qscan_parallel (QSCAN_JOB *job, int nthreads)
+{
+  QSCAN_JOB *pjob = job;
+  int i, running;
+
+  InitSem (&job->sem);
+  InitEventSem (&job->done);
+  job->running = 0;
+  for (i = 1; i < nthreads && i < job->nunits; i++)
+  {
+    LockSem (&job->sem);
+    job->running++;
+    ReleaseSem (&job->sem);
+    if (branch (qscan_thread, &pjob, sizeof (pjob)) < 0)
+    {
+      LockSem (&job->sem);
+      job->running--;
+      ReleaseSem (&job->sem);
+      break;
+    }
+  }
+  Logc (LOGC_QUEUE, 6, "scanning outbound: %d units, %d threads", job->nunits, i);
+  qscan_work (job);
+  /* wait for the helpers; the timeout covers a post we did not wait for */
+  for (;;)
+  {
+    LockSem (&job->sem);
+    running = job->running;
+    ReleaseSem (&job->sem);
+    if (running == 0)
+      break;
+    WaitSem (&job->done, 1);
+  }
+  CleanEventSem (&job->done);
+  CleanSem (&job->sem);
+}
+#endif
+
 FTNQ *q_scan (FTNQ *q, BINKD_CONFIG *config)
 {
   char *s;
   char buf[MAXPATHLEN + 1], outb_path[MAXPATHLEN + 1];
   FTN_DOMAIN *curr_domain;
-  struct qn_scan_params qn_params;
+  QSCAN_JOB job;
+  int i;
+
+  memset (&job, 0, sizeof (job));
+  job.q0 = (q == SCAN_LISTED) ? SCAN_LISTED : NULL;
+  job.config = config;
+
+  LockSem (&CSem);
+  calls_sync (config);
+  ReleaseSem (&CSem);
 
   for (curr_domain = config->pDomains.first; curr_domain; curr_domain = curr_domain->next)
   {
@@ -120,7 +532,7 @@ FTNQ *q_scan (FTNQ *q, BINKD_CONFIG *config)
 
       if ((dp = opendir (outb_path)) == 0)
       {
-	Log (1, "cannot opendir %s: %s", outb_path, strerror (errno));
+	Logc (LOGC_QUEUE, 1, "cannot opendir %s: %s", outb_path, strerror (errno));
 	continue;
       }
 
@@ -148,7 +560,7 @@ FTNQ *q_scan (FTNQ *q, BINKD_CONFIG *config)
 	  {
 	    strcpy (fa.domain, curr_domain->name);
 	    strnzcpy (buf + strlen (buf), de->d_name, sizeof (buf) - strlen (buf));
-	    q = q_add_dir (q, buf, &fa, config);
+	    qscan_add_unit (&job, buf, &fa);
 	  }
 	  *s = 0;
 	}
@@ -156,9 +568,32 @@ FTNQ *q_scan (FTNQ *q, BINKD_CONFIG *config)
       closedir (dp);
     }
   }
-  qn_params.pq     = &q;
-  qn_params.config = config;
-  foreach_node (qn_scan, &qn_params, config);
+  foreach_node (qn_scan, &job, config);
+
+#ifdef HAVE_THREADS
+  if (config->scan_threads > 1 && job.nunits > 1)
+    qscan_parallel (&job, config->scan_threads);
+  else
+#endif
+  for (i = 0; i < job.nunits; i++)
+    qscan_run (&job, job.units + i);
+
+  /* join the queues: files of later units go first, as q_add_file()
+   * always inserts at the head */
+  for (i = 0; i < job.nunits; i++)
+  {
+    FTNQ *head = job.units[i].q, *tail;
+
+    xfree (job.units[i].path);
+    if (q == SCAN_LISTED || head == NULL)
+      continue;
+    for (tail = head; tail->next; tail = tail->next);
+    tail->next = q;
+    if (q)
+      q->prev = tail;
+    q = head;
+  }
+  xfree (job.units);
   return q;
 }
 
@@ -251,14 +686,13 @@ static FTNQ *q_scan_box (FTNQ *q, FTN_ADDR *fa, char *boxpath, char flvr, int de
   DIR *dp;
   char buf[MAXPATHLEN + 1], *s;
   struct dirent *de;
-  struct stat sb;
 
   strnzcpy (buf, boxpath, sizeof (buf));
   strnzcat (buf, PATH_SEPARATOR, sizeof (buf));
 #ifdef UNIX
   if (access(boxpath, R_OK | W_OK) != 0) {
     if (access(boxpath, F_OK) == 0)
-      Log (1, "No access to filebox `%s'", boxpath);
+      Logc (LOGC_QUEUE, 1, "No access to filebox `%s'", boxpath);
     return q;
   }
 #endif
@@ -267,17 +701,14 @@ static FTNQ *q_scan_box (FTNQ *q, FTN_ADDR *fa, char *boxpath, char flvr, int de
   {
     while ((de = readdir (dp)) != 0)
     {
-      sb.st_mtime = 0; /* ??? val: don't know how to get it if stat() isn't used */
       strnzcat (buf, de->d_name, sizeof (buf));
       if (de->d_name[0] != '.'
 #if defined(_MSC_VER) || defined(DOS)
           && (de->d_attrib & 0x1a) == 0 /* not hidden, directory or volume label */
 #elif defined(OS2) && !defined(IBMC) && !defined(__WATCOMC__)
           && (de->d_attr & 0x1a) == 0   /* not hidden, directory or volume label */
-#elif defined(__FreeBSD__)
-          && (DTTOIF(de->d_type) & S_IFDIR) == 0  /* not directory */
 #else
-          && stat(buf, &sb) == 0 && (sb.st_mode & S_IFDIR) == 0 /* not directory */
+          && de_isdir (dp, de, buf) == 0 /* not directory */
 #endif
          )
       {
@@ -289,9 +720,9 @@ static FTNQ *q_scan_box (FTNQ *q, FTN_ADDR *fa, char *boxpath, char flvr, int de
     closedir (dp);
     if (n_files == 0 && deleteempty) {
       if (rmdir (boxpath) == 0)
-        Log (3, "Empty filebox %s deleted", boxpath);
+        Logc (LOGC_QUEUE, 3, "Empty filebox %s deleted", boxpath);
       else
-        Log (1, "Cannot delete empty filebox %s: %s", boxpath, strerror (errno));
+        Logc (LOGC_QUEUE, 1, "Cannot delete empty filebox %s: %s", boxpath, strerror (errno));
     }
   }
   return q;
@@ -404,20 +835,20 @@ void process_hld (FTN_ADDR *fa, char *path, BINKD_CONFIG *config)
     if ((f = fopen (path, "r")) == NULL ||
 	fscanf (f, "%ld", &hold_until_tmp) != 1)
     {
-      node->hold_until = 0;
-    }
-    else
-    {
-      node->hold_until = (time_t)hold_until_tmp;
+      hold_until_tmp = 0;
     }
     if (f)
       fclose (f);
 
-    if (node->hold_until <= safe_time())
+    if ((time_t)hold_until_tmp <= safe_time())
     {
-      node->hold_until = 0;
+      hold_until_tmp = 0;
       delete (path);
     }
+    LockSem (&QSem);
+    if ((time_t)hold_until_tmp > node->hold_until)
+      node->hold_until = (time_t)hold_until_tmp;
+    ReleaseSem (&QSem);
   }
 }
 
@@ -433,15 +864,18 @@ static void process_bsy (FTN_ADDR *fa, char *path, BINKD_CONFIG *config)
     char buf[FTN_ADDR_SZ + 1];
 
     ftnaddress_to_str (buf, fa);
-    Log (2, "found old %s file for %s", s, buf);
+    Logc (LOGC_QUEUE, 2, "found old %s file for %s", s, buf);
     delete (path);
   }
   else
   {
-    if ((node = get_node_info (fa, config)) != 0 && node->busy != 'b' &&
+    if ((node = get_node_info (fa, config)) != 0 &&
 	   (!STRICMP (s, ".bsy") || !STRICMP (s, ".csy")))
     {
-      node->busy = tolower (s[1]);
+      LockSem (&QSem);
+      if (node->busy != 'b')
+        node->busy = tolower (s[1]);
+      ReleaseSem (&QSem);
     }
   }
 }
@@ -457,32 +891,31 @@ static void process_bsy (FTN_ADDR *fa, char *path, BINKD_CONFIG *config)
  */
 static FTNQ *q_add_dir (FTNQ *q, char *dir, FTN_ADDR *fa1, BINKD_CONFIG *config)
 {
-  DIR *dp;
+  QDIR *qd;
   FTN_ADDR fa2;
   char buf[MAXPATHLEN + 1];
   int j;
-  char *s;
+  char *s, *p, *name;
 
-  if ((dp = opendir (dir)) != 0)
+  if ((qd = qdir_get (dir)) != NULL)
   {
-    struct dirent *de;
-
-    while ((de = readdir (dp)) != 0)
+    for (p = qd->names; p < qd->names + qd->len; p += strlen (p) + 1)
     {
+      name = p + 1;
 #ifdef AMIGADOS_4D_OUTBOUND
       if (config->aso)
       {
         char ext[4];
         int matched = 0;
-        size_t nlen = strlen(s = de->d_name);
+        size_t nlen = strlen(s = name);
 
 	for (; *s && isgraph(*s) != 0; s++);
-	if ((size_t)(s - de->d_name) != nlen)
+	if ((size_t)(s - name) != nlen)
 	  continue;
 
         memcpy (&fa2, fa1, sizeof(FTN_ADDR));
 
-        if (sscanf(s = de->d_name, "%u.%u.%u.%u.%3s%n",
+        if (sscanf(s = name, "%u.%u.%u.%u.%3s%n",
 	         (unsigned*)(&fa2.z), (unsigned*)(&fa2.net), (unsigned*)(&fa2.node),
 	         (unsigned*)(&fa2.p), ext, &matched) != 5 ||
 	    (size_t)matched != nlen || strlen(ext) != 3)
@@ -526,7 +959,7 @@ static FTNQ *q_add_dir (FTNQ *q, char *dir, FTN_ADDR *fa1, BINKD_CONFIG *config)
       else
 #endif /* AMIGADOS_4D_OUTBOUND */
       {
-        s = de->d_name;
+        s = name;
 
         for (j = 0; j < 8; ++j)
 	  if (!isxdigit (s[j]))
@@ -535,7 +968,7 @@ static FTNQ *q_add_dir (FTNQ *q, char *dir, FTN_ADDR *fa1, BINKD_CONFIG *config)
         if (j != 8 || strlen(s) != 12 || s[8] != '.' || strchr(s+9, '.'))
 	  continue;
 
-	/* fa2 will store dest.address for the current (de->d_name) file */
+	/* fa2 will store dest.address for the current (name) file */
 	memcpy (&fa2, fa1, sizeof (FTN_ADDR));
 
 	if (fa1->node != -1 && fa1->p != 0)
@@ -554,9 +987,7 @@ static FTNQ *q_add_dir (FTNQ *q, char *dir, FTN_ADDR *fa1, BINKD_CONFIG *config)
 
 	if (!STRICMP (s + 9, "pnt") && fa2.p == -1)
 	{
-	  struct stat sb;
-
-	  if (stat (buf, &sb) == 0 && sb.st_mode & S_IFDIR)
+	  if (*p == 'd')
 	    q = q_add_dir (q, buf, &fa2, config);
 	  continue;
 	}
@@ -594,10 +1025,8 @@ static FTNQ *q_add_dir (FTNQ *q, char *dir, FTN_ADDR *fa1, BINKD_CONFIG *config)
 	}
       }
     }
-    closedir (dp);
+    qdir_put (qd);
   }
-  else
-    Log (1, "cannot opendir %s: %s", dir, strerror (errno));
   return q;
 }
 
@@ -641,23 +1070,23 @@ FTNQ *q_add_file (FTNQ *q, char *filename, FTN_ADDR *fa1, char flvr, char action
 
       f = fopen(filename, "r");
       if (f == NULL)
-      { Log(1, "Can't open %s: %s", filename, strerror(errno));
+      { Logc(LOGC_QUEUE, 1, "Can't open %s: %s", filename, strerror(errno));
         return q;
       }
       if (!fgets(str, sizeof(str), f))
-      { Log(1, "Incorrect status (can't fgets), ignored");
+      { Logc(LOGC_QUEUE, 1, "Incorrect status (can't fgets), ignored");
         fclose(f);
         return q;
       }
       fclose(f);
       if (*str && isspace(*str))
-      { Log(1, "Incorrect status (space first), ignored");
+      { Logc(LOGC_QUEUE, 1, "Incorrect status (space first), ignored");
         return q;
       }
       for (p=str+strlen(str)-1; isspace(*p); *p--='\0');
-      Log(2, "Status is '%s'", str);
+      Logc(LOGC_QUEUE, 2, "Status is '%s'", str);
       if (!parse_args (argc, argv, str, "Status"))
-      { Log(1, "Incorrect status, ignored");
+      { Logc(LOGC_QUEUE, 1, "Incorrect status, ignored");
         return q;
       }
     }
@@ -692,10 +1121,12 @@ FTNQ *q_add_file (FTNQ *q, char *filename, FTN_ADDR *fa1, char flvr, char action
 
     if ((node = get_node_info (fa1, config)) != NULL)
     {
+      LockSem (&QSem);
       if (type == 'm')
 	node->mail_flvr = MAXFLVR (flvr, node->mail_flvr);
       else
 	node->files_flvr = MAXFLVR (flvr, node->files_flvr);
+      ReleaseSem (&QSem);
     }
   }
   return q;
@@ -882,11 +1313,17 @@ void q_get_sizes (FTNQ *q, uintmax_t *netsize, uintmax_t *filessize)
     if (curr->type == 'l')
     { FILE *f;
       char str[MAXPATHLEN+2];
+      struct stat lo;
+      time_t checked;
 
       if (curr->size)
         *filessize += curr->size;
+      else if (stat(curr->path, &lo) == 0 &&
+               losize_get(curr->path, &lo, &curr->size, &curr->time))
+        *filessize += curr->size;
       else if ((f = fopen(curr->path, "r")) != NULL)
       {
+        checked = safe_time();
         curr->size = 0;
         curr->time = 0;
         while (fgets (str, sizeof(str), f))
@@ -901,6 +1338,8 @@ void q_get_sizes (FTNQ *q, uintmax_t *netsize, uintmax_t *filessize)
             if (st.st_mtime > curr->time) curr->time = st.st_mtime;
           }
         }
+        if (fstat(fileno(f), &lo) == 0)
+          losize_put(curr->path, &lo, checked, curr->size, curr->time);
         fclose(f);
       }
     }
@@ -1009,19 +1448,320 @@ int create_poll (FTN_ADDR *fa, int flvr, BINKD_CONFIG *config)
     if (stat (buf, &st) == 0) return 1; /* already exists */
     if ((rc = create_empty_sem_file (buf)) == 0)
       if (errno != EEXIST)
-        Log (1, "cannot create %s: %s", buf, strerror (errno));
+        Logc (LOGC_QUEUE, 1, "cannot create %s: %s", buf, strerror (errno));
   }
   else
-    Log (1, "%s: unknown domain", fa->domain);
+    Logc (LOGC_QUEUE, 1, "%s: unknown domain", fa->domain);
   return rc;
 }
 
 /*
- * Set .hld for a node
+ * Call statistics of the nodes. With call-journal the try counters and
+ * the holds of the nodes are kept here instead of .try and .hld files.
+ * Every change is appended to the journal as a complete record of the
+ * node, the last record of a node wins. Clients of the fork versions
+ * append to the same journal, so the parent reads it up on each scan.
  */
-void hold_node (FTN_ADDR *fa, time_t hold_until, BINKD_CONFIG *config)
+#define CALLS_HASH     256
+#define CALLS_MAXSHIFT 10
+
+typedef struct _CALLST CALLST;
+struct _CALLST
+{
+  CALLST *next;
+  FTN_ADDR fa;
+  unsigned nok, nbad;           /* as in .try */
+  unsigned nhold;               /* holds after failures in a row */
+  time_t hold_until;
+};
+
+static CALLST *calls_tab[CALLS_HASH];
+static int calls_num, calls_lines;
+static char calls_path[MAXPATHLEN + 1];
+static int calls_fd = -1;
+static off_t calls_off;         /* the journal is read up to here */
+
+static unsigned calls_hash (FTN_ADDR *fa)
+{
+  unsigned h = fa->z * 31u + fa->net;
+
+  h = (h * 31 + fa->node) * 31 + fa->p;
+  return h % CALLS_HASH;
+}
+
+static CALLST *calls_find (FTN_ADDR *fa, int create)
+{
+  CALLST *c;
+  unsigned h = calls_hash (fa);
+
+  for (c = calls_tab[h]; c; c = c->next)
+    if (!ftnaddress_cmp (&c->fa, fa))
+      return c;
+  if (!create)
+    return NULL;
+  c = xalloc (sizeof (CALLST));
+  memset (c, 0, sizeof (CALLST));
+  memcpy (&c->fa, fa, sizeof (FTN_ADDR));
+  c->next = calls_tab[h];
+  calls_tab[h] = c;
+  calls_num++;
+  return c;
+}
+
+static void calls_close (void)
+{
+  int i;
+  CALLST *c;
+
+  for (i = 0; i < CALLS_HASH; i++)
+    while ((c = calls_tab[i]) != NULL)
+    {
+      calls_tab[i] = c->next;
+      free (c);
+    }
+  calls_num = calls_lines = 0;
+  if (calls_fd != -1)
+    close (calls_fd);
+  calls_fd = -1;
+  calls_off = 0;
+  calls_path[0] = 0;
+}
+
+/* "<time> <addr> <nok> <nbad> <nhold> <hold_until> <comment>" */
+static void calls_parse (char *line, BINKD_CONFIG *config)
+{
+  char addr[FTN_ADDR_SZ + 1];
+  unsigned long t, hold_until;
+  unsigned nok, nbad, nhold;
+  FTN_ADDR fa;
+  CALLST *c;
+
+  calls_lines++;
+  if (sscanf (line, "%lu %80s %u %u %u %lu", &t, addr, &nok, &nbad,
+              &nhold, &hold_until) != 6 ||
+      !parse_ftnaddress (addr, &fa, config->pDomains.first))
+    return;
+  c = calls_find (&fa, 1);
+  c->nok = nok;
+  c->nbad = nbad;
+  c->nhold = nhold;
+  c->hold_until = (time_t) hold_until;
+}
+
+/*
+ * Reads the records appended to the journal since the last call
+ */
+static void calls_read (BINKD_CONFIG *config)
+{
+  char buf[4096];
+  int n, len = 0;
+  char *p, *nl;
+
+  if (lseek (calls_fd, calls_off, SEEK_SET) == (off_t) -1)
+    return;
+  while ((n = read (calls_fd, buf + len, sizeof (buf) - 1 - len)) > 0)
+  {
+    len += n;
+    buf[len] = 0;
+    for (p = buf; (nl = strchr (p, '\n')) != NULL; p = nl + 1)
+    {
+      *nl = 0;
+      calls_parse (p, config);
+      calls_off += nl + 1 - p;
+    }
+    len -= p - buf;
+    if (len == sizeof (buf) - 1)
+    { /* garbage, skip it */
+      calls_off += len;
+      len = 0;
+    }
+    memmove (buf, p, len);
+  }
+  /* an incomplete record will be read with the next call */
+}
+
+static void calls_record (CALLST *c, const char *comment, char *buf, int size)
+{
+  char addr[FTN_ADDR_SZ + 1];
+  int i;
+
+  ftnaddress_to_str (addr, &c->fa);
+  snprintf (buf, size, "%lu %s %u %u %u %lu%s%s\n", (unsigned long) safe_time (),
+            addr, c->nok, c->nbad, c->nhold, (unsigned long) c->hold_until,
+            comment ? " " : "", comment ? comment : "");
+  for (i = 0; buf[i + 1]; i++)
+    if (buf[i] == '\n' || buf[i] == '\r')
+      buf[i] = ' ';
+  if (i == size - 2)
+    buf[i] = '\n';
+}
+
+/*
+ * Rewrites the journal with one record per node
+ */
+static void calls_compact (void)
+{
+  char tmp[MAXPATHLEN + 1], buf[MAXPATHLEN + 128];
+  FILE *f;
+  CALLST *c;
+  int i, fd;
+
+  strnzcpy (tmp, calls_path, sizeof (tmp) - 4);
+  strcat (tmp, ".tmp");
+  if ((f = fopen (tmp, "wb")) == NULL)
+  {
+    Logc (LOGC_QUEUE, 1, "%s: %s", tmp, strerror (errno));
+    return;
+  }
+  for (i = 0; i < CALLS_HASH; i++)
+    for (c = calls_tab[i]; c; c = c->next)
+    {
+      calls_record (c, NULL, buf, sizeof (buf));
+      fputs (buf, f);
+    }
+  if (fclose (f) != 0 ||
+      (rename (tmp, calls_path) != 0 &&
+       (delete (calls_path), rename (tmp, calls_path) != 0)))
+  {
+    Logc (LOGC_QUEUE, 1, "cannot replace %s: %s", calls_path, strerror (errno));
+    delete (tmp);
+    return;
+  }
+  if ((fd = open (calls_path, O_CREAT|O_APPEND|O_RDWR|O_BINARY|O_NOINHERIT, 0666)) == -1)
+    return;
+  close (calls_fd);
+  calls_fd = fd;
+  calls_off = lseek (calls_fd, 0, SEEK_END);
+  Logc (LOGC_QUEUE, 4, "%s: %i records compacted to %i", calls_path, calls_lines, calls_num);
+  calls_lines = calls_num;
+}
+
+/*
+ * Only one process rewrites the journal, the others follow it by inode
+ */
+static int calls_may_compact (void)
+{
+#if defined(HAVE_FORK) && !defined(HAVE_THREADS)
+  return pidCmgr == (int) getpid ();
+#else
+  return 1;
+#endif
+}
+
+/*
+ * Reopens the journal if it was compacted by another process, it will
+ * be read again from the start. Returns 0 on error.
+ */
+static int calls_reopen (void)
+{
+  struct stat st, fst;
+  int fd;
+
+  if (stat (calls_path, &st) == 0 && fstat (calls_fd, &fst) == 0 &&
+      st.st_ino == fst.st_ino && st.st_dev == fst.st_dev)
+    return 1;
+  if ((fd = open (calls_path, O_CREAT|O_APPEND|O_RDWR|O_BINARY|O_NOINHERIT, 0666)) == -1)
+  {
+    Logc (LOGC_QUEUE, 1, "%s: %s", calls_path, strerror (errno));
+    return 0;
+  }
+  close (calls_fd);
+  calls_fd = fd;
+  calls_off = 0;
+  calls_lines = 0;
+  return 1;
+}
+
+/*
+ * Opens the journal (restores the statistics) if needed and reads up
+ * the records added by other processes. Call with CSem locked.
+ */
+static int calls_sync (BINKD_CONFIG *config)
+{
+  if (strcmp (calls_path, config->call_journal))
+  {
+    calls_close ();
+    if (config->call_journal[0] == 0)
+      return 0;
+    if ((calls_fd = open (config->call_journal, O_CREAT|O_APPEND|O_RDWR|O_BINARY|O_NOINHERIT, 0666)) == -1)
+    {
+      Logc (LOGC_QUEUE, 1, "%s: %s", config->call_journal, strerror (errno));
+      return 0;
+    }
+    strnzcpy (calls_path, config->call_journal, sizeof (calls_path));
+    calls_read (config);
+    Logc (LOGC_QUEUE, 4, "%s: restored %i nodes", calls_path, calls_num);
+    if (calls_may_compact () && calls_lines > 2 * calls_num + 64)
+      calls_compact ();
+    return 1;
+  }
+  if (calls_fd == -1)
+    return 0;
+  calls_reopen ();
+  calls_read (config);
+  return 1;
+}
+
+static void calls_write (CALLST *c, const char *comment, BINKD_CONFIG *config)
+{
+  char buf[MAXPATHLEN + 128];
+
+  if (!calls_reopen ())
+    return;
+  calls_record (c, comment, buf, sizeof (buf));
+  if (write (calls_fd, buf, strlen (buf)) != (int) strlen (buf))
+    Logc (LOGC_QUEUE, 1, "%s: %s", calls_path, strerror (errno));
+  /* a long running binkd never reopens the journal. The records are
+   * counted when read, ours included; read up the ones of the other
+   * processes before the rewrite */
+  if (calls_may_compact ())
+  {
+    calls_read (config);
+    if (calls_lines > 2 * calls_num + 64)
+      calls_compact ();
+  }
+}
+
+/*
+ * Holds the node for config->hold, doubled with each hold in a row
+ * up to hold-max, plus-minus 1/8 of the period at random
+ */
+static time_t calls_backoff (CALLST *c, BINKD_CONFIG *config)
+{
+  long h = config->hold;
+  unsigned i;
+
+  if (config->hold_max > config->hold)
+  {
+    for (i = 0; i < c->nhold && i < CALLS_MAXSHIFT && h < config->hold_max; i++)
+      h *= 2;
+    if (h > config->hold_max)
+      h = config->hold_max;
+    if (h >= 8)
+      h += (long) ((rand () + getpid () * 31u + calls_hash (&c->fa)) % (h / 4 + 1)) - h / 8;
+  }
+  c->nhold++;
+  return safe_time () + h;
+}
+
+/*
+ * The hold of the node from the call statistics, 0 if none
+ */
+static time_t calls_hold (FTN_ADDR *fa)
+{
+  CALLST *c;
+  time_t t = 0;
+
+  LockSem (&CSem);
+  if (calls_fd != -1 && (c = calls_find (fa, 0)) != NULL &&
+      c->hold_until > safe_time ())
+    t = c->hold_until;
+  ReleaseSem (&CSem);
+  return t;
+}
+
+static void log_hold (FTN_ADDR *fa, time_t hold_until)
 {
-  char buf[MAXPATHLEN + 1];
   char addr[FTN_ADDR_SZ + 1];
   char time[80];
   struct tm tm;
@@ -1029,12 +1769,37 @@ void hold_node (FTN_ADDR *fa, time_t hold_until, BINKD_CONFIG *config)
   safe_localtime (&hold_until, &tm);
   strftime (time, sizeof (time), "%Y/%m/%d %H:%M:%S", &tm);
   ftnaddress_to_str (addr, fa);
+  Logc (LOGC_QUEUE, 2, "holding %s (%s)", addr, time);
+}
+
+/*
+ * Set .hld for a node
+ */
+void hold_node (FTN_ADDR *fa, time_t hold_until, BINKD_CONFIG *config)
+{
+  char buf[MAXPATHLEN + 1];
+  FTN_NODE *fn;
+
+  LockSem (&CSem);
+  if (calls_sync (config))
+  {
+    CALLST *c = calls_find (fa, 1);
+
+    c->hold_until = hold_until;
+    calls_write (c, "hold", config);
+    ReleaseSem (&CSem);
+    log_hold (fa, hold_until);
+    if ((fn = get_node_info (fa, config)) != NULL)
+      fn->hold_until = hold_until;
+    return;
+  }
+  ReleaseSem (&CSem);
+
+  log_hold (fa, hold_until);
   ftnaddress_to_filename (buf, fa, config);
-  Log (2, "holding %s (%s)", addr, time);
   if (*buf)
   {
     FILE *f;
-    FTN_NODE *fn;
 
     strnzcat (buf, ".hld", sizeof (buf));
     if ((f = fopen (buf, "w")) != NULL)
@@ -1046,7 +1811,7 @@ void hold_node (FTN_ADDR *fa, time_t hold_until, BINKD_CONFIG *config)
     }
     else
     {
-      Log (1, "%s: %s", buf, strerror (errno));
+      Logc (LOGC_QUEUE, 1, "%s: %s", buf, strerror (errno));
     }
   }
 }
@@ -1112,6 +1877,29 @@ void bad_try (FTN_ADDR *fa, const char *error, const int where, BINKD_CONFIG *co
   UNUSED_ARG(where);
 #endif
   if (config->tries == 0) return;
+  LockSem (&CSem);
+  if (calls_sync (config))
+  {
+    CALLST *c = calls_find (fa, 1);
+    time_t hold_until = 0;
+    FTN_NODE *fn;
+
+    if (++c->nbad >= (unsigned) config->tries)
+    {
+      c->nok = c->nbad = 0;
+      c->hold_until = hold_until = calls_backoff (c, config);
+    }
+    calls_write (c, error, config);
+    ReleaseSem (&CSem);
+    if (hold_until)
+    {
+      log_hold (fa, hold_until);
+      if ((fn = get_node_info (fa, config)) != NULL)
+        fn->hold_until = hold_until;
+    }
+    return;
+  }
+  ReleaseSem (&CSem);
   read_try (fa, &nok, &nbad, config);
   if (config->tries > 0 && ++nbad >= (unsigned) config->tries)
   {
@@ -1126,6 +1914,18 @@ void good_try (FTN_ADDR *fa, char *comment, BINKD_CONFIG *config)
   unsigned nok, nbad;
 
   if (config->tries == 0) return;
+  LockSem (&CSem);
+  if (calls_sync (config))
+  {
+    CALLST *c = calls_find (fa, 1);
+
+    c->nbad = c->nhold = 0;
+    c->nok++;
+    calls_write (c, comment, config);
+    ReleaseSem (&CSem);
+    return;
+  }
+  ReleaseSem (&CSem);
   read_try (fa, &nok, &nbad, config);
   nbad = 0;
   ++nok;
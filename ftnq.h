@@ -18,6 +18,12 @@
 
 #define SCAN_LISTED ((FTNQ*)-1)
 
+/*
+ * Call this before all others functions from this file.
+ */
+void q_init (void);
+void q_deinit (void);
+
 /*
  * Scans outbound. Return value must be q_free()'d.
  */
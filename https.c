@@ -99,7 +99,7 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 		buf[sizeof(buf)-1] = '\0';
 		if ((sp=strchr(buf, '/')) != NULL)
 			*sp++ = '\0';
-		Log(4, "connected to proxy %s", buf);
+		Logc(LOGC_NET, 4, "connected to proxy %s", buf);
 		if(sp) 
 		{
 			char *sp1;
@@ -155,11 +155,11 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 		}
 		if (send(so, buf, i, 0) < 0)
 		{
-			Log(4, "Send to proxy error: %s", TCPERR());
+			Logc(LOGC_NET, 4, "Send to proxy error: %s", TCPERR());
 			SetTCPError(PR_ERROR);
 			return 1;
 		}
-		Log(10, "sent proxy sockfd %d request: %s", so, buf);
+		Logc(LOGC_NET, 10, "sent proxy sockfd %d request: %s", so, buf);
 		for(i=0; i<sizeof(buf)-1; i++)
 		{
 			struct timeval tv;
@@ -171,18 +171,18 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 			if ((n=select(so+1, &fds, NULL, NULL, config->nettimeout > 0 ? &tv : NULL)) < 1)
 			{
 				if (n<0)
-					Log(4, "proxy error: %s", TCPERR());
+					Logc(LOGC_NET, 4, "proxy error: %s", TCPERR());
 				else
-					Log(4, "proxy timeout...");
+					Logc(LOGC_NET, 4, "proxy timeout...");
 				SetTCPError(PR_ERROR);
 				return 1;
 			}
 			if ((n=recv(so, buf+i, 1, 0)) < 1)
 			{
 				if (n<0)
-					Log(2, "Proxy error: %s", TCPERR());
+					Logc(LOGC_NET, 2, "Proxy error: %s", TCPERR());
 				else
-					Log(2, "Connection closed by proxy...");
+					Logc(LOGC_NET, 2, "Connection closed by proxy...");
 				SetTCPError(PR_ERROR);
 				return 1;
 			}
@@ -207,7 +207,7 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 						 host, port, ntlm);
 					i = getNTLM2(ntlmsp, sp, buf + i, sizeof(buf) - i);
 					free(sp);
-					if (i) Log(2, "Invalid username/password/host/domain string (%s) %d", ntlmsp, i);
+					if (i) Logc(LOGC_NET, 2, "Invalid username/password/host/domain string (%s) %d", ntlmsp, i);
 					free(ntlmsp);
 
 					if(!i)
@@ -228,7 +228,7 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 					if(sp[0]=='\r') sp[0]=0;
 				}
 				if(strstr(buf, " 200 ")) break;
-				Log(2, "Connection rejected by proxy (%s)", buf);
+				Logc(LOGC_NET, 2, "Connection rejected by proxy (%s)", buf);
 				SetTCPError(PR_ERROR);
 				return 1;
 			}
@@ -240,13 +240,13 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 		buf[sizeof(buf)-1] = '\0';
 		if ((sauth=strchr(buf, '/')) != NULL)
 			*sauth++ = '\0';
-		Log(4, "connected to socks%c %s", sauth ? '5' : '4', buf);
+		Logc(LOGC_NET, 4, "connected to socks%c %s", sauth ? '5' : '4', buf);
 		if (!sauth) /* SOCKS4 */
 		{
 			/* SOCKS4 only support IPv4 and we need the IP address */
 			if ((aiErr=srv_getaddrinfo(host, port, &hints, &aiHead)) != 0)
 			{
-				Log(2, "getaddrinfo failed: %s (%d)", gai_strerror(aiErr), aiErr);
+				Logc(LOGC_NET, 2, "getaddrinfo failed: %s (%d)", gai_strerror(aiErr), aiErr);
 				SetTCPError(PR_ERROR);
 				return 1;
 			}
@@ -255,7 +255,7 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 		{
 			if ((aiErr=getaddrinfo(NULL, port, &hints, &aiHead)) != 0)
 			{
-				Log(2, "getaddrinfo failed: %s (%d)", gai_strerror(aiErr), aiErr);
+				Logc(LOGC_NET, 2, "getaddrinfo failed: %s (%d)", gai_strerror(aiErr), aiErr);
 				return 1;
 			}
 			sauth=strdup(sauth);
@@ -274,13 +274,13 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 			}
 			if ((recv(so, buf, 2, 0)!=2)||((buf[1])&&(buf[1]!=1)&&(buf[1]!=2)))
 			{
-				Log(1, "Auth. method not supported by socks5 server");
+				Logc(LOGC_NET, 1, "Auth. method not supported by socks5 server");
 				free(sauth);
 				freeaddrinfo(aiHead);
 				SetTCPError(PR_ERROR);
 				return 1;
 			}
-			Log(6, "Socks5, Auth=%d", buf[1]);
+			Logc(LOGC_NET, 6, "Socks5, Auth=%d", buf[1]);
 			if (buf[1]==2) /* username/password method */
 			{
 				buf[0]=1;
@@ -300,7 +300,7 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 				buf[0]=buf[1]=0;
 				if ((recv(so, buf, 2, 0)<2)||(buf[1]))
 				{
-					Log(1, "Authentication failed (socks5 returns %02X%02X)", (unsigned char)buf[0], (unsigned char)buf[1]);
+					Logc(LOGC_NET, 1, "Authentication failed (socks5 returns %02X%02X)", (unsigned char)buf[0], (unsigned char)buf[1]);
 					free(sauth);
 					freeaddrinfo(aiHead);
 					SetTCPError(PR_ERROR);
@@ -317,7 +317,7 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 				buf[0]=4;
 				buf[1]=1;
 				lockhostsem();
-				Log (4, strcmp(port, config->oport) == 0 ? "trying %s..." : "trying %s:%u...",
+				Logc (LOGC_NET, 4, strcmp(port, config->oport) == 0 ? "trying %s..." : "trying %s:%u...",
 				     inet_ntoa(((struct sockaddr_in*)(ai->ai_addr))->sin_addr), portnum);
 				releasehostsem();
 				buf[2]=(unsigned char)((portnum>>8)&0xFF);
@@ -360,9 +360,9 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 				if ((n=select(so+1, &fds, NULL, NULL, config->nettimeout > 0 ? &tv : NULL)) < 1)
 				{
 					if (n<0)
-						Log(4, "socks error: %s", TCPERR());
+						Logc(LOGC_NET, 4, "socks error: %s", TCPERR());
 					else
-						Log(4, "socks timeout...");
+						Logc(LOGC_NET, 4, "socks timeout...");
 					if (sauth) free(sauth);
 					freeaddrinfo(aiHead);
 					SetTCPError(PR_ERROR);
@@ -370,8 +370,8 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 				}
 				if ((n=recv(so, buf+i, 1, 0))<1) {
 					if (n<0)
-						Log(2, "socks error: %s", TCPERR());
-						Log(2, "connection closed by socks server...");
+						Logc(LOGC_NET, 2, "socks error: %s", TCPERR());
+						Logc(LOGC_NET, 2, "connection closed by socks server...");
 					if (sauth) free(sauth);
 					freeaddrinfo(aiHead);
 					SetTCPError(PR_ERROR);
@@ -380,13 +380,13 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 				if (!sauth && i>6) /* 8th byte received */
 				{
 					if (buf[0]!=0) {
-						Log(2, "Bad reply from socks server");
+						Logc(LOGC_NET, 2, "Bad reply from socks server");
 						freeaddrinfo(aiHead);
 						SetTCPError(PR_ERROR);
 						return 1;
 					}
 					if (buf[1]!=90) {
-						Log(2, "connection rejected by socks4 server (%d)", (unsigned char)buf[1]);
+						Logc(LOGC_NET, 2, "connection rejected by socks4 server (%d)", (unsigned char)buf[1]);
 						SetTCPError(PR_ERROR);
 						break; /* try next IP */
 					}
@@ -398,7 +398,7 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 				else if (sauth && i>5)
 				{
 					if (buf[0]!=5) {
-						Log(2, "Bad reply from socks server");
+						Logc(LOGC_NET, 2, "Bad reply from socks server");
 						free(sauth);
 						freeaddrinfo(aiHead);
 						SetTCPError(PR_ERROR);
@@ -412,15 +412,15 @@ int h_connect(int so, const char *host, const char *port, BINKD_CONFIG *config,
 					if (!buf[1])	return 0;
 					switch (buf[1])
 					{
-						case 1: Log (2, "general SOCKS5 server failure"); break;
-						case 2: Log (2, "connection not allowed by ruleset (socks5)"); break;
-						case 3: Log (2, "Network unreachable (socks5)"); break;
-						case 4: Log (2, "Host unreachable (socks5)"); break;
-						case 5: Log (2, "Connection refused (socks5)"); break;
-						case 6: Log (2, "TTL expired (socks5)"); break;
-						case 7: Log (2, "Command not supported by socks5"); break;
-						case 8: Log (2, "Address type not supported"); break;
-						default: Log (2, "Unknown reply (0x%02X) from socks5 server", (unsigned char)buf[1]);
+						case 1: Logc (LOGC_NET, 2, "general SOCKS5 server failure"); break;
+						case 2: Logc (LOGC_NET, 2, "connection not allowed by ruleset (socks5)"); break;
+						case 3: Logc (LOGC_NET, 2, "Network unreachable (socks5)"); break;
+						case 4: Logc (LOGC_NET, 2, "Host unreachable (socks5)"); break;
+						case 5: Logc (LOGC_NET, 2, "Connection refused (socks5)"); break;
+						case 6: Logc (LOGC_NET, 2, "TTL expired (socks5)"); break;
+						case 7: Logc (LOGC_NET, 2, "Command not supported by socks5"); break;
+						case 8: Logc (LOGC_NET, 2, "Address type not supported"); break;
+						default: Logc (LOGC_NET, 2, "Unknown reply (0x%02X) from socks5 server", (unsigned char)buf[1]);
 					}
 					SetTCPError(PR_ERROR);
 					return 1;
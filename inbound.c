@@ -11,12 +11,16 @@
  *  (at your option) any later version. See COPYING.
  */
 
+#ifdef HAVE_FALLOCATE
+#define _GNU_SOURCE
+#endif
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <limits.h>
 
 #include "sys.h"
 #include "readcfg.h"
@@ -28,6 +32,7 @@
 #include "ftnaddr.h"
 #include "ftnnode.h"
 #include "srif.h"
+#include "sem.h"
 #ifdef WITH_PERL
 #include "perlhooks.h"
 #endif
@@ -59,7 +64,7 @@ static int creat_tmp_name (char *s, TFILE *file, FTN_ADDR *from, char *inbound)
     {
       if ((f = fopen (s, "w")) == 0)
       {
-        Log (1, "%s: %s", s, strerror (errno));
+        Logc (LOGC_INBOUND, 1, "%s: %s", s, strerror (errno));
         delete (s);
         return 0;
       }
@@ -68,14 +73,14 @@ static int creat_tmp_name (char *s, TFILE *file, FTN_ADDR *from, char *inbound)
                    (uintmax_t) file->size,
                    (uintmax_t) file->time, node) <= 0)
       {
-        Log (1, "%s: %s", s, strerror (errno));
+        Logc (LOGC_INBOUND, 1, "%s: %s", s, strerror (errno));
         fclose (f);
         delete (s);
         return 0;
       }
       if (fclose (f))
       {
-        Log (1, "%s: %s", s, strerror (errno));
+        Logc (LOGC_INBOUND, 1, "%s: %s", s, strerror (errno));
         delete (s);
         return 0;
       }
@@ -97,7 +102,7 @@ static int to_be_deleted (char *tmp_name, char *netname, boff_t filesize, BINKD_
   if ((stat (tmp_name, &sb) == 0 ? sb.st_size != filesize : (sp = &sd, 1)) &&
       time (0) - sp->st_mtime > config->kill_old_partial_files)
   {
-    Log (4, "found old .dt/.hr files for %s", netname);
+    Logc (LOGC_INBOUND, 4, "found old .dt/.hr files for %s", netname);
     return 1;
   }
   strcpy (strrchr (tmp_name, '.'), ".hr");
@@ -105,29 +110,246 @@ static int to_be_deleted (char *tmp_name, char *netname, boff_t filesize, BINKD_
 }
 
 /*
- * Searches for the ``file'' in the inbound and returns it's tmp name in s.
- * S must have MAXPATHLEN chars. Returns 0 on error, 1=found, 2=created.
+ * Index of the partial files (xxxxxxxx.hr and .dt) in the temp inbounds.
+ * A directory is read once, then the index is updated when binkd creates
+ * or removes partial files. The .hr files stay the only record on disk:
+ * if the directory mtime shows that another process (or the sysop)
+ * changed the directory, it is read again. Our own changes are made
+ * between inb_change() and inb_sync(), the new mtime is only adopted if
+ * nobody else had changed the directory before.
  */
-static int find_tmp_name (char *s, TFILE *file, STATE *state, BINKD_CONFIG *config)
+typedef struct _PARTIAL PARTIAL;
+struct _PARTIAL {
+  PARTIAL *next;
+  char    *netname;
+  boff_t   size;
+  time_t   time;
+  FTN_ADDR fa;
+  int      fa_ok;               /* the address in .hr is parsed */
+  char     name[12];            /* xxxxxxxx.hr */
+};
+
+typedef struct _INBDIR INBDIR;
+struct _INBDIR {
+  INBDIR   *next;
+  char     *path;
+  time_t    mtime;              /* after our last change, 0 to read again */
+  time_t    listed;             /* time of the last scan or mtime update */
+  time_t    cleaned;            /* last check for old partial files */
+  int       dirty;              /* being changed by us, see inb_change() */
+  PARTIAL **hash;               /* by netname */
+  int       hsize, n;
+};
+
+/* check for old partial files at most once per ... seconds */
+#define INB_CLEAN_INTERVAL 60
+
+static INBDIR  *inbdirs;
+#if defined(HAVE_THREADS) || defined(AMIGA)
+static MUTEXSEM ISem;
+#endif
+
+/*
+ * Free space of the filesystems of the inbounds. statfs() is called at
+ * most once per FREE_REFRESH seconds. Files being received reserve
+ * their remaining size, so concurrent receptions can't overcommit the
+ * space. At each refresh, the remaining size of each reservation is
+ * updated from the size of its .dt file. A file received to a temp
+ * inbound on another filesystem keeps its full size reserved in the
+ * final inbound.
+ */
+#define FREE_REFRESH 10
+
+typedef struct _FSDEV FSDEV;
+typedef struct _FSRSV FSRSV;
+
+struct _FSRSV {
+  FSRSV  *next;
+  FSRSV  *peer;                 /* the other reservation of the same file */
+  FSDEV  *dev;
+  char   *path;                 /* of the .dt file, NULL if not on dev */
+  boff_t  size, left;
+};
+
+struct _FSDEV {
+  FSDEV  *next;
+  dev_t   dev;
+  char   *path;
+  unsigned long free;           /* Kbytes, at the last refresh */
+  time_t  refreshed;
+  FSRSV  *rsv;
+};
+
+typedef struct _FSPATH FSPATH;
+struct _FSPATH {
+  FSPATH *next;
+  char   *path;
+  FSDEV  *dev;
+};
+
+static FSDEV  *fsdevs;
+static FSPATH *fspaths;
+
+void inb_init (void)
+{
+  InitSem (&ISem);
+}
+
+static void inb_free_entries (INBDIR *dir)
+{
+  PARTIAL *p;
+  int i;
+
+  for (i = 0; i < dir->hsize; i++)
+    while ((p = dir->hash[i]) != NULL)
+    {
+      dir->hash[i] = p->next;
+      xfree (p->netname);
+      free (p);
+    }
+  dir->n = 0;
+}
+
+void inb_deinit (void)
+{
+  INBDIR *dir;
+
+  while ((dir = inbdirs) != NULL)
+  {
+    inbdirs = dir->next;
+    inb_free_entries (dir);
+    xfree (dir->hash);
+    xfree (dir->path);
+    free (dir);
+  }
+  while (fspaths)
+  {
+    FSPATH *p = fspaths;
+
+    fspaths = p->next;
+    xfree (p->path);
+    free (p);
+  }
+  while (fsdevs)
+  {
+    FSDEV *d = fsdevs;
+
+    fsdevs = d->next;
+    xfree (d->path);
+    free (d);
+  }
+  CleanSem (&ISem);
+}
+
+static int inb_hash (char *netname, int hsize)
+{
+  unsigned long h = 0;
+
+  while (*netname)
+    h = h * 31 + (unsigned char) *netname++;
+  return (int) (h % hsize);
+}
+
+static void inb_add (INBDIR *dir, char *name, char *netname, boff_t size,
+                     time_t t, FTN_ADDR *fa)
 {
-  char buf[MAXPATHLEN + 80];
+  PARTIAL *p, *next;
+  int i, j;
+
+  if (dir->n >= dir->hsize * 2)
+  { /* grow */
+    PARTIAL **old = dir->hash;
+    int old_size = dir->hsize;
+
+    dir->hsize = dir->hsize * 4 + 1;
+    dir->hash = xalloc (dir->hsize * sizeof (PARTIAL *));
+    memset (dir->hash, 0, dir->hsize * sizeof (PARTIAL *));
+    for (i = 0; i < old_size; i++)
+      for (p = old[i]; p; p = next)
+      {
+        next = p->next;
+        j = inb_hash (p->netname, dir->hsize);
+        p->next = dir->hash[j];
+        dir->hash[j] = p;
+      }
+    xfree (old);
+  }
+  p = xalloc (sizeof (PARTIAL));
+  memset (p, 0, sizeof (PARTIAL));
+  p->netname = xstrdup (netname);
+  p->size = size;
+  p->time = t;
+  if (fa)
+  {
+    memcpy (&p->fa, fa, sizeof (FTN_ADDR));
+    p->fa_ok = 1;
+  }
+  strnzcpy (p->name, name, sizeof (p->name));
+  j = inb_hash (netname, dir->hsize);
+  p->next = dir->hash[j];
+  dir->hash[j] = p;
+  dir->n++;
+}
+
+/*
+ * Call before changing the directory: if it was changed since we looked
+ * at it, the index must be read again after our change too
+ */
+static void inb_change (INBDIR *dir)
+{
+  struct stat sb;
+
+  if (dir->dirty)
+    return;
+  dir->dirty = 1;
+  if (stat (dir->path, &sb) != 0 || sb.st_mtime != dir->mtime ||
+      dir->listed <= dir->mtime)
+    dir->mtime = 0;
+}
+
+/* Removes the entry and its files */
+static void inb_remove (INBDIR *dir, PARTIAL *p, int unlink_files)
+{
+  char path[MAXPATHLEN + 1];
+  PARTIAL **pp;
+
+  if (unlink_files)
+  {
+    inb_change (dir);
+    strnzcpy (path, dir->path, sizeof (path));
+    strnzcat (path, PATH_SEPARATOR, sizeof (path));
+    strnzcat (path, p->name, sizeof (path));
+    remove_hr (path);
+  }
+  for (pp = dir->hash + inb_hash (p->netname, dir->hsize); *pp; pp = &(*pp)->next)
+    if (*pp == p)
+    {
+      *pp = p->next;
+      break;
+    }
+  xfree (p->netname);
+  free (p);
+  dir->n--;
+}
+
+/* Reads the .hr files of the directory into the index */
+static void inb_scan (INBDIR *dir, BINKD_CONFIG *config)
+{
+  char buf[MAXPATHLEN + 80], s[MAXPATHLEN + 1];
   DIR *dp;
   struct dirent *de;
   FILE *f;
-  int i, found = 0;
-  char *t, *inbound;
-
-  inbound = state->inbound;
-  if (config->temp_inbound[0])
-    inbound = config->temp_inbound;
+  int i;
+  char *t;
 
-  if ((dp = opendir (inbound)) == 0)
+  inb_free_entries (dir);
+  dir->cleaned = 0;
+  if ((dp = opendir (dir->path)) == 0)
   {
-    Log (1, "cannot opendir %s: %s", inbound, strerror (errno));
-    return 0;
+    Logc (LOGC_INBOUND, 1, "cannot opendir %s: %s", dir->path, strerror (errno));
+    return;
   }
-
-  strnzcpy (s, inbound, MAXPATHLEN);
+  strnzcpy (s, dir->path, MAXPATHLEN);
   strnzcat (s, PATH_SEPARATOR, MAXPATHLEN);
   t = s + strlen (s);
   while ((de = readdir (dp)) != 0)
@@ -137,18 +359,19 @@ static int find_tmp_name (char *s, TFILE *file, STATE *state, BINKD_CONFIG *conf
         break;
     if (i < 8 || STRICMP (de->d_name + 8, ".hr"))
       continue;
+    *t = 0;
     strnzcat (s, de->d_name, MAXPATHLEN);
 
-    if ((f = fopen (s, "r")) == NULL)
+    if ((f = de_fopen (dp, de, s)) == NULL)
     {
-      Log (1, "find_tmp_name: %s: %s", de->d_name, strerror (errno));
+      Logc (LOGC_INBOUND, 1, "find_tmp_name: %s: %s", de->d_name, strerror (errno));
     }
     else if (fgets (buf, sizeof (buf), f)==NULL)
     {  /* This .hr is empty, now checks to old */
       fclose (f);
       if (to_be_deleted (s, "unknown", (boff_t)-1, config))
       {
-        Log (5, "old empty partial file %s is removed", de->d_name);
+        Logc (LOGC_INBOUND, 5, "old empty partial file %s is removed", de->d_name);
         remove_hr (s);
       }
     }
@@ -165,81 +388,349 @@ static int find_tmp_name (char *s, TFILE *file, STATE *state, BINKD_CONFIG *conf
       {
         if (to_be_deleted (s, "unknown", (boff_t)-1, config))
         {
-          Log (5, "old partial file %s with garbage is removed", de->d_name);
+          Logc (LOGC_INBOUND, 5, "old partial file %s with garbage is removed", de->d_name);
           remove_hr (s);
         }
       }
       else
+        inb_add (dir, de->d_name, w[0], (boff_t) strtoumax (w[1], NULL, 10),
+                 (time_t) safe_atol (w[2], NULL),
+                 parse_ftnaddress (w[3], &fa, config->pDomains.first) ? &fa : NULL);
+      for (i = 0; i < 4; ++i)
+        xfree (w[i]);
+    }
+  }
+  closedir (dp);
+  Logc (LOGC_INBOUND, 5, "%s: %i partial file(s)", dir->path, dir->n);
+}
+
+/* Returns the index of the directory, reads it if it was changed */
+static INBDIR *inb_dir (char *path, BINKD_CONFIG *config)
+{
+  INBDIR *dir;
+  struct stat sb;
+  time_t now = time (NULL);
+
+  for (dir = inbdirs; dir; dir = dir->next)
+    if (!strcmp (dir->path, path))
+      break;
+  if (stat (path, &sb) != 0)
+  {
+    Logc (LOGC_INBOUND, 1, "cannot stat %s: %s", path, strerror (errno));
+    return NULL;
+  }
+  if (dir == NULL)
+  {
+    dir = xalloc (sizeof (INBDIR));
+    memset (dir, 0, sizeof (INBDIR));
+    dir->path = xstrdup (path);
+    dir->hsize = 61;
+    dir->hash = xalloc (dir->hsize * sizeof (PARTIAL *));
+    memset (dir->hash, 0, dir->hsize * sizeof (PARTIAL *));
+    dir->next = inbdirs;
+    inbdirs = dir;
+  }
+  /* a change within the second of our last look does not show in mtime */
+  else if (sb.st_mtime == dir->mtime && dir->listed > dir->mtime)
+    return dir;
+  dir->mtime = sb.st_mtime;
+  dir->listed = now;
+  inb_scan (dir, config);
+  return dir;
+}
+
+/* Updates the known directory mtime after our changes */
+static void inb_sync (INBDIR *dir)
+{
+  struct stat sb;
+  time_t now = time (NULL);
+
+  if (dir->dirty && dir->mtime && stat (dir->path, &sb) == 0)
+  {
+    dir->mtime = sb.st_mtime;
+    dir->listed = now;
+  }
+  dir->dirty = 0;
+}
+
+/* Removes old partial files, except ones for netname */
+static void inb_clean (INBDIR *dir, char *netname, BINKD_CONFIG *config)
+{
+  char path[MAXPATHLEN + 1];
+  time_t now = safe_time ();
+  PARTIAL *p, *next;
+  int i;
+
+  if (config->kill_old_partial_files == 0 || now - dir->cleaned < INB_CLEAN_INTERVAL)
+    return;
+  dir->cleaned = now;
+  for (i = 0; i < dir->hsize; i++)
+    for (p = dir->hash[i]; p; p = next)
+    {
+      next = p->next;
+      if (!strcmp (p->netname, netname))
+        continue;
+      strnzcpy (path, dir->path, sizeof (path));
+      strnzcat (path, PATH_SEPARATOR, sizeof (path));
+      strnzcat (path, p->name, sizeof (path));
+      if (to_be_deleted (path, p->netname, p->size, config))
       {
-        i = -1;
-        if (parse_ftnaddress (w[3], &fa, config->pDomains.first))
-          for (i = 0; i < state->nallfa; i++)
-            if (!ftnaddress_cmp (&fa, state->fa + i))
-              break;
+        Logc (LOGC_INBOUND, 5, "old partial file %s removed", p->netname);
+        inb_remove (dir, p, 1);
+      }
+    }
+}
 
-        if (file == NULL)
-        {
-          if (i >= 0 && i < state->nallfa && !state->skip_all_flag)
-          {
-            Log (5, "partial file %s removed", w[0]);
-            remove_hr (s);
-          }
-        }
-        else if (i >= 0 && !strcmp (w[0], file->netname))
+/* Returns the index of p->fa in the session akas, nallfa if not found */
+static int inb_aka (PARTIAL *p, STATE *state)
+{
+  int i;
+
+  for (i = 0; i < state->nallfa; i++)
+    if (!ftnaddress_cmp (&p->fa, state->fa + i))
+      break;
+  return i;
+}
+
+static char *inb_tmp_inbound (STATE *state, BINKD_CONFIG *config)
+{
+  return config->temp_inbound[0] ? config->temp_inbound : state->inbound;
+}
+
+/*
+ * Searches for the ``file'' in the inbound and returns it's tmp name in s.
+ * S must have MAXPATHLEN chars. Returns 0 on error, 1=found, 2=created.
+ * With file == NULL removes all partial files of the remote.
+ */
+static int find_tmp_name (char *s, TFILE *file, STATE *state, BINKD_CONFIG *config)
+{
+  char node[FTN_ADDR_SZ + 1];
+  INBDIR *dir;
+  PARTIAL *p, *next, *found = NULL;
+  int i, rc = 0;
+  char *inbound;
+
+  inbound = inb_tmp_inbound (state, config);
+
+  LockSem (&ISem);
+  if ((dir = inb_dir (inbound, config)) == NULL)
+  {
+    ReleaseSem (&ISem);
+    return 0;
+  }
+
+  if (file == NULL)
+  {
+    if (!state->skip_all_flag)
+      for (i = 0; i < dir->hsize; i++)
+        for (p = dir->hash[i]; p; p = next)
         {
-          if (file->size == (boff_t) strtoumax (w[1], NULL, 10) &&
-              (file->time & ~1) == (time_t) (safe_atol (w[2], NULL) & ~1) &&
-              i < state->nallfa)
-          { /* non-destructive skip file from busy aka */
-            if (i >= state->nfa)
-            {
-              Log (2, "Skip partial file %s: aka %s busy", w[0], w[3]);
-              for (i = 0; i < 4; ++i)
-                xfree (w[i]);
-              return 0;
-            }
-            else
-              found = 1;
-          }
-          else if (config->kill_dup_partial_files && i < state->nallfa)
+          next = p->next;
+          if (p->fa_ok && inb_aka (p, state) < state->nallfa)
           {
-            Log (5, "dup partial file %s removed", w[0]);
-            remove_hr (s);
+            Logc (LOGC_INBOUND, 5, "partial file %s removed", p->netname);
+            inb_remove (dir, p, 1);
           }
         }
-        else if (to_be_deleted (s, w[0], strtoumax (w[1], NULL, 10), config))
-        {
-          Log (5, "old partial file %s removed", w[0]);
-          remove_hr (s);
-        }
+    inb_sync (dir);
+    ReleaseSem (&ISem);
+    return 0;
+  }
 
-        for (i = 0; i < 4; ++i)
-          xfree (w[i]);
+  for (p = dir->hash[inb_hash (file->netname, dir->hsize)]; p; p = next)
+  {
+    next = p->next;
+    if (!p->fa_ok || strcmp (p->netname, file->netname))
+      continue;
+    i = inb_aka (p, state);
+    if (file->size == p->size && (file->time & ~1) == (p->time & ~1) &&
+        i < state->nallfa)
+    { /* non-destructive skip file from busy aka */
+      if (i >= state->nfa)
+      {
+        ftnaddress_to_str (node, &p->fa);
+        Logc (LOGC_INBOUND, 2, "Skip partial file %s: aka %s busy", p->netname, node);
+        inb_sync (dir);
+        ReleaseSem (&ISem);
+        return 0;
       }
-    }
-    if (found)
+      found = p;
       break;
-    else
-      *t = 0;
+    }
+    else if (config->kill_dup_partial_files && i < state->nallfa)
+    {
+      Logc (LOGC_INBOUND, 5, "dup partial file %s removed", p->netname);
+      inb_remove (dir, p, 1);
+    }
   }
-  closedir (dp);
+  inb_clean (dir, file->netname, config);
 
-  if (file == NULL)
-    return 0;
-
-  /* New file */
-  if (!found)
+  if (found)
   {
-    Log (5, "file not found, trying to create a tmpname");
+    strnzcpy (s, inbound, MAXPATHLEN);
+    strnzcat (s, PATH_SEPARATOR, MAXPATHLEN);
+    strnzcat (s, found->name, MAXPATHLEN);
+    rc = 1;
+  }
+  else
+  { /* New file */
+    Logc (LOGC_INBOUND, 5, "file not found, trying to create a tmpname");
+    inb_change (dir);
     if (creat_tmp_name (s, file, state->fa, inbound))
-      found = 2;
-    else
-      return 0;
+    {
+      inb_add (dir, strrchr (s, PATH_SEPARATOR[0]) + 1, file->netname,
+               file->size, file->time, state->fa);
+      rc = 2;
+    }
   }
+  inb_sync (dir);
+  ReleaseSem (&ISem);
 
   /* Replacing .hr with .dt */
-  strcpy (strrchr (s, '.'), ".dt");
-  return found;
+  if (rc)
+    strcpy (strrchr (s, '.'), ".dt");
+  return rc;
+}
+
+/*
+ * Removes the partial file tmp_name (.hr), with its .dt if unlink_dt,
+ * and drops it from the index
+ */
+static void inb_forget (char *tmp_name, int unlink_dt, TFILE *file,
+                        STATE *state, BINKD_CONFIG *config)
+{
+  char *inbound = inb_tmp_inbound (state, config), *name;
+  INBDIR *dir;
+  PARTIAL *p;
+
+  name = strrchr (tmp_name, PATH_SEPARATOR[0]);
+  name = name ? name + 1 : tmp_name;
+  LockSem (&ISem);
+  if ((dir = inb_dir (inbound, config)) != NULL)
+    inb_change (dir);
+  if (unlink_dt)
+    remove_hr (tmp_name);
+  else
+    sdelete (tmp_name);
+  if (dir)
+  {
+    for (p = dir->hash[inb_hash (file->netname, dir->hsize)]; p; p = p->next)
+      if (!strncmp (p->name, name, 9))  /* xxxxxxxx. */
+      {
+        inb_remove (dir, p, 0);
+        break;
+      }
+    inb_sync (dir);
+  }
+  ReleaseSem (&ISem);
+}
+
+/* Returns the filesystem of path. Must be called with ISem locked */
+static FSDEV *fs_get (char *path)
+{
+  struct stat sb;
+  FSPATH *p;
+  FSDEV *d;
+
+  for (p = fspaths; p; p = p->next)
+    if (!strcmp (p->path, path))
+      return p->dev;
+  if (stat (path, &sb) != 0)
+    return NULL;
+  for (d = fsdevs; d; d = d->next)
+    if (d->dev == sb.st_dev)
+      break;
+  if (d == NULL)
+  {
+    d = xalloc (sizeof (FSDEV));
+    memset (d, 0, sizeof (FSDEV));
+    d->dev = sb.st_dev;
+    d->path = xstrdup (path);
+    d->next = fsdevs;
+    fsdevs = d;
+  }
+  p = xalloc (sizeof (FSPATH));
+  p->path = xstrdup (path);
+  p->dev = d;
+  p->next = fspaths;
+  fspaths = p;
+  return d;
+}
+
+/* Returns the free Kbytes not reserved. Must be called with ISem locked */
+static unsigned long fs_avail (FSDEV *d)
+{
+  time_t now = safe_time ();
+  struct stat sb;
+  uintmax_t reserved = 0;
+  FSRSV *r;
+
+  if (d->refreshed == 0 || now - d->refreshed >= FREE_REFRESH || now < d->refreshed)
+  {
+    d->free = getfree (d->path);
+    d->refreshed = now;
+    for (r = d->rsv; r; r = r->next)
+    {
+      boff_t have = 0;
+
+      if (r->path == NULL)
+        continue;
+      if (stat (r->path, &sb) == 0)
+      {
+        have = sb.st_size;
+#ifdef HAVE_FALLOCATE
+        /* preallocated blocks are counted by statfs() too */
+        if ((boff_t) sb.st_blocks * 512 > have)
+          have = (boff_t) sb.st_blocks * 512;
+#endif
+      }
+      r->left = have < r->size ? r->size - have : 0;
+    }
+  }
+  if (d->free == ULONG_MAX)
+    return ULONG_MAX;
+  for (r = d->rsv; r; r = r->next)
+    reserved += (r->left + 1023) / 1024;
+  return reserved < d->free ? d->free - (unsigned long) reserved : 0;
+}
+
+static void fs_reserve (STATE *state, FSDEV *d, char *path, boff_t size, boff_t have)
+{
+  FSRSV *r = xalloc (sizeof (FSRSV));
+
+  r->dev = d;
+  r->path = path ? xstrdup (path) : NULL;
+  r->size = size;
+  r->left = size > have ? size - have : 0;
+  r->next = d->rsv;
+  d->rsv = r;
+  r->peer = (FSRSV *) state->in_rsv;
+  state->in_rsv = r;
+}
+
+/*
+ * Releases the free space reserved for the file being received
+ */
+void inb_release (STATE *state)
+{
+  FSRSV *r, **rp;
+
+  if (state->in_rsv == NULL)
+    return;
+  LockSem (&ISem);
+  while ((r = (FSRSV *) state->in_rsv) != NULL)
+  {
+    state->in_rsv = r->peer;
+    for (rp = &r->dev->rsv; *rp; rp = &(*rp)->next)
+      if (*rp == r)
+      {
+        *rp = r->next;
+        break;
+      }
+    xfree (r->path);
+    free (r);
+  }
+  ReleaseSem (&ISem);
 }
 
 void inb_remove_partial (STATE *state, BINKD_CONFIG *config)
@@ -256,18 +747,19 @@ FILE *inb_fopen (STATE *state, BINKD_CONFIG *config)
   FILE *f;
   int fd;
 
+  inb_release (state);
   if (!find_tmp_name (buf, &(state->in), state, config))
     return 0;
 
 fopen_again:
   if ((fd = open (buf, O_CREAT|O_APPEND|O_RDWR|O_BINARY|O_NOINHERIT, 0666)) == -1)
   {
-    Log (1, "%s: %s", buf, strerror (errno));
+    Logc (LOGC_INBOUND, 1, "%s: %s", buf, strerror (errno));
     return 0;
   }
   if ((f = fdopen (fd, "ab")) == 0)
   {
-    Log (1, "%s: %s", buf, strerror (errno));
+    Logc (LOGC_INBOUND, 1, "%s: %s", buf, strerror (errno));
     return 0;
   }
   fseeko(f, 0, SEEK_END);               /* Work-around MSVC bug */
@@ -284,19 +776,38 @@ fopen_again:
     /* Free space req-d (Kbytes) */
     unsigned long freespace, freespace2;
     int req_free = ((state->state == P_SECURE) ? config->minfree : config->minfree_nonsecure);
+    FSDEV *d, *d2;
 
-    freespace2 = getfree(state->inbound);
+    LockSem (&ISem);
+    d2 = fs_get (state->inbound);
+    freespace2 = d2 ? fs_avail (d2) : getfree (state->inbound);
+    d = NULL;
     if ( config->temp_inbound[0] &&
-         !strncmp(config->temp_inbound,buf,strlen(config->temp_inbound)) )
+         !strncmp(config->temp_inbound,buf,strlen(config->temp_inbound)) &&
+         (d = fs_get (config->temp_inbound)) != d2 )
     {
-      freespace = getfree(config->temp_inbound);
+      freespace = d ? fs_avail (d) : getfree (config->temp_inbound);
       if (freespace > freespace2) freespace = freespace2;
     }
     else
+    {
+      d = NULL;
       freespace = freespace2;
+    }
+    if (sb.st_size <= state->in.size && (req_free < 0 ||
+        freespace >= (state->in.size - sb.st_size + 1023) / 1024 + (unsigned long)req_free))
+    { /* will be accepted */
+      if (d2 && d)
+        fs_reserve (state, d2, NULL, state->in.size, 0);
+      else if (d2)
+        fs_reserve (state, d2, buf, state->in.size, sb.st_size);
+      if (d)
+        fs_reserve (state, d, buf, state->in.size, sb.st_size);
+    }
+    ReleaseSem (&ISem);
     if (sb.st_size > state->in.size)
     {
-      Log (1, "Partial size %" PRIuMAX " > %" PRIuMAX " (file size), delete partial",
+      Logc (LOGC_INBOUND, 1, "Partial size %" PRIuMAX " > %" PRIuMAX " (file size), delete partial",
            (uintmax_t) sb.st_size, (uintmax_t) state->in.size);
       fclose (f);
       if (trunc_file (buf) && sdelete (buf)) return 0;
@@ -305,7 +816,7 @@ fopen_again:
     if (req_free >= 0 &&
         freespace < (state->in.size - sb.st_size + 1023) / 1024 + (unsigned long)req_free)
     {
-      Log (1, "no enough free space in %s (%luK, req-d %" PRIuMAX "K)",
+      Logc (LOGC_INBOUND, 1, "no enough free space in %s (%luK, req-d %" PRIuMAX "K)",
            (freespace == freespace2) ? state->inbound : config->temp_inbound,
            freespace,
            (uintmax_t) (state->in.size - sb.st_size + 1023) / 1024 + req_free);
@@ -314,25 +825,54 @@ fopen_again:
     }
   }
   else
-    Log (1, "%s: fstat: %s", state->in.netname, strerror (errno));
+    Logc (LOGC_INBOUND, 1, "%s: fstat: %s", state->in.netname, strerror (errno));
+
+#ifdef HAVE_FALLOCATE
+  /* The file size is kept, so resuming by its length still works */
+  if (config->preallocate > 0 && state->in.size >= (boff_t) config->preallocate * 1024 &&
+      fstat (fileno (f), &sb) == 0 && sb.st_size < state->in.size &&
+      fallocate (fileno (f), FALLOC_FL_KEEP_SIZE, sb.st_size, state->in.size - sb.st_size) != 0)
+    Logc (LOGC_INBOUND, 5, "%s: fallocate: %s", buf, strerror (errno));
+#endif
 
   return f;
 }
 
+void inb_trim (STATE *state, BINKD_CONFIG *config)
+{
+#ifdef HAVE_FALLOCATE
+  struct stat sb;
+
+  /* The partial file may never be resumed, don't let it hold the space.
+   * Punching a hole past the end is a no-op on some filesystems, while
+   * truncating to the same size frees the blocks beyond it. */
+  if (config->preallocate > 0 && state->in.f &&
+      state->in.size >= (boff_t) config->preallocate * 1024 &&
+      fflush (state->in.f) == 0 && fstat (fileno (state->in.f), &sb) == 0 &&
+      sb.st_size < state->in.size &&
+      ftruncate (fileno (state->in.f), sb.st_size) != 0)
+    Logc (LOGC_INBOUND, 5, "%s: ftruncate: %s", state->in.netname, strerror (errno));
+#else
+  UNUSED_ARG(state);
+  UNUSED_ARG(config);
+#endif
+}
+
 int inb_reject (STATE *state, BINKD_CONFIG *config)
 {
   char tmp_name[MAXPATHLEN + 1];
 
   if (find_tmp_name (tmp_name, &state->in, state, config) != 1)
   {
-    Log (1, "missing tmp file for %s!", state->in.netname);
+    Logc (LOGC_INBOUND, 1, "missing tmp file for %s!", state->in.netname);
     return 0;
   }
   else
   {
     /* Replacing .dt with .hr and removing temp. file */
     strcpy (strrchr (tmp_name, '.'), ".hr");
-    remove_hr (tmp_name);
+    inb_forget (tmp_name, 1, &state->in, state, config);
+    inb_release (state);
     return 1;
   }
 }
@@ -367,14 +907,14 @@ int check_pkthdr(STATE *state, char *netname, char *tmp_name,
   /* parse pkt header */
   check = 0;
   if ( (PKT = fopen(tmp_name, "rb")) == NULL )
-      Log (1, "can't open file %s: %s, header check failed for %s", tmp_name, strerror (errno), netname);
+      Logc (LOGC_INBOUND, 1, "can't open file %s: %s, header check failed for %s", tmp_name, strerror (errno), netname);
   else if ( !fread(buf, sizeof(buf), 1, PKT) )
-      Log (1, "file %s read error: %s, header check failed for %s", tmp_name, strerror (errno), netname);
+      Logc (LOGC_INBOUND, 1, "file %s read error: %s, header check failed for %s", tmp_name, strerror (errno), netname);
   else if ( !pkt_getaddr(buf, &cz, &cn, &cf, &cp, NULL, NULL, NULL, NULL) )
-      Log (1, "pkt %s version is %d, expected 2; header check failed", netname, buf[18]+buf[19]*0x100);
+      Logc (LOGC_INBOUND, 1, "pkt %s version is %d, expected 2; header check failed", netname, buf[18]+buf[19]*0x100);
   else {
     check = 1;
-    Log (5, "pkt addr is %d:%d/%d.%d for %s", cz, cn, cf, cp, netname);
+    Logc (LOGC_INBOUND, 5, "pkt addr is %d:%d/%d.%d for %s", cz, cn, cf, cp, netname);
     /* do check */
     for (i = 0; i < state->nallfa; i++)
       if ( (cz < 0 || (state->fa+i)->z == cz) &&
@@ -387,7 +927,7 @@ int check_pkthdr(STATE *state, char *netname, char *tmp_name,
   }
   if (PKT != NULL) fclose(PKT);
   /* change pkt ext to bad */
-  if (check) Log (1, "bad pkt addr: %d:%d/%d.%d (file %s)", cz, cn, cf, cp, netname);
+  if (check) Logc (LOGC_INBOUND, 1, "bad pkt addr: %d:%d/%d.%d (file %s)", cz, cn, cf, cp, netname);
   i = strlen(real_name); check = 0;
   while (i > 0 && real_name[--i] != '.') check++;
   if (i > 0) {
@@ -462,10 +1002,12 @@ int inb_done (TFILE *file, STATE *state, BINKD_CONFIG *config)
 
   *real_name = 0;
   netname = file->netname;
+  if (file == &state->in)
+    inb_release (state);
 
   if (find_tmp_name (tmp_name, file, state, config) != 1)
   {
-    Log (1, "missing tmp file for %s!", netname);
+    Logc (LOGC_INBOUND, 1, "missing tmp file for %s!", netname);
     return 0;
   }
 
@@ -481,24 +1023,24 @@ int inb_done (TFILE *file, STATE *state, BINKD_CONFIG *config)
     /* Replacing .dt with .hr and removing temp. file */
     if (access(tmp_name, 0) == 0) sdelete (tmp_name);
     strcpy (strrchr (tmp_name, '.'), ".hr");
-    sdelete (tmp_name);
+    inb_forget (tmp_name, 0, file, state, config);
     return 1;
   }
 #endif
 
-  if (mask_test(netname, config->overwrite.first) && !ispkt(netname) && !isarcmail(netname))
+  if (maskset_next(config->overwrite_set, netname, 0) >= 0 && !ispkt(netname) && !isarcmail(netname))
   {
     for (i=0; ; i++)
     {
       unlinked |= (unlink(real_name) == 0);
       if (!RENAME (tmp_name, real_name))
       {
-        Log (1, "%s -> %s%s", netname, real_name, unlinked?" (overwrited)":"");
+        Logc (LOGC_INBOUND, 1, "%s -> %s%s", netname, real_name, unlinked?" (overwrited)":"");
         break;
       }
       if ((errno != EEXIST && errno != EACCES && errno != EAGAIN) || i==10)
       {
-        Log (1, "cannot rename %s to it's realname: %s! (data stored in %s)",
+        Logc (LOGC_INBOUND, 1, "cannot rename %s to it's realname: %s! (data stored in %s)",
              netname, strerror (errno), tmp_name);
         *real_name = 0;
         return 0;
@@ -521,18 +1063,18 @@ int inb_done (TFILE *file, STATE *state, BINKD_CONFIG *config)
     }
 
     if (touch (tmp_name, file->time) != 0)
-      Log (1, "touch %s: %s", tmp_name, strerror (errno));
+      Logc (LOGC_INBOUND, 1, "touch %s: %s", tmp_name, strerror (errno));
 
     while (RENAME (tmp_name, real_name))
     {
       if (errno != EEXIST && errno != EACCES && errno != EAGAIN)
       {
-        Log (1, "cannot rename %s to it's realname: %s! (data stored in %s)",
+        Logc (LOGC_INBOUND, 1, "cannot rename %s to it's realname: %s! (data stored in %s)",
              netname, strerror (errno), tmp_name);
         *real_name = 0;
         return 0;
       }
-      Log (2, "error renaming `%s' to `%s': %s",
+      Logc (LOGC_INBOUND, 2, "error renaming `%s' to `%s': %s",
            netname, real_name, strerror (errno));
 
       if (!next_inb_filename(real_name, &s, ren_style))
@@ -548,23 +1090,23 @@ int inb_done (TFILE *file, STATE *state, BINKD_CONFIG *config)
           strwipe (s);
           continue;
         }
-        Log (1, "cannot rename %s to it's realname! (data stored in %s)",
+        Logc (LOGC_INBOUND, 1, "cannot rename %s to it's realname! (data stored in %s)",
              netname, tmp_name);
         *real_name = 0;
         return 0;
       }
     }
-    Log (2, "%s -> %s", netname, real_name);
+    Logc (LOGC_INBOUND, 2, "%s -> %s", netname, real_name);
   }
 
   /* Replacing .dt with .hr and removing temp. file */
   strcpy (strrchr (tmp_name, '.'), ".hr");
-  sdelete (tmp_name);
+  inb_forget (tmp_name, 0, file, state, config);
 
   if (*real_name)
   {
     /* Set flags */
-    if (evt_test(&(state->evt_queue), real_name, config->evt_flags.first))
+    if (evt_test(&(state->evt_queue), real_name, config->evt_set))
       state->q = evt_run(state->q, real_name, state->delay_EOB > 0,
                          state, config);
   }
@@ -573,7 +1115,7 @@ int inb_done (TFILE *file, STATE *state, BINKD_CONFIG *config)
   ftnaddress_to_str (szAddr, state->fa);
   state->bytes_rcvd += file->size;
   state->files_rcvd++;
-  Log (2, "rcvd: %s (%" PRIuMAX ", %.2f CPS, %s)", file->netname,
+  Logc (LOGC_INBOUND, 2, "rcvd: %s (%" PRIuMAX ", %.2f CPS, %s)", file->netname,
        (uintmax_t) file->size,
        (double) (file->size) /
        (safe_time() == file->start ? 1 : (safe_time() - file->start)), szAddr);
@@ -17,6 +17,11 @@ int inb_test (char *filename, boff_t size, time_t t,
  */
 FILE *inb_fopen (STATE *state, BINKD_CONFIG *config);
 
+/*
+ * Free the space preallocated past the end of an interrupted partial file
+ */
+void inb_trim (STATE *state, BINKD_CONFIG *config);
+
 /*
  * File is complete, rename it to it's realname. 1=ok, 0=failed.
  * Sets realname[MAXPATHLEN]
@@ -33,4 +38,15 @@ int inb_reject (STATE *state, BINKD_CONFIG *config);
  */
 void inb_remove_partial (STATE *state, BINKD_CONFIG *config);
 
+/*
+ * Release the free space reserved for the file being received
+ */
+void inb_release (STATE *state);
+
+/*
+ * Init and free the index of partial files
+ */
+void inb_init (void);
+void inb_deinit (void);
+
 #endif
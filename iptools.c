@@ -24,10 +24,12 @@
 #include "Config.h"
 #include "iphdr.h"
 #include "common.h"
+#include "readcfg.h"
 #include "iptools.h"
 #include "tools.h"
 #include "sem.h"
 #include "rfc2553.h"
+#include "srv_gai.h"
 
 /*
  * Sets non-blocking mode for a given socket
@@ -41,7 +43,7 @@ void setsockopts (SOCKET s)
 
   arg = 1;
   if (ioctl (s, FIONBIO, (char *) &arg, sizeof arg) < 0)
-    Log (1, "ioctl (FIONBIO): %s", TCPERR ());
+    Logc (LOGC_NET, 1, "ioctl (FIONBIO): %s", TCPERR ());
 
 #elif defined(WIN32)
   u_long arg;
@@ -49,13 +51,43 @@ void setsockopts (SOCKET s)
   arg = 1;
   if (ioctlsocket (s, FIONBIO, &arg) < 0)
     if (!binkd_exit && TCPERRNO != WSAENOTSOCK)
-      Log (1, "ioctlsocket (FIONBIO): %s", TCPERR ());
+      Logc (LOGC_NET, 1, "ioctlsocket (FIONBIO): %s", TCPERR ());
 #endif
 #endif
 
 #if defined(UNIX) || defined(EMX) || defined(AMIGA)
   if (fcntl (s, F_SETFL, O_NONBLOCK) == -1)
-    Log (1, "fcntl: %s", strerror (errno));
+    Logc (LOGC_NET, 1, "fcntl: %s", strerror (errno));
+#endif
+}
+
+/*
+ * Sets blocking mode back for a given socket
+ */
+void setsockblock (SOCKET s)
+{
+
+#if defined(FIONBIO)
+#if defined(UNIX) || defined(IBMTCPIP) || defined(AMIGA)
+  int arg;
+
+  arg = 0;
+  if (ioctl (s, FIONBIO, (char *) &arg, sizeof arg) < 0)
+    Logc (LOGC_NET, 1, "ioctl (FIONBIO): %s", TCPERR ());
+
+#elif defined(WIN32)
+  u_long arg;
+
+  arg = 0;
+  if (ioctlsocket (s, FIONBIO, &arg) < 0)
+    if (!binkd_exit && TCPERRNO != WSAENOTSOCK)
+      Logc (LOGC_NET, 1, "ioctlsocket (FIONBIO): %s", TCPERR ());
+#endif
+#endif
+
+#if defined(UNIX) || defined(EMX) || defined(AMIGA)
+  if (fcntl (s, F_SETFL, fcntl (s, F_GETFL, 0) & ~O_NONBLOCK) == -1)
+    Logc (LOGC_NET, 1, "fcntl: %s", strerror (errno));
 #endif
 }
 
@@ -89,7 +121,7 @@ char * find_port (char *s)
     ps = DEF_PORT;
 
   if (ps == NULL)
-    Log (1, "%s: incorrect port (getaddrinfo: %s)", s, gai_strerror(aiErr));
+    Logc (LOGC_NET, 1, "%s: incorrect port (getaddrinfo: %s)", s, gai_strerror(aiErr));
 
   return ps;
 }
@@ -109,7 +141,7 @@ int sockaddr_cmp_addr(const struct sockaddr *a, const struct sockaddr *b)
 #endif
   else
   {
-    Log(2, "Unsupported address family: %d", a->sa_family);
+    Logc(LOGC_NET, 2, "Unsupported address family: %d", a->sa_family);
     return -1;
   }
 }
@@ -127,7 +159,372 @@ int sockaddr_cmp_port(const struct sockaddr *a, const struct sockaddr *b)
 #endif
   else
   {
-    Log(2, "Unsupported address family: %d", a->sa_family);
+    Logc(LOGC_NET, 2, "Unsupported address family: %d", a->sa_family);
     return -1;
   }
 }
+
+/*
+ * Resolver cache. Results of srv_getaddrinfo() are kept for
+ * dns-cache-ttl seconds, "host not found" for dns-negative-ttl seconds.
+ * getaddrinfo() does not report record TTLs, so these are upper bounds
+ * set in the config.
+ */
+#define DNS_HASH     256
+#define DNS_MAX      4096
+
+typedef struct _DNS_ENTRY DNS_ENTRY;
+struct _DNS_ENTRY
+{
+  DNS_ENTRY *next;
+  time_t expire;
+  int rc;                       /* 0 or EAI_* */
+  struct addrinfo *ai;          /* own copy, free with dns_free() */
+  int family, socktype, protocol, flags;
+  char *service;
+  char node[1];
+};
+
+static DNS_ENTRY *dns_tab[DNS_HASH];
+static int dns_num;
+
+#if defined(HAVE_THREADS)
+typedef struct _DNS_REQ DNS_REQ;
+struct _DNS_REQ
+{
+  DNS_REQ *next;
+  int family;
+  int ttl, negative_ttl;
+  char *service;
+  char node[1];
+};
+
+static DNS_REQ *dns_queue;
+static int dns_worker;          /* prefetch thread is running */
+static int dns_stop;            /* the cache is going down */
+#endif
+
+#if defined(HAVE_THREADS) || defined(AMIGA)
+static MUTEXSEM DSem;
+#endif
+
+/*
+ * Call this before all others dns_* and resolve_* functions.
+ */
+void dns_cache_init (void)
+{
+  InitSem (&DSem);
+}
+
+static void dns_free (struct addrinfo *ai)
+{
+  struct addrinfo *next;
+
+  for (; ai; ai = next)
+  {
+    next = ai->ai_next;
+    xfree (ai->ai_canonname);
+    free (ai);
+  }
+}
+
+/* Deep copy of an addrinfo list, ai_addr shares the block with the entry */
+static struct addrinfo *dns_copy (struct addrinfo *ai)
+{
+  struct addrinfo *head = NULL, **last = &head, *n;
+
+  for (; ai; ai = ai->ai_next)
+  {
+    n = xalloc (sizeof (struct addrinfo) + ai->ai_addrlen);
+    memcpy (n, ai, sizeof (struct addrinfo));
+    n->ai_addr = (struct sockaddr *) (n + 1);
+    memcpy (n->ai_addr, ai->ai_addr, ai->ai_addrlen);
+    n->ai_canonname = ai->ai_canonname ? xstrdup (ai->ai_canonname) : NULL;
+    n->ai_next = NULL;
+    *last = n;
+    last = &n->ai_next;
+  }
+  return head;
+}
+
+static void dns_entry_free (DNS_ENTRY *e)
+{
+  dns_free (e->ai);
+  xfree (e->service);
+  free (e);
+}
+
+void dns_cache_deinit (void)
+{
+  int i;
+  DNS_ENTRY *e;
+#if defined(HAVE_THREADS)
+  DNS_REQ *r;
+
+  /* drop the queue and wait for the request in progress */
+  LockSem (&DSem);
+  dns_stop = 1;
+  while ((r = dns_queue) != NULL)
+  {
+    dns_queue = r->next;
+    xfree (r->service);
+    free (r);
+  }
+  ReleaseSem (&DSem);
+  for (;;)
+  {
+    LockSem (&DSem);
+    i = dns_worker;
+    ReleaseSem (&DSem);
+    if (!i)
+      break;
+    sleep (1);
+  }
+#endif
+
+  for (i = 0; i < DNS_HASH; i++)
+    while ((e = dns_tab[i]) != NULL)
+    {
+      dns_tab[i] = e->next;
+      dns_entry_free (e);
+    }
+  dns_num = 0;
+  CleanSem (&DSem);
+}
+
+static unsigned dns_hash (const char *node, const char *service)
+{
+  unsigned h = 0;
+
+  for (; *node; node++)
+    h = h * 31 + tolower ((unsigned char) *node);
+  if (service)
+    for (; *service; service++)
+      h = h * 31 + (unsigned char) *service;
+  return h % DNS_HASH;
+}
+
+/* Must be called with DSem locked */
+static DNS_ENTRY **dns_find (const char *node, const char *service,
+                             const struct addrinfo *hints)
+{
+  DNS_ENTRY **pe;
+
+  for (pe = &dns_tab[dns_hash (node, service)]; *pe; pe = &(*pe)->next)
+    if (!STRICMP ((*pe)->node, node) &&
+        !strcmp ((*pe)->service ? (*pe)->service : "", service ? service : "") &&
+        (*pe)->family == hints->ai_family &&
+        (*pe)->socktype == hints->ai_socktype &&
+        (*pe)->protocol == hints->ai_protocol &&
+        (*pe)->flags == hints->ai_flags)
+      break;
+  return pe;
+}
+
+/*
+ * Resolves and stores the result; returns srv_getaddrinfo() retcode
+ * and, if res is not NULL, a copy of the result.
+ */
+static int dns_resolve (const char *node, const char *service,
+                        const struct addrinfo *hints, struct addrinfo **res,
+                        int ttl, int negative_ttl)
+{
+  struct addrinfo *ai = NULL;
+  DNS_ENTRY *e, **pe;
+  int rc;
+
+  rc = srv_getaddrinfo (node, service, hints, &ai);
+  if (res)
+    *res = (rc == 0) ? dns_copy (ai) : NULL;
+  if (rc == 0 ? ttl > 0 : (negative_ttl > 0 && (rc == EAI_NONAME
+#if defined(EAI_NODATA) && EAI_NODATA != EAI_NONAME
+                                                || rc == EAI_NODATA
+#endif
+     )))
+  {
+    e = xalloc (sizeof (DNS_ENTRY) + strlen (node));
+    memset (e, 0, sizeof (DNS_ENTRY));
+    strcpy (e->node, node);
+    e->service = service ? xstrdup (service) : NULL;
+    e->family = hints->ai_family;
+    e->socktype = hints->ai_socktype;
+    e->protocol = hints->ai_protocol;
+    e->flags = hints->ai_flags;
+    e->rc = rc;
+    e->ai = (rc == 0) ? dns_copy (ai) : NULL;
+    e->expire = safe_time () + (rc == 0 ? ttl : negative_ttl);
+    LockSem (&DSem);
+    pe = dns_find (node, service, hints);
+    if (*pe)
+    {
+      e->next = (*pe)->next;
+      dns_entry_free (*pe);
+      *pe = e;
+    }
+    else if (dns_num < DNS_MAX)
+    {
+      *pe = e;
+      dns_num++;
+    }
+    else
+    {
+      dns_entry_free (e);
+      e = NULL;
+    }
+    ReleaseSem (&DSem);
+    if (e)
+      Logc (LOGC_NET, 7, "resolved %s%s%s: %s", node, service ? ":" : "", service ? service : "",
+           rc == 0 ? "ok" : gai_strerror (rc));
+  }
+  if (rc == 0)
+    freeaddrinfo (ai);
+  return rc;
+}
+
+/*
+ * srv_getaddrinfo() through the cache. The result must be freed with
+ * cached_freeaddrinfo(), not freeaddrinfo().
+ */
+int cached_getaddrinfo (const char *node, const char *service,
+                        const struct addrinfo *hints, struct addrinfo **res,
+                        BINKD_CONFIG *config)
+{
+  DNS_ENTRY *e;
+  int rc;
+
+  if (node && *node && (config->dns_cache_ttl > 0 || config->dns_negative_ttl > 0))
+  {
+    LockSem (&DSem);
+    e = *dns_find (node, service, hints);
+    if (e && e->expire > safe_time ())
+    {
+      rc = e->rc;
+      *res = (rc == 0) ? dns_copy (e->ai) : NULL;
+      ReleaseSem (&DSem);
+      return rc;
+    }
+    ReleaseSem (&DSem);
+  }
+  return dns_resolve (node, service, hints, res,
+                      config->dns_cache_ttl, config->dns_negative_ttl);
+}
+
+void cached_freeaddrinfo (struct addrinfo *ai)
+{
+  dns_free (ai);
+}
+
+#if defined(HAVE_THREADS)
+static void dns_thread (void *arg)
+{
+  DNS_REQ *r;
+  struct addrinfo hints;
+
+  UNUSED_ARG(arg);
+  for (;;)
+  {
+    LockSem (&DSem);
+    if (dns_stop || (r = dns_queue) == NULL)
+    {
+      r = NULL;
+      dns_worker = 0;
+    }
+    else
+      dns_queue = r->next;
+    ReleaseSem (&DSem);
+    if (r == NULL)
+      break;
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = r->family;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    dns_resolve (r->node, r->service, &hints, NULL, r->ttl, r->negative_ttl);
+    xfree (r->service);
+    free (r);
+  }
+}
+#endif
+
+/*
+ * Resolves host:port (TCP) into the cache in background unless it is
+ * already there. Without threads it's a plain cached lookup, so a
+ * forking manager hands the result down to its children.
+ */
+void resolve_prefetch (const char *host, const char *port, int family, BINKD_CONFIG *config)
+{
+  struct addrinfo hints;
+  DNS_ENTRY *e;
+#if defined(HAVE_THREADS)
+  DNS_REQ *r, **pr;
+  int start = 0;
+#else
+  struct addrinfo *ai;
+#endif
+
+  if (config->dns_cache_ttl <= 0 || !host || !*host || !strcmp (host, "-"))
+    return;
+  memset (&hints, 0, sizeof (hints));
+  hints.ai_family = family;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+
+  LockSem (&DSem);
+  e = *dns_find (host, port, &hints);
+  if (e && e->expire > safe_time ())
+  {
+    ReleaseSem (&DSem);
+    return;
+  }
+#if defined(HAVE_THREADS)
+  if (dns_stop)
+  {
+    ReleaseSem (&DSem);
+    return;
+  }
+  for (pr = &dns_queue; *pr; pr = &(*pr)->next)
+    if (!STRICMP ((*pr)->node, host) && (*pr)->family == family &&
+        !strcmp ((*pr)->service ? (*pr)->service : "", port ? port : ""))
+      break;
+  if (*pr == NULL)
+  {
+    r = xalloc (sizeof (DNS_REQ) + strlen (host));
+    strcpy (r->node, host);
+    r->service = port ? xstrdup (port) : NULL;
+    r->family = family;
+    r->ttl = config->dns_cache_ttl;
+    r->negative_ttl = config->dns_negative_ttl;
+    r->next = NULL;
+    *pr = r;
+    if (!dns_worker)
+      start = dns_worker = 1;
+  }
+  ReleaseSem (&DSem);
+  if (start && branch (dns_thread, NULL, 0) < 0)
+  {
+    LockSem (&DSem);
+    dns_worker = 0;
+    ReleaseSem (&DSem);
+  }
+#else
+  ReleaseSem (&DSem);
+  if (dns_resolve (host, port, &hints, &ai, config->dns_cache_ttl,
+                   config->dns_negative_ttl) == 0)
+    dns_free (ai);
+#endif
+}
+
+/*
+ * Prefetches all hosts of the node
+ */
+void resolve_node_prefetch (FTN_NODE *node, BINKD_CONFIG *config)
+{
+  char host[BINKD_FQDNLEN + 5 + 1];
+  char *port;
+  int i, rc;
+
+  if (!node->hosts || (node->pipe && node->pipe[0]))
+    return;
+  for (i = 1; (rc = get_host_and_port (i, host, &port, node->hosts, &node->fa, config)) != -1; i++)
+    if (rc == 1)
+      resolve_prefetch (host, port, node->IP_afamily, config);
+}
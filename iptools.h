@@ -16,6 +16,11 @@
  */
 void setsockopts (SOCKET s);
 
+/*
+ * Sets blocking mode back for a given socket
+ */
+void setsockblock (SOCKET s);
+
 /*
  * Find the port number (in the host byte order) by a port number string or
  * a service name. Find_port ("") will return binkp's port from
@@ -29,3 +34,15 @@ char * find_port (char *s);
  */
 extern int sockaddr_cmp_addr(const struct sockaddr *, const struct sockaddr *);
 extern int sockaddr_cmp_port(const struct sockaddr *, const struct sockaddr *);
+
+/*
+ * Resolver cache (dns-cache-ttl, dns-negative-ttl)
+ */
+void dns_cache_init (void);
+void dns_cache_deinit (void);
+int cached_getaddrinfo (const char *node, const char *service,
+                        const struct addrinfo *hints, struct addrinfo **res,
+                        BINKD_CONFIG *config);
+void cached_freeaddrinfo (struct addrinfo *ai);
+void resolve_prefetch (const char *host, const char *port, int family, BINKD_CONFIG *config);
+void resolve_node_prefetch (FTN_NODE *node, BINKD_CONFIG *config);
@@ -642,12 +642,12 @@ MUTEXSEM perlsem;
         def_state();                                               \
         sv = perl_get_sv(sv_state, FALSE);                         \
         if (!sv) {                                                 \
-          Log(LL_ERR, "can't find $%s pointer", sv_state);         \
+          Logc(LOGC_PERL, LL_ERR, "can't find $%s pointer", sv_state);         \
           state = NULL;                                            \
         } else {                                                   \
           state = *((STATE**)SvPV(sv, n_a));                       \
           if (!(state) || !n_a) {                                  \
-            Log(LL_ERR, "$%s pointer is NULL", sv_state);          \
+            Logc(LOGC_PERL, LL_ERR, "$%s pointer is NULL", sv_state);          \
             state = NULL;                                          \
           }                                                        \
         }                                                          \
@@ -784,7 +784,7 @@ static void perl_warn_str (char* str) {
     char* cp = strchr (str, '\n');
     char  c  = 0;
     if (cp) { c = *cp; *cp = 0; }
-    Log(LL_ERR, "Perl error: %s", str);
+    Logc(LOGC_PERL, LL_ERR, "Perl error: %s", str);
     if (cp) *cp = c;
     else break;
     str = cp + 1;
@@ -820,19 +820,19 @@ static void sub_err(int sub) {
   else
     s = xstrdup("(empty error message)");
   if ( strchr(s, '\n') == NULL )
-    Log(LL_ERR, "Perl %s error: %s", perl_subnames[sub], s);
+    Logc(LOGC_PERL, LL_ERR, "Perl %s error: %s", perl_subnames[sub], s);
   else {
     p = s;
-    Log(LL_ERR, "Perl %s error below:", perl_subnames[sub]);
+    Logc(LOGC_PERL, LL_ERR, "Perl %s error below:", perl_subnames[sub]);
     while ( *p && (*p != '\n' || *(p+1)) ) {
       char *r = strchr(p, '\n');
       if (r) {
         *r = 0;
-        Log(LL_ERR, "  %s", p);
+        Logc(LOGC_PERL, LL_ERR, "  %s", p);
         p = r+1;
       }
       else {
-        Log(LL_ERR, "  %s", p);
+        Logc(LOGC_PERL, LL_ERR, "  %s", p);
         break;
       }
     }
@@ -870,7 +870,7 @@ static void sub_err(int sub) {
   STRLEN n_a;
 
   if (items != 1 && items != 2)
-  { Log(LL_ERR, "wrong params number to Log (need 1 or 2, exist %d)", items);
+  { Logc(LOGC_PERL, LL_ERR, "wrong params number to Log (need 1 or 2, exist %d)", items);
     XSRETURN_EMPTY;
   }
   if (items == 2) {
@@ -880,7 +880,7 @@ static void sub_err(int sub) {
     lvl = LL_LOG;
     str = (char *)SvPV(ST(0), n_a); if (n_a == 0) str = "";
   }
-  Log(lvl, "%s", str);
+  Logc(LOGC_PERL, lvl, "%s", str);
   XSRETURN_EMPTY;
 }
 /* returns 1 if the first addr matches to any of the rest */
@@ -899,7 +899,7 @@ static void sub_err(int sub) {
   int mask_mode = 0;
 
   if (items == 1) { 
-    Log(LL_ERR, "aeq() requires 2 or more parameters, %d exist", items);
+    Logc(LOGC_PERL, LL_ERR, "aeq() requires 2 or more parameters, %d exist", items);
     XSRETURN_UNDEF;
   }
   VK_FIND_CONFIG(cfg);
@@ -939,11 +939,11 @@ static void sub_err(int sub) {
   SV **svp;
 
   if (items == 1) { 
-    Log(LL_ERR, "arm() requires 2 or more parameters, %d exist", items);
+    Logc(LOGC_PERL, LL_ERR, "arm() requires 2 or more parameters, %d exist", items);
     XSRETURN_UNDEF;
   }
   if (!SvROK(ST(0)) || SvTYPE(SvRV(ST(0))) != SVt_PVAV) {
-    Log(LL_ERR, "first parameter to arm() should be array reference");
+    Logc(LOGC_PERL, LL_ERR, "first parameter to arm() should be array reference");
     XSRETURN_UNDEF;
   }
   VK_FIND_CONFIG(cfg);
@@ -1001,7 +1001,7 @@ extern void msg_send2 (STATE *state, t_msg m, char *s1, char *s2);
   STRLEN n_a;
 
   if (items != 2) {
-    Log(LL_ERR, "wrong params number to msg_send (needs 2, exist %d)", items);
+    Logc(LOGC_PERL, LL_ERR, "wrong params number to msg_send (needs 2, exist %d)", items);
     XSRETURN_EMPTY;
   }
   FIND_STATE(state);
@@ -1099,7 +1099,7 @@ static void perl_setup(BINKD_CONFIG *cfg, PerlInterpreter *perl) {
   int   i;
 
   if (!perl) return;
-  Log(LL_DBG, "perl_setup(): perl context %p", perl);
+  Logc(LOGC_PERL, LL_DBG, "perl_setup(): perl context %p", perl);
 
   hv = perl_get_hv("config", TRUE);
   hv_clear(hv);
@@ -1143,7 +1143,7 @@ static void perl_setup(BINKD_CONFIG *cfg, PerlInterpreter *perl) {
 	  cur = cur->next;
 	}
   }
-  Log(LL_DBG2, "perl_setup(): %%config done");
+  Logc(LOGC_PERL, LL_DBG2, "perl_setup(): %%config done");
   /* domain */
   hv = perl_get_hv("domain", TRUE);
   hv_clear(hv);
@@ -1171,7 +1171,7 @@ static void perl_setup(BINKD_CONFIG *cfg, PerlInterpreter *perl) {
       cur = cur->next;
     }
   }
-  Log(LL_DBG2, "perl_setup(): %%domain done");
+  Logc(LOGC_PERL, LL_DBG2, "perl_setup(): %%domain done");
   /* address -> me */
   av = perl_get_av("addr", TRUE);
   av_clear(av);
@@ -1181,7 +1181,7 @@ static void perl_setup(BINKD_CONFIG *cfg, PerlInterpreter *perl) {
     SvREADONLY_on(sv);
     av_push(av, sv);
   }
-  Log(LL_DBG2, "perl_setup(): @addr done");
+  Logc(LOGC_PERL, LL_DBG2, "perl_setup(): @addr done");
   /* listen */
   av = perl_get_av("listen", TRUE);
   av_clear(av);
@@ -1197,7 +1197,7 @@ static void perl_setup(BINKD_CONFIG *cfg, PerlInterpreter *perl) {
       cur = cur->next;
     }
   }
-  Log(LL_DBG2, "perl_setup(): @listen done");
+  Logc(LOGC_PERL, LL_DBG2, "perl_setup(): @listen done");
   /* ftrans */
   av = perl_get_av("ftrans", TRUE);
   av_clear(av);
@@ -1212,7 +1212,7 @@ static void perl_setup(BINKD_CONFIG *cfg, PerlInterpreter *perl) {
       cur = cur->next;
     }
   }
-  Log(LL_DBG2, "perl_setup(): @ftrans done");
+  Logc(LOGC_PERL, LL_DBG2, "perl_setup(): @ftrans done");
   /* overwrite */
   av = perl_get_av("overwrite", TRUE);
   av_clear(av);
@@ -1225,7 +1225,7 @@ static void perl_setup(BINKD_CONFIG *cfg, PerlInterpreter *perl) {
       cur = cur->next;
     }
   }
-  Log(LL_DBG2, "perl_setup(): @overwrite done");
+  Logc(LOGC_PERL, LL_DBG2, "perl_setup(): @overwrite done");
   /* skip */
   av = perl_get_av("skip", TRUE);
   av_clear(av);
@@ -1242,7 +1242,7 @@ static void perl_setup(BINKD_CONFIG *cfg, PerlInterpreter *perl) {
       cur = cur->next;
     }
   }
-  Log(LL_DBG2, "perl_setup(): @skip done");
+  Logc(LOGC_PERL, LL_DBG2, "perl_setup(): @skip done");
   /* share */
   hv = perl_get_hv("share", TRUE);
   hv_clear(hv);
@@ -1265,12 +1265,12 @@ static void perl_setup(BINKD_CONFIG *cfg, PerlInterpreter *perl) {
       cur = cur->next;
     }
   }
-  Log(LL_DBG2, "perl_setup(): %%share done");
+  Logc(LOGC_PERL, LL_DBG2, "perl_setup(): %%share done");
   /* node */
   hv = perl_get_hv("node", TRUE);
   hv_clear(hv);
   foreach_node(add_node_to_hv, hv, cfg);
-  Log(LL_DBG2, "perl_setup(): %%node done");
+  Logc(LOGC_PERL, LL_DBG2, "perl_setup(): %%node done");
 }
 
 /* init root perl, parse hooks file, return success */
@@ -1283,20 +1283,20 @@ int perl_init(char *perlfile, BINKD_CONFIG *cfg) {
   char **perlenv = saved_envp;
   PerlInterpreter *perl;
 
-  Log(LL_DBG, "perl_init(): %s", perlfile);
+  Logc(LOGC_PERL, LL_DBG, "perl_init(): %s", perlfile);
   /* try to find out the actual path to perl script and set dir to -I */
   i = 1;
   perlargs[i++] = "-e";
   perlargs[i++] = "0";
   /* check perm */
   if (access(perlfile, R_OK)) {
-    Log(LL_ERR, "Cannot open %s: %s", perlfile, strerror(errno));
+    Logc(LOGC_PERL, LL_ERR, "Cannot open %s: %s", perlfile, strerror(errno));
     return 0;
   }
 #ifdef PERLDL
   /* load DLL */
   if (!cfg->perl_dll[0]) {
-    Log(LL_ERR, "You should define `perl-dll' in config to use Perl hooks");
+    Logc(LOGC_PERL, LL_ERR, "You should define `perl-dll' in config to use Perl hooks");
     return 0;
   } else if (*(perl_dlfuncs->f) == NULL) { /* not already loaded */
     struct perl_dlfunc *dlfunc;
@@ -1309,10 +1309,10 @@ int perl_init(char *perlfile, BINKD_CONFIG *cfg) {
     if (!hl)
 #endif
     {
-      Log(LL_ERR, "perl_init(): can't load library %s", cfg->perl_dll);
+      Logc(LOGC_PERL, LL_ERR, "perl_init(): can't load library %s", cfg->perl_dll);
       return 0;
     }
-    Log(LL_DBG2, "perl_init(): load library: %p", hl);
+    Logc(LOGC_PERL, LL_DBG2, "perl_init(): load library: %p", hl);
 
     for (dlfunc = perl_dlfuncs; dlfunc->name; dlfunc++) {
 #ifdef OS2
@@ -1320,9 +1320,9 @@ int perl_init(char *perlfile, BINKD_CONFIG *cfg) {
 #else
       if ((*(dlfunc->f) = GetProcAddress(hl, dlfunc->name)))
 #endif
-        Log(LL_DBG2, "perl_init(): load method %s: %p", dlfunc->name, *(dlfunc->f));
+        Logc(LOGC_PERL, LL_DBG2, "perl_init(): load method %s: %p", dlfunc->name, *(dlfunc->f));
       else {
-        Log(LL_ERR, "perl_init(): can't load method %s", dlfunc->name);
+        Logc(LOGC_PERL, LL_ERR, "perl_init(): can't load method %s", dlfunc->name);
         return 0;
       }
     }
@@ -1330,22 +1330,22 @@ int perl_init(char *perlfile, BINKD_CONFIG *cfg) {
     {
       if (!DosQueryProcAddr(hl, 0, "Perl_sv_2pv", (PFN*)dl_Perl_sv_2pv) &&
           !DosQueryProcAddr(hl, 0, "Perl_sv_2pv_flags", (PFN*)dl_Perl_sv_2pv_flags)) {
-        Log(LL_ERR, "perl_init(): can't load method Perl_sv_2pv or Perl_sv_2pv_flags");
+        Logc(LOGC_PERL, LL_ERR, "perl_init(): can't load method Perl_sv_2pv or Perl_sv_2pv_flags");
         return 0;
       }
       if (!DosQueryProcAddr(hl, 0, "Perl_sv_2uv", (PFN*)dl_Perl_sv_2uv) &&
           !DosQueryProcAddr(hl, 0, "Perl_sv_2uv_flags", (PFN*)dl_Perl_sv_2uv_flags)) {
-        Log(LL_ERR, "perl_init(): can't load method Perl_sv_2uv or Perl_sv_2uv_flags");
+        Logc(LOGC_PERL, LL_ERR, "perl_init(): can't load method Perl_sv_2uv or Perl_sv_2uv_flags");
         return 0;
       }
       if (!DosQueryProcAddr(hl, 0, "Perl_sv_2iv", (PFN*)dl_Perl_sv_2iv) &&
           !DosQueryProcAddr(hl, 0, "Perl_sv_2iv_flags", (PFN*)dl_Perl_sv_2iv_flags)) {
-        Log(LL_ERR, "perl_init(): can't load method Perl_sv_2iv or Perl_sv_2iv_flags");
+        Logc(LOGC_PERL, LL_ERR, "perl_init(): can't load method Perl_sv_2iv or Perl_sv_2iv_flags");
         return 0;
       }
       if (!DosQueryProcAddr(hl, 0, "Perl_sv_setsv", (PFN*)dl_Perl_sv_setsv) &&
           !DosQueryProcAddr(hl, 0, "Perl_sv_setsv_flags", (PFN*)dl_Perl_sv_setsv_flags)) {
-        Log(LL_ERR, "perl_init(): can't load method Perl_sv_setsv or Perl_sv_setsv_flags");
+        Logc(LOGC_PERL, LL_ERR, "perl_init(): can't load method Perl_sv_setsv or Perl_sv_setsv_flags");
         return 0;
       }
     }
@@ -1354,25 +1354,25 @@ int perl_init(char *perlfile, BINKD_CONFIG *cfg) {
       *(void**)&dl_Perl_sv_2pv = GetProcAddress(hl, "Perl_sv_2pv");
       *(void**)&dl_Perl_sv_2pv_flags = GetProcAddress(hl, "Perl_sv_2pv_flags");
       if (!dl_Perl_sv_2pv && !dl_Perl_sv_2pv_flags) {
-        Log(LL_ERR, "perl_init(): can't load method Perl_sv_2pv or Perl_sv_2pv_flags");
+        Logc(LOGC_PERL, LL_ERR, "perl_init(): can't load method Perl_sv_2pv or Perl_sv_2pv_flags");
         return 0;
       }
       *(void**)&dl_Perl_sv_2uv = GetProcAddress(hl, "Perl_sv_2uv");
       *(void**)&dl_Perl_sv_2uv_flags = GetProcAddress(hl, "Perl_sv_2uv_flags");
       if (!dl_Perl_sv_2uv && !dl_Perl_sv_2uv_flags) {
-        Log(LL_ERR, "perl_init(): can't load method Perl_sv_2uv or Perl_sv_2uv_flags");
+        Logc(LOGC_PERL, LL_ERR, "perl_init(): can't load method Perl_sv_2uv or Perl_sv_2uv_flags");
         return 0;
       }
       *(void**)&dl_Perl_sv_2iv = GetProcAddress(hl, "Perl_sv_2iv");
       *(void**)&dl_Perl_sv_2iv_flags = GetProcAddress(hl, "Perl_sv_2iv_flags");
       if (!dl_Perl_sv_2iv && !dl_Perl_sv_2iv_flags) {
-        Log(LL_ERR, "perl_init(): can't load method Perl_sv_2iv or Perl_sv_2iv_flags");
+        Logc(LOGC_PERL, LL_ERR, "perl_init(): can't load method Perl_sv_2iv or Perl_sv_2iv_flags");
         return 0;
       }
       *(void**)&dl_Perl_sv_setsv = GetProcAddress(hl, "Perl_sv_setsv");
       *(void**)&dl_Perl_sv_setsv_flags = GetProcAddress(hl, "Perl_sv_setsv_flags");
       if (!dl_Perl_sv_setsv && !dl_Perl_sv_setsv_flags) {
-        Log(LL_ERR, "perl_init(): can't load method Perl_sv_setv or Perl_sv_setsv_flags");
+        Logc(LOGC_PERL, LL_ERR, "perl_init(): can't load method Perl_sv_setv or Perl_sv_setsv_flags");
       }
     }
 #endif
@@ -1386,12 +1386,12 @@ int perl_init(char *perlfile, BINKD_CONFIG *cfg) {
   PERL_SET_CONTEXT(perl);
   perl_construct(perl);
   rc = perl_parse(perl, xs_init, i, perlargv, (char **)NULL);
-  Log(LL_DBG, "perl_init(): parse rc=%d", rc);
+  Logc(LOGC_PERL, LL_DBG, "perl_init(): parse rc=%d", rc);
   /* can't parse */
   if (rc) {
     perl_destruct(perl);
     perl_free(perl);
-    Log(LL_ERR, "Can't parse %s, perl filtering disabled", perlfile);
+    Logc(LOGC_PERL, LL_ERR, "Can't parse %s, perl filtering disabled", perlfile);
     return 0;
   }
   /* setup consts */
@@ -1407,13 +1407,13 @@ int perl_init(char *perlfile, BINKD_CONFIG *cfg) {
   PL_diehook  = newRV_inc ((SV*) perl_get_cv ("binkd_warn", TRUE));
 
   /* run main program body */
-  Log(LL_DBG, "perl_init(): running body");
+  Logc(LOGC_PERL, LL_DBG, "perl_init(): running body");
   cmd = xstrdup ("do '");
   xstrcat (&cmd, perlfile);
   xstrcat (&cmd, "'; $@ ? $@ : '';");
   sv = perl_eval_pv (cmd, TRUE);
   if (!SvPOK(sv)) {
-    Log(LL_ERR, "Syntax error in internal perl expression: %s", cmd);
+    Logc(LOGC_PERL, LL_ERR, "Syntax error in internal perl expression: %s", cmd);
     rc = 1;
   } else if (SvTRUE (sv)) {
     perl_warn_sv (sv);
@@ -1429,18 +1429,20 @@ int perl_init(char *perlfile, BINKD_CONFIG *cfg) {
   for (i = 0; i < sizeof(perl_subnames)/sizeof(perl_subnames[0]); i++) {
     if (perl_get_cv(perl_subnames[i], FALSE)) cfg->perl_ok |= (1 << i);
   }
+  if (cfg->perl_ok & (1 << PERL_ON_LOG))
+    log_hook();
 #if defined(HAVE_THREAD) && defined(PERL_MULTITHREAD)
   InitSem (&perlsem);
 #endif
   cfg->perl = perl;
-  Log(LL_DBG, "perl_init(): end");
+  Logc(LOGC_PERL, LL_DBG, "perl_init(): end");
   return 1;
 }
 
 /* exit, just before destruction */
 static void perl_on_exit(BINKD_CONFIG *cfg) {
   if (cfg->perl_ok & (1 << PERL_ON_EXIT)) {
-     Log(LL_DBG, "perl_on_exit(), perl");
+     Logc(LOGC_PERL, LL_DBG, "perl_on_exit(), perl");
      { dSP;
        ENTER;
        SAVETMPS;
@@ -1453,25 +1455,25 @@ static void perl_on_exit(BINKD_CONFIG *cfg) {
        LEAVE;
      }
      if (SvTRUE(ERRSV)) sub_err(PERL_ON_EXIT);
-     Log(LL_DBG, "perl_on_exit() end");
+     Logc(LOGC_PERL, LL_DBG, "perl_on_exit() end");
   }
 }
 
 /* deallocate root perl, call on_exit() if master==1 */
 void perl_done(BINKD_CONFIG *cfg, int master) {
-  Log(LL_DBG, "perl_done(): perl=%p", cfg->perl);
+  Logc(LOGC_PERL, LL_DBG, "perl_done(): perl=%p", cfg->perl);
   if (cfg->perl) {
     PERL_SET_CONTEXT((PerlInterpreter *)cfg->perl);
     /* run on_exit() */
     if (master) perl_on_exit(cfg);
     /* de-allocate */
-    Log(LL_DBG, "perl_done(): destructing perl %p", cfg->perl);
+    Logc(LOGC_PERL, LL_DBG, "perl_done(): destructing perl %p", cfg->perl);
 #ifndef _MSC_VER
     perl_destruct((PerlInterpreter *)cfg->perl);
     perl_free((PerlInterpreter *)cfg->perl);
 #endif
     cfg->perl = NULL;
-    Log(LL_DBG, "perl_done(): end");
+    Logc(LOGC_PERL, LL_DBG, "perl_done(): end");
   }
   if (current_config && current_config->perl)
     PERL_SET_CONTEXT((PerlInterpreter *)current_config->perl);
@@ -1486,7 +1488,7 @@ void *perl_init_clone(BINKD_CONFIG *cfg) {
   PerlInterpreter *p;
 
   if (cfg->perl) {
-    Log(LL_DBG2, "perl_init_clone(), parent perl=%p, context=%p", cfg->perl, Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG2, "perl_init_clone(), parent perl=%p, context=%p", cfg->perl, Perl_get_context());
     PERL_SET_CONTEXT((PerlInterpreter *)cfg->perl);
 #ifndef PERL_MULTITHREAD
 #if defined(WIN32) && defined(CLONEf_CLONE_HOST)
@@ -1508,12 +1510,12 @@ void *perl_init_clone(BINKD_CONFIG *cfg) {
     }
   }
   else p = NULL;
-  Log(LL_DBG, "perl_init_clone(): new clone %p", p);
+  Logc(LOGC_PERL, LL_DBG, "perl_init_clone(): new clone %p", p);
   return p;
 }
 /* destruct a clone */
 void perl_done_clone(void *p) {
-  Log(LL_DBG, "perl_done_clone(): destructing clone %p", p);
+  Logc(LOGC_PERL, LL_DBG, "perl_done_clone(): destructing clone %p", p);
   if (p == NULL) return;
   CLEAR_CONFIG;
   PL_perl_destruct_level = 2;
@@ -1551,7 +1553,7 @@ static void setup_session(STATE *state, int lvl) {
   BINKD_CONFIG *cfg = state->config;
 
   if (!Perl_get_context()) return;
-  Log(LL_DBG2, "perl_setup_session(), perl context %p", Perl_get_context());
+  Logc(LOGC_PERL, LL_DBG2, "perl_setup_session(), perl context %p", Perl_get_context());
 
   /* lvl 1 */
   if (lvl >= 1 && state->perl_set_lvl < 1) {
@@ -1612,7 +1614,7 @@ static void setup_session(STATE *state, int lvl) {
     VK_ADD_intz(sv, "files_rcvd", state->files_rcvd);
     VK_ADD_intz(sv, "files_sent", state->files_sent);
   }
-  Log(LL_DBG2, "perl_setup_session() end");
+  Logc(LOGC_PERL, LL_DBG2, "perl_setup_session() end");
 }
 
 /* setup a queue */
@@ -1623,7 +1625,7 @@ static void setup_queue(STATE *state, FTNQ *queue) {
   SV   *sv;
   FTNQ *q;
 
-  Log(LL_DBG2, "perl_setup_queue()");
+  Logc(LOGC_PERL, LL_DBG2, "perl_setup_queue()");
   av = perl_get_av("queue", TRUE);
   av_clear(av);
   for (q = queue; q; q = q->next) {
@@ -1643,7 +1645,7 @@ static void setup_queue(STATE *state, FTNQ *queue) {
     sv = newRV_noinc( (SV*)hv );
     av_push(av, (SV*)sv);
   }
-  Log(LL_DBG2, "perl_setup_queue() end");
+  Logc(LOGC_PERL, LL_DBG2, "perl_setup_queue() end");
 }
 
 /* refresh queue */
@@ -1657,10 +1659,10 @@ static FTNQ *refresh_queue(STATE *state, FTNQ *queue) {
   char *s;
   BINKD_CONFIG *cfg;
 
-  Log(LL_DBG2, "perl_refresh_queue()");
+  Logc(LOGC_PERL, LL_DBG2, "perl_refresh_queue()");
   cfg = state->config;
   av = perl_get_av("queue", FALSE);
-  if (!av) { Log(LL_DBG2, "perl_refresh_queue(): @queue undefined"); return queue; }
+  if (!av) { Logc(LOGC_PERL, LL_DBG2, "perl_refresh_queue(): @queue undefined"); return queue; }
   n = av_len(av) + 1;
   for (i = 0; i < n; i++) {
     svp = av_fetch(av, i, 0);
@@ -1701,7 +1703,7 @@ static FTNQ *refresh_queue(STATE *state, FTNQ *queue) {
     } else q->fa = state->fa[0];
   }
   if (queue != SCAN_LISTED) q_free(queue, cfg);
-  Log(LL_DBG2, "perl_refresh_queue() end");
+  Logc(LOGC_PERL, LL_DBG2, "perl_refresh_queue() end");
   return q0;
 }
 
@@ -1710,7 +1712,7 @@ static FTNQ *refresh_queue(STATE *state, FTNQ *queue) {
 /* start, after init */
 void perl_on_start(BINKD_CONFIG *cfg) {
   if (cfg->perl_ok & (1 << PERL_ON_START)) {
-     Log(LL_DBG, "perl_on_start()");
+     Logc(LOGC_PERL, LL_DBG, "perl_on_start()");
      lockperlsem();
      { dSP;
        ENTER;
@@ -1725,10 +1727,10 @@ void perl_on_start(BINKD_CONFIG *cfg) {
      }
      if (SvTRUE(ERRSV)) sub_err(PERL_ON_START);
 /*     {
-       Log(LL_ERR, "Perl on_start() error: %s", SvPV(ERRSV, n_a));
+       Logc(LOGC_PERL, LL_ERR, "Perl on_start() error: %s", SvPV(ERRSV, n_a));
      }*/
      releaseperlsem();
-     Log(LL_DBG, "perl_on_start() end");
+     Logc(LOGC_PERL, LL_DBG, "perl_on_start() end");
   }
 }
 
@@ -1748,7 +1750,7 @@ int perl_on_call(FTN_NODE *node, BINKD_CONFIG *cfg, char **hosts
 #endif
 
   if (cfg->perl_ok & (1 << PERL_ON_CALL)) {
-    Log(LL_DBG, "perl_on_call(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG, "perl_on_call(), perl=%p", Perl_get_context());
     if (!Perl_get_context()) return 1;
     lockperlsem();
     { dSP;
@@ -1812,7 +1814,7 @@ int perl_on_call(FTN_NODE *node, BINKD_CONFIG *cfg, char **hosts
       }
     }
     releaseperlsem();
-    Log(LL_DBG, "perl_on_call() end");
+    Logc(LOGC_PERL, LL_DBG, "perl_on_call() end");
     return rc;
   }
   return 1;
@@ -1825,7 +1827,7 @@ int perl_on_error(BINKD_CONFIG *cfg, FTN_ADDR *addr, const char *error, const in
   SV     *svret, *sv;
 
   if (cfg->perl_ok & (1 << PERL_ON_ERROR)) {
-    Log(LL_DBG, "perl_on_error(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG, "perl_on_error(), perl=%p", Perl_get_context());
     if (!Perl_get_context()) return 1;
     lockperlsem();
     { dSP;
@@ -1847,7 +1849,7 @@ int perl_on_error(BINKD_CONFIG *cfg, FTN_ADDR *addr, const char *error, const in
       if (SvTRUE(ERRSV)) sub_err(PERL_ON_ERROR);
     }
     releaseperlsem();
-    Log(LL_DBG, "perl_on_error() end");
+    Logc(LOGC_PERL, LL_DBG, "perl_on_error() end");
     return rc;
   }
   return 1;
@@ -1869,7 +1871,7 @@ char *perl_on_handshake(STATE *state) {
     SET_STATE(state);
   }
   if (cfg->perl_ok & (1 << PERL_ON_HANDSHAKE)) {
-    Log(LL_DBG, "perl_on_handshake(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG, "perl_on_handshake(), perl=%p", Perl_get_context());
     if (!Perl_get_context()) return NULL;
     lockperlsem();
     { dSP;
@@ -1929,7 +1931,7 @@ char *perl_on_handshake(STATE *state) {
             state->pAddr[n++] = addr;
           }
           state->nAddr = n;
-          if (n == 0) Log(LL_WARN, "Perl on_handshake(): @me contains no valid addresses");
+          if (n == 0) Logc(LOGC_PERL, LL_WARN, "Perl on_handshake(): @me contains no valid addresses");
         }
         if ((passwd = perl_get_sv("passwd", FALSE)) != NULL && SvOK(passwd)) {
           strncpy(state->expected_pwd, SvPV(passwd, len), sizeof(state->expected_pwd));
@@ -1939,7 +1941,7 @@ char *perl_on_handshake(STATE *state) {
       }
     }
     releaseperlsem();
-    Log(LL_DBG, "perl_on_handshake() end");
+    Logc(LOGC_PERL, LL_DBG, "perl_on_handshake() end");
     return prc;
   }
   return NULL;
@@ -1953,7 +1955,7 @@ char *perl_after_handshake(STATE *state) {
   BINKD_CONFIG *cfg = state->config;
 
   if (cfg->perl_ok & (1 << PERL_AFTER_HANDSHAKE)) {
-    Log(LL_DBG, "perl_after_handshake(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG, "perl_after_handshake(), perl=%p", Perl_get_context());
     if (!Perl_get_context()) return NULL;
     lockperlsem();
     { dSP;
@@ -1979,7 +1981,7 @@ char *perl_after_handshake(STATE *state) {
         state->q = refresh_queue(state, state->q);
     }
     releaseperlsem();
-    Log(LL_DBG, "perl_after_handshake() end");
+    Logc(LOGC_PERL, LL_DBG, "perl_after_handshake() end");
     return prc;
   }
   return NULL;
@@ -1995,7 +1997,7 @@ void perl_after_session(STATE *state, int status) {
   }
 
   if (cfg->perl_ok & (1 << PERL_AFTER_SESSION)) {
-    Log(LL_DBG, "perl_after_session(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG, "perl_after_session(), perl=%p", Perl_get_context());
     if (!Perl_get_context()) return;
     lockperlsem();
     { dSP;
@@ -2013,7 +2015,7 @@ void perl_after_session(STATE *state, int status) {
       if (SvTRUE(ERRSV)) sub_err(PERL_AFTER_SESSION);
     }
     releaseperlsem();
-    Log(LL_DBG, "perl_after_session() end");
+    Logc(LOGC_PERL, LL_DBG, "perl_after_session() end");
   }
 }
 
@@ -2024,7 +2026,7 @@ int perl_before_recv(STATE *state, boff_t offs) {
   BINKD_CONFIG *cfg = state->config;
 
   if (cfg->perl_ok & (1 << PERL_BEFORE_RECV)) {
-    Log(LL_DBG, "perl_before_recv(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG, "perl_before_recv(), perl=%p", Perl_get_context());
     if (!Perl_get_context()) return 0;
     lockperlsem();
     { dSP;
@@ -2051,7 +2053,7 @@ int perl_before_recv(STATE *state, boff_t offs) {
       }
     }
     releaseperlsem();
-    Log(LL_DBG, "perl_before_recv() end");
+    Logc(LOGC_PERL, LL_DBG, "perl_before_recv() end");
     return rc;
   }
   return 0;
@@ -2067,7 +2069,7 @@ int perl_after_recv(STATE *state, TFILE *file, char *tmp_name, char *real_name)
   BINKD_CONFIG *cfg = state->config;
 
   if (cfg->perl_ok & (1 << PERL_AFTER_RECV)) {
-    Log(LL_DBG, "perl_after_recv(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG, "perl_after_recv(), perl=%p", Perl_get_context());
     if (!Perl_get_context()) return 0;
     lockperlsem();
     { dSP;
@@ -2109,7 +2111,7 @@ int perl_after_recv(STATE *state, TFILE *file, char *tmp_name, char *real_name)
       }
     }
     releaseperlsem();
-    Log(LL_DBG, "perl_after_recv() end");
+    Logc(LOGC_PERL, LL_DBG, "perl_after_recv() end");
     return rc;
   }
   return 0;
@@ -2123,7 +2125,7 @@ int perl_before_send(STATE *state) {
   BINKD_CONFIG *cfg = state->config;
 
   if (cfg->perl_ok & (1 << PERL_BEFORE_SEND)) {
-    Log(LL_DBG, "perl_before_send(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG, "perl_before_send(), perl=%p", Perl_get_context());
     if (!Perl_get_context()) return 0;
     lockperlsem();
     { dSP;
@@ -2161,7 +2163,7 @@ int perl_before_send(STATE *state) {
       }
     }
     releaseperlsem();
-    Log(LL_DBG, "perl_before_send() end");
+    Logc(LOGC_PERL, LL_DBG, "perl_before_send() end");
     return rc;
   }
   return 0;
@@ -2176,7 +2178,7 @@ int perl_after_sent(STATE *state, int n) {
   BINKD_CONFIG *cfg = state->config;
 
   if (cfg->perl_ok & (1 << PERL_AFTER_SENT)) {
-    Log(LL_DBG, "perl_after_sent(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG, "perl_after_sent(), perl=%p", Perl_get_context());
     if (!Perl_get_context()) return 0;
     lockperlsem();
     { dSP;
@@ -2215,7 +2217,7 @@ int perl_after_sent(STATE *state, int n) {
       }
     }
     releaseperlsem();
-    Log(LL_DBG, "perl_after_sent() end");
+    Logc(LOGC_PERL, LL_DBG, "perl_after_sent() end");
     return rc;
   }
   return 0;
@@ -2253,7 +2255,7 @@ int perl_on_log(char *s, int bufsize, int *lev) {
     sv_setiv(svchk, 1);
     SvREADONLY_on(svchk);
     /* end of check */
-    Log(LL_DBG2, "perl_on_log(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG2, "perl_on_log(), perl=%p", Perl_get_context());
     { dSP;
       VK_ADD_intz(sv, "lvl", *lev); if (sv) { SvREADONLY_off(sv); }
       VK_ADD_str (sv, "_", s); if (sv) { SvREADONLY_off(sv); }
@@ -2283,7 +2285,7 @@ int perl_on_log(char *s, int bufsize, int *lev) {
       }
       else rc = 1;
     }
-    Log(LL_DBG2, "perl_on_log() end");
+    Logc(LOGC_PERL, LL_DBG2, "perl_on_log() end");
     SvREADONLY_off(svchk);
     sv_setiv(svchk, 0); /* check: now we can restore */
     /* SvREFCNT_dec(svchk); */
@@ -2300,7 +2302,7 @@ int perl_on_send(STATE *state, t_msg *m, char **s1, char **s2) {
   BINKD_CONFIG *cfg = state->config;
 
   if (cfg->perl_ok & (1 << PERL_ON_SEND)) {
-    Log(LL_DBG2, "perl_on_send(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG2, "perl_on_send(), perl=%p", Perl_get_context());
     lockperlsem();
     { dSP;
       VK_ADD_intz(sv, "type", *m);
@@ -2320,7 +2322,7 @@ int perl_on_send(STATE *state, t_msg *m, char **s1, char **s2) {
       }
     }
     releaseperlsem();
-    Log(LL_DBG2, "perl_on_send() end");
+    Logc(LOGC_PERL, LL_DBG2, "perl_on_send() end");
     return rc;
   }
   return 1;
@@ -2332,7 +2334,7 @@ int perl_on_recv(STATE *state, char *s, int size) {
   BINKD_CONFIG *cfg = state->config;
 
   if (cfg->perl_ok & (1 << PERL_ON_RECV)) {
-    Log(LL_DBG2, "perl_on_recv(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG2, "perl_on_recv(), perl=%p", Perl_get_context());
     lockperlsem();
     { dSP;
       if ( (sv = perl_get_sv("s", TRUE)) ) {
@@ -2354,7 +2356,7 @@ int perl_on_recv(STATE *state, char *s, int size) {
       }
     }
     releaseperlsem();
-    Log(LL_DBG2, "perl_on_recv() end");
+    Logc(LOGC_PERL, LL_DBG2, "perl_on_recv() end");
     return rc;
   }
   return 1;
@@ -2369,7 +2371,7 @@ int perl_setup_rlimit(STATE *state, BW *bw, char *fname)
   BINKD_CONFIG *cfg = state->config;
 
   if (cfg->perl_ok & (1 << PERL_SETUP_RLIMIT)) {
-    Log(LL_DBG2, "perl_set_rlimit(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG2, "perl_set_rlimit(), perl=%p", Perl_get_context());
     lockperlsem();
     { dSP;
       if (state->perl_set_lvl < 2) setup_session(state, 2);
@@ -2399,7 +2401,7 @@ int perl_setup_rlimit(STATE *state, BW *bw, char *fname)
       }
     }
     releaseperlsem();
-    Log(LL_DBG2, "perl_setup_rlimit() end");
+    Logc(LOGC_PERL, LL_DBG2, "perl_setup_rlimit() end");
     return rc;
   }
   return 1;
@@ -2415,7 +2417,7 @@ int perl_need_reload(BINKD_CONFIG *cfg, struct conflist_type *conflist, int need
   SV     *sv, *svret;
 
   if (cfg->perl_ok & (1 << PERL_NEED_RELOAD)) {
-    Log(LL_DBG, "perl_need_reload(), perl=%p", Perl_get_context());
+    Logc(LOGC_PERL, LL_DBG, "perl_need_reload(), perl=%p", Perl_get_context());
     if (!Perl_get_context()) return 0;
     lockperlsem();
     { dSP;
@@ -2426,7 +2428,7 @@ int perl_need_reload(BINKD_CONFIG *cfg, struct conflist_type *conflist, int need
         SvREADONLY_on(sv);
         av_push(av, sv);
       }
-      Log(LL_DBG2, "perl_need_reload(): @conflist done");
+      Logc(LOGC_PERL, LL_DBG2, "perl_need_reload(): @conflist done");
       VK_ADD_intz (sv, "_", need_reload); if (sv) { SvREADONLY_off(sv); }
       ENTER;
       SAVETMPS;
@@ -2445,7 +2447,7 @@ int perl_need_reload(BINKD_CONFIG *cfg, struct conflist_type *conflist, int need
       }
     }
     releaseperlsem();
-    Log(LL_DBG, "perl_need_reload() end, returns %i", rc);
+    Logc(LOGC_PERL, LL_DBG, "perl_need_reload() end, returns %i", rc);
     return rc;
   }
   return 0;
@@ -2455,7 +2457,7 @@ int perl_need_reload(BINKD_CONFIG *cfg, struct conflist_type *conflist, int need
 void perl_config_loaded(BINKD_CONFIG *cfg)
 {
   if (cfg->perl && (cfg->perl_ok & (1 << PERL_CONFIG_LOADED))) {
-    Log(LL_DBG, "perl_config_loaded()");
+    Logc(LOGC_PERL, LL_DBG, "perl_config_loaded()");
     lockperlsem();
     { dSP;
       ENTER;
@@ -2472,7 +2474,7 @@ void perl_config_loaded(BINKD_CONFIG *cfg)
       }
     }
     releaseperlsem();
-    Log(LL_DBG, "perl_config_loaded() end");
+    Logc(LOGC_PERL, LL_DBG, "perl_config_loaded() end");
     return;
   }
   return;
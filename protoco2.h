@@ -97,6 +97,7 @@ struct _STATE
   int r_skipped_flag;		/* Remote skipped smthng */
   int listed_flag;              /* Listed? */
   char *inbound;		/* The current inbound dir */
+  void *in_rsv;                 /* Free space reserved for the file being received */
   char *peer_name;              /* Remote host's name */
   char *ipaddr;			/* Remote IP */
   char *our_ip;			/* Local IP */
@@ -123,6 +124,8 @@ struct _STATE
 
   /* binkp state description */
   int local_EOB, remote_EOB;
+  time_t linger_until;          /* M_EOB is delayed till then (linger) */
+  time_t linger_scan;           /* last rescan of the outbound */
   int GET_FILE_balance;		/* Prevent quitting without * waiting for GET 
 				   results */
   int off_req_sent;		/* "M_FILE ... -1" sent, waiting * for M_GET */
@@ -125,7 +125,8 @@ static int init_protocol (STATE *state, SOCKET socket_in, SOCKET socket_out, FTN
   state->z_canrecv |= 2;
 #endif
   setsockopts (state->s_in  = socket_in);
-  setsockopts (state->s_out = socket_out);
+  if ((state->s_out = socket_out) != socket_in)
+    setsockopts (socket_out);
   TF_ZERO (&state->in);
   TF_ZERO (&state->out);
   TF_ZERO (&state->flo);
@@ -138,11 +139,11 @@ static int init_protocol (STATE *state, SOCKET socket_in, SOCKET socket_out, FTN
   if (getsockopt (socket_in, SOL_SOCKET, SO_TYPE, val, &lval) == -1)
   { /* assume it's not a socket */
     state->pipe = 1;
-    Log (6, "binkp init done, pipe handles are %i/%i", state->s_in, state->s_out);
+    Logc (LOGC_PROTO, 6, "binkp init done, pipe handles are %i/%i", state->s_in, state->s_out);
   }
   else
   {
-    Log (6, "binkp init done, socket # is %i", state->s_in);
+    Logc (LOGC_PROTO, 6, "binkp init done, socket # is %i", state->s_in);
   }
   return 1;
 }
@@ -158,22 +159,25 @@ static int close_partial (STATE *state, BINKD_CONFIG *config)
   if (state->in.f)
   {
     s = ftello (state->in.f);
-    Log (1, "receiving of %s interrupted at %" PRIuMAX, state->in.netname,
+    Logc (LOGC_PROTO, 1, "receiving of %s interrupted at %" PRIuMAX, state->in.netname,
          (uintmax_t) s);
     if (ispkt (state->in.netname))
     {
-      Log (2, "%s: partial .pkt", state->in.netname);
+      Logc (LOGC_PROTO, 2, "%s: partial .pkt", state->in.netname);
       s = 0;
     }
     else if (s == 0)
     {
-      Log (4, "%s: empty partial", state->in.netname);
+      Logc (LOGC_PROTO, 4, "%s: empty partial", state->in.netname);
     }
+    else
+      inb_trim (state, config);
     fclose (state->in.f);
     state->in.f = NULL;
     if (s == 0)
       inb_reject (state, config);
   }
+  inb_release (state);
   TF_ZERO (&state->in);
   return 0;
 }
@@ -220,7 +224,7 @@ static int deinit_protocol (STATE *state, BINKD_CONFIG *config, int status)
   xfree (state->pAddr);
   xfree (state->MD_challenge);
   rel_grow_handles(-state->nfa);
-  Log (6, "binkp deinit done...");
+  Logc (LOGC_PROTO, 6, "binkp deinit done...");
   return 0;
 }
 
@@ -229,7 +233,7 @@ static FTNQ *process_rcvdlist (STATE *state, FTNQ *q, BINKD_CONFIG *config)
 {
   int i;
 
-  Log (6, "processing rcvd list");
+  Logc (LOGC_PROTO, 6, "processing rcvd list");
   for (i = 0; i < state->n_rcvdlist; ++i)
   {
     q = evt_run(q, state->rcvdlist[i].name, 1, state, config);
@@ -279,7 +283,7 @@ void msg_send2 (STATE *state, t_msg m, char *s1, char *s2)
   ++state->n_msgs;
   ++state->msgs_in_batch;
 
-  Log (5, "send message %s %s%s", scommand[m], s1, s2);
+  Logc (LOGC_PROTO, 5, "send message %s %s%s", scommand[m], s1, s2);
 }
 
 /*
@@ -308,7 +312,7 @@ static void current_file_was_sent (STATE *state)
   if (state->ND_flag & WE_ND)
   {
     state->waiting_for_GOT = 1;
-    Log(5, "Waiting for M_GOT");
+    Logc(LOGC_PROTO, 5, "Waiting for M_GOT");
   }
 }
 
@@ -323,7 +327,8 @@ static int send_block (STATE *state, BINKD_CONFIG *config)
   /* Have something to send in buffers */
   if (state->optr && state->oleft)
   {
-    Log (7, "sending %i byte(s)", state->oleft);
+    if (LogOn (LOGC_PROTO, 7))
+      Logc (LOGC_PROTO, 7, "sending %i byte(s)", state->oleft);
     if (state->pipe)
       /* TODO: this call should be non-blocking on WIN32 */
       n = write (state->s_out, state->optr, state->oleft);
@@ -336,19 +341,22 @@ static int send_block (STATE *state, BINKD_CONFIG *config)
     {
       save_errno = errno;
       save_err = strerror(errno);
-      Log (7, "write() done, rc=%i", n);
+      if (LogOn (LOGC_PROTO, 7))
+        Logc (LOGC_PROTO, 7, "write() done, rc=%i", n);
     }
     else
     {
       save_errno = TCPERRNO;
       save_err = TCPERR ();
-      Log (7, "send() done, rc=%i", n);
+      if (LogOn (LOGC_PROTO, 7))
+        Logc (LOGC_PROTO, 7, "send() done, rc=%i", n);
     }
     if (n == state->oleft)
     {
       state->optr = 0;
       state->oleft = 0;
-      Log (7, "data sent");
+      if (LogOn (LOGC_PROTO, 7))
+        Logc (LOGC_PROTO, 7, "data sent");
     }
     else if (n == -1)
     {
@@ -358,13 +366,14 @@ static int send_block (STATE *state, BINKD_CONFIG *config)
         state->io_error = 1;
         if (!binkd_exit)
         {
-          Log (1, "%s: %s", state->pipe ? "write" : "send", save_err);
+          Logc (LOGC_PROTO, 1, "%s: %s", state->pipe ? "write" : "send", save_err);
           if (state->to)
             bad_try (&state->to->fa, save_err, BAD_IO, config);
         }
         return 0;
       }
-      Log (7, "data transfer would block");
+      if (LogOn (LOGC_PROTO, 7))
+        Logc (LOGC_PROTO, 7, "data transfer would block");
       return 2;
     }
     else if (n == 0)
@@ -376,7 +385,8 @@ static int send_block (STATE *state, BINKD_CONFIG *config)
     {
       state->optr += n;
       state->oleft -= n;
-      Log (7, "partially sent, %i byte(s) left", state->oleft);
+      if (LogOn (LOGC_PROTO, 7))
+        Logc (LOGC_PROTO, 7, "partially sent, %i byte(s) left", state->oleft);
     }
   }
   else
@@ -395,7 +405,7 @@ static int send_block (STATE *state, BINKD_CONFIG *config)
           /* Check for possible internal error */
           if (state->msgs[i].sz - 2 > MAX_BLKSIZE)
           {
-            Log (1, "size of msg we want to send is too big (%i)",
+            Logc (LOGC_PROTO, 1, "size of msg we want to send is too big (%i)",
                  state->msgs[i].sz - 2);
             return 0;
           }
@@ -404,7 +414,8 @@ static int send_block (STATE *state, BINKD_CONFIG *config)
           if (state->oleft + state->msgs[i].sz > MAX_BLKSIZE)
             break;
 
-          Log (7, "put next msg to obuf, %i", state->msgs[i].sz);
+          if (LogOn (LOGC_PROTO, 7))
+            Logc (LOGC_PROTO, 7, "put next msg to obuf, %i", state->msgs[i].sz);
           memcpy (state->optr, state->msgs[i].s, state->msgs[i].sz);
           state->oleft += state->msgs[i].sz;
           state->optr += state->msgs[i].sz;
@@ -455,14 +466,16 @@ static int send_block (STATE *state, BINKD_CONFIG *config)
         state->send_eof = 0;
         sz = 0;
       }
-      Log (10, "next block to send: %u byte(s)", sz);
+      if (LogOn (LOGC_PROTO, 10))
+        Logc (LOGC_PROTO, 10, "next block to send: %u byte(s)", sz);
       mkhdr (state->obuf, sz);
       if (sz != 0)
       {
-        Log (10, "freading %u byte(s)", sz);
+        if (LogOn (LOGC_PROTO, 10))
+          Logc (LOGC_PROTO, 10, "freading %u byte(s)", sz);
         if ((n = fread (buf, 1, sz, state->out.f)) < (int) sz)
         {
-          Log (1, "error reading %s: expected %u, read %i",
+          Logc (LOGC_PROTO, 1, "error reading %s: expected %u, read %i",
                state->out.path, sz, n);
           return 0;
         }
@@ -479,8 +492,8 @@ static int send_block (STATE *state, BINKD_CONFIG *config)
           short cz, cnet, cnode, cp;
           SHARED_CHAIN *chn;
           if (pkt_getaddr(buf, NULL, NULL, NULL, NULL, &cz, &cnet, &cnode, &cp)) {
-            Log(9, "First block of %s", state->out.path);
-            Log(7, "PKT dest: %d:%d/%d.%d", cz, cnet, cnode, cp);
+            Logc(LOGC_PROTO, 9, "First block of %s", state->out.path);
+            Logc(LOGC_PROTO, 7, "PKT dest: %d:%d/%d.%d", cz, cnet, cnode, cp);
             /* Scan all shared addresses */
             for (chn = config->shares.first; chn; chn = chn->next)
             {
@@ -496,7 +509,7 @@ static int send_block (STATE *state, BINKD_CONFIG *config)
                 { /* Change to main address and check */
                   pkt_setaddr(buf, -1, -1, -1, -1, (short)fa->z, (short)fa->net, (short)fa->node, (short)fa->p);
                   pkt_getaddr(buf, NULL, NULL, NULL, NULL, &cz, &cnet, &cnode, &cp);
-                  Log(7, "Change dest to: %d:%d/%d.%d", cz, cnet, cnode, cp);
+                  Logc(LOGC_PROTO, 7, "Change dest to: %d:%d/%d.%d", cz, cnet, cnode, cp);
                   /* Set corresponding pkt password */
                   {
                     FTN_NODE *fn = state->to ? state->to : get_node_info(fa, config);
@@ -531,7 +544,7 @@ static int send_block (STATE *state, BINKD_CONFIG *config)
                            fleft ? 0 : 1,
                            state->z_odata);
           if (rc == -1) {
-            Log (1, "error compression %s, rc=%d", state->out.path, rc);
+            Logc (LOGC_PROTO, 1, "error compression %s, rc=%d", state->out.path, rc);
             return 0;
           }
           state->z_osize += nget;
@@ -541,10 +554,11 @@ static int send_block (STATE *state, BINKD_CONFIG *config)
           if (nput == config->oblksize) break;
           sz = min(fleft, ZBLKSIZE);
           if (sz == 0) continue;
-          Log (10, "freading %u byte(s)", sz);
+          if (LogOn (LOGC_PROTO, 10))
+            Logc (LOGC_PROTO, 10, "freading %u byte(s)", sz);
           if ((n = fread (state->z_obuf, 1, sz, state->out.f)) < (int) sz)
           {
-            Log (1, "error reading %s: expected %u, read %i",
+            Logc (LOGC_PROTO, 1, "error reading %s: expected %u, read %i",
                  state->out.path, sz, n);
             return 0;
           }
@@ -559,7 +573,7 @@ static int send_block (STATE *state, BINKD_CONFIG *config)
         mkhdr(state->obuf, sz);
         if (!fleft && rc == 1)
         {
-          Log(4, "Compressed %" PRIuMAX " bytes to %" PRIuMAX " for %s, ratio %.1f%%",
+          Logc(LOGC_PROTO, 4, "Compressed %" PRIuMAX " bytes to %" PRIuMAX " for %s, ratio %.1f%%",
               (uintmax_t)state->z_osize, (uintmax_t)state->z_cosize,
               state->out.netname, 100.0 * state->z_cosize / (state->z_osize ? state->z_osize : 1));
           compress_deinit(state->z_send, state->z_odata);
@@ -622,7 +636,7 @@ static int perform_action (STATE *state, char *path, char action)
       if (chmod(path, S_IREAD | S_IWRITE) == 0 && delete(path) != 0) {
 #endif
       /* add to list not to send it again */
-      Log (5, "adding file `%s' to not-to-send list", path);
+      Logc (LOGC_PROTO, 5, "adding file `%s' to not-to-send list", path);
       state->nosendlist = xrealloc(state->nosendlist, (state->n_nosendlist+1)*sizeof(state->nosendlist[0]));
       state->nosendlist[state->n_nosendlist++] = xstrdup(path);
 #if defined(WIN32) || defined(OS2) || defined(DOS)
@@ -659,11 +673,11 @@ static int remove_from_spool (STATE *state, char *flopath,
   int empty_flo_flag = 1;
 
   if (file)
-    Log (5, "removing from spool: %s", file);
+    Logc (LOGC_PROTO, 5, "removing from spool: %s", file);
   else if (flopath)
-    Log (5, "removing flo: %s", flopath);
+    Logc (LOGC_PROTO, 5, "removing flo: %s", flopath);
   else
-    Log (1, "internal error in remove_from_spool!");
+    Logc (LOGC_PROTO, 1, "internal error in remove_from_spool!");
 
   if (flopath && *flopath)               /* A file attached via .?lo */
   {
@@ -678,7 +692,7 @@ static int remove_from_spool (STATE *state, char *flopath,
     {
       if ((flo = fopen (flopath, "r+b")) == 0)
       {
-        Log (5, "remove_from_spool: %s: %s", flopath, strerror (errno));
+        Logc (LOGC_PROTO, 5, "remove_from_spool: %s: %s", flopath, strerror (errno));
         return 0;
       }
     }
@@ -697,21 +711,21 @@ static int remove_from_spool (STATE *state, char *flopath,
       {
         clearerr (flo);
         if (fseeko (flo, curr_offset, SEEK_SET) == EOF)
-          Log (1, "remove_from_spool: fseek(%s): %s", flopath,
+          Logc (LOGC_PROTO, 1, "remove_from_spool: fseek(%s): %s", flopath,
                strerror (errno));
         else if (putc ('~', flo) == EOF)
-          Log (1, "remove_from_spool: fputc(%s): %s", flopath,
+          Logc (LOGC_PROTO, 1, "remove_from_spool: fputc(%s): %s", flopath,
                strerror (errno));
         fflush (flo);
         /* The line was marked, now skip it */
         if (!fgets (buf, MAXPATHLEN, flo))
-          Log (1, "remove_from_spool: fgets(%s): %s", flopath,
+          Logc (LOGC_PROTO, 1, "remove_from_spool: fgets(%s): %s", flopath,
                strerror (errno));
         /* We've found the file in flo, so try to translate it's name before
          * the action */
         if (w == 0 && (w = trans_flo_line (file, config->rf_rules.first)) != 0)
         {
-          Log (5, "%s mapped to %s", file, w);
+          Logc (LOGC_PROTO, 5, "%s mapped to %s", file, w);
         }
       }
       else if (*buf && *buf != '~')
@@ -795,14 +809,14 @@ static int NUL (STATE *state, char *buf, int sz, BINKD_CONFIG *config)
   UNUSED_ARG(sz);
   UNUSED_ARG(config);
 
-  Log (3, "%s", s = strquote (buf, SQ_CNTRL));
+  Logc (LOGC_PROTO, 3, "%s", s = strquote (buf, SQ_CNTRL));
   if (!memcmp (s, "VER ", 4) &&
       (a = strstr (s, PRTCLNAME "/")) != 0 &&
       (b = strstr (a, ".")) != 0)
   {
     state->major = atoi (a + 6);
     state->minor = atoi (b + 1);
-    Log (6, "remote uses " PRTCLNAME " v.%i.%i", state->major, state->minor);
+    Logc (LOGC_PROTO, 6, "remote uses " PRTCLNAME " v.%i.%i", state->major, state->minor);
     if (!memcmp(s + 4, "binkd/0.9/", 10) ||
         !memcmp(s + 4, "binkd/0.9.1/", 12) ||
         !memcmp(s + 4, "binkd/0.9.2/", 12) ||
@@ -811,7 +825,7 @@ static int NUL (STATE *state, char *buf, int sz, BINKD_CONFIG *config)
         !memcmp(s + 4, "binkd/0.9.4/", 12))
     {
       state->buggy_NR = 1;
-      Log (5, "remote has NR bug, use workaround");
+      Logc (LOGC_PROTO, 5, "remote has NR bug, use workaround");
     }
   }
   else if (!memcmp (s, "TRF ", 4))
@@ -820,7 +834,7 @@ static int NUL (STATE *state, char *buf, int sz, BINKD_CONFIG *config)
     if ((mail = getwordx (s + 4, 1, 0)) != NULL &&
         (files = getwordx (s + 4, 2, 0)) != NULL)
     {
-      Log (2, "Remote has %sb of mail and %sb of files for us", mail, files);
+      Logc (LOGC_PROTO, 2, "Remote has %sb of mail and %sb of files for us", mail, files);
       free(files);
     }
     if (mail) free(mail);
@@ -835,34 +849,34 @@ static int NUL (STATE *state, char *buf, int sz, BINKD_CONFIG *config)
       if (!strcmp (w, "NR"))
       {
         state->NR_flag |= WE_NR;      /* They want NR mode - turn it on */
-        Log(2, "Remote requests NR mode");
+        Logc(LOGC_PROTO, 2, "Remote requests NR mode");
       }
       if (!strcmp (w, "ND"))
       {
         state->ND_flag |= WE_ND;      /* They want ND mode - turn it on */
-        Log(2, "Remote requests ND mode");
+        Logc(LOGC_PROTO, 2, "Remote requests ND mode");
       }
       if (!strcmp (w, "NDA"))
       {
         state->ND_flag |= CAN_NDA;     /* They supports asymmetric ND */
-        Log(2, "Remote supports asymmetric ND mode");
+        Logc(LOGC_PROTO, 2, "Remote supports asymmetric ND mode");
       }
       if (!strcmp (w, "CRYPT"))
       {
         state->crypt_flag |= THEY_CRYPT;  /* They want crypt mode */
-        Log(2, "Remote requests CRYPT mode");
+        Logc(LOGC_PROTO, 2, "Remote requests CRYPT mode");
       }
       if (!strncmp(w, "CRAM-", 5) && !no_MD5 &&
           state->to && (state->to->MD_flag >= 0))
       {
-        Log(2, "Remote requests MD mode");
+        Logc(LOGC_PROTO, 2, "Remote requests MD mode");
         xfree(state->MD_challenge);
         state->MD_challenge=MD_getChallenge(w, NULL);
       }
 #ifdef WITH_ZLIB
       if (!strcmp (w, "GZ"))
       {
-        Log(2, "Remote supports GZ mode");
+        Logc(LOGC_PROTO, 2, "Remote supports GZ mode");
 #ifdef ZLIBDL
         if (zlib_loaded)
 #endif
@@ -872,7 +886,7 @@ static int NUL (STATE *state, char *buf, int sz, BINKD_CONFIG *config)
 #ifdef WITH_BZLIB2
       if (!strcmp (w, "BZ2"))
       {
-        Log(2, "Remote supports BZ2 mode");
+        Logc(LOGC_PROTO, 2, "Remote supports BZ2 mode");
 #ifdef ZLIBDL
         if (bzlib2_loaded)
 #endif
@@ -882,7 +896,7 @@ static int NUL (STATE *state, char *buf, int sz, BINKD_CONFIG *config)
       if (!strcmp (w, "EXTCMD"))
       {
         state->extcmd = 1;  /* They can accept extra params for commands */
-        Log(2, "Remote supports EXTCMD mode");
+        Logc(LOGC_PROTO, 2, "Remote supports EXTCMD mode");
       }
       free (w);
     }
@@ -895,7 +909,7 @@ static int NUL (STATE *state, char *buf, int sz, BINKD_CONFIG *config)
     strnzcpy (state->location, s + 4, sizeof (state->location));
   else if (!memcmp (s, "FREQ", 4)) {
     state->delay_EOB++;
-    Log(2, "Remote claims to have a FREQ for us");
+    Logc(LOGC_PROTO, 2, "Remote claims to have a FREQ for us");
   }
   free (s);
   return 1;
@@ -910,7 +924,7 @@ static int RError (STATE *state, char *buf, int sz, BINKD_CONFIG *config)
 
   UNUSED_ARG(sz);
 
-  Log (1, "rerror: %s", s = strquote (buf, SQ_CNTRL));
+  Logc (LOGC_PROTO, 1, "rerror: %s", s = strquote (buf, SQ_CNTRL));
   if (state->to)
     bad_try (&state->to->fa, s, BAD_MERR, config);
   free (s);
@@ -923,7 +937,7 @@ static int BSY (STATE *state, char *buf, int sz, BINKD_CONFIG *config)
 
   UNUSED_ARG(sz);
 
-  Log (1, "got M_BSY: %s", s = strquote (buf, SQ_CNTRL));
+  Logc (LOGC_PROTO, 1, "got M_BSY: %s", s = strquote (buf, SQ_CNTRL));
   if (state->to)
     bad_try (&state->to->fa, s, BAD_MBSY, config);
   free (s);
@@ -953,7 +967,7 @@ static char * add_shared_akas(char * s, BINKD_CONFIG *config)
            * by remote node, it should be deleted...
            */
           ftnaddress_to_str (szFTNAddr, &fa);
-          Log (1, "shared aka `%s' used by node %s", szFTNAddr,s);
+          Logc (LOGC_PROTO, 1, "shared aka `%s' used by node %s", szFTNAddr,s);
           /* fill this aka by spaces */
           c = strstr(s, w);
           if (c)
@@ -979,7 +993,7 @@ static char * add_shared_akas(char * s, BINKD_CONFIG *config)
               ftnaddress_to_str (szFTNAddr,&chn->sha);
               strcat(ad, " ");
               strcat(ad, szFTNAddr);
-              Log(2, "shared aka %s is added", szFTNAddr);
+              Logc(LOGC_PROTO, 2, "shared aka %s is added", szFTNAddr);
               break;
             }
           }
@@ -997,7 +1011,7 @@ static void send_ADR (STATE *state, BINKD_CONFIG *config) {
   int i, N;
   struct akachain *ps;
 
-  Log(7, "send_ADR(): got %d remote addresses", state->nfa);
+  Logc(LOGC_PROTO, 7, "send_ADR(): got %d remote addresses", state->nfa);
 
   if (!state->pAddr) {
     state->nAddr = config->nAddr;
@@ -1022,7 +1036,7 @@ static void send_ADR (STATE *state, BINKD_CONFIG *config) {
         if (ftnaddress_cmp(state->pAddr+i, &(ps->fa)) == 0) {
           char buf[FTN_ADDR_SZ];
           ftnaddress_to_str(buf, &(ps->fa));
-          Log(3, "hiding aka %s", buf);
+          Logc(LOGC_PROTO, 3, "hiding aka %s", buf);
           if (i < state->nAddr-1)
             memmove(state->pAddr+i, state->pAddr+i+1, (state->nAddr-1-i)*sizeof(FTN_ADDR));
           state->nAddr--;
@@ -1036,7 +1050,7 @@ static void send_ADR (STATE *state, BINKD_CONFIG *config) {
       if (i == state->nAddr) {
         char buf[FTN_ADDR_SZ];
         ftnaddress_to_str(buf, &(ps->fa));
-        Log(3, "presenting aka %s", buf);
+        Logc(LOGC_PROTO, 3, "presenting aka %s", buf);
         state->nAddr++;
         if (state->nAddr > N) {
           state->pAddr = xrealloc(state->pAddr, state->nAddr * sizeof(FTN_ADDR));
@@ -1109,7 +1123,7 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
       {
         free (s); free (ad);
       }
-      Log (1, "all akas was removed as shared");
+      Logc (LOGC_PROTO, 1, "all akas was removed as shared");
       return 0;
     }
     free (w);
@@ -1130,7 +1144,7 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
       char *q = strquote (s, SQ_CNTRL);
 
       msg_send2 (state, M_ERR, "Bad address", 0);
-      Log (1, "remote passed bad address: `%s'", q);
+      Logc (LOGC_PROTO, 1, "remote passed bad address: `%s'", q);
       free (w);
       free (q);
       return 0;
@@ -1179,12 +1193,12 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
 #ifndef VAL_STYLE
           ipok = 2;
 #endif
-          Log (3, "%s, getaddrinfo error (empty result)", state->ipaddr);
+          Logc (LOGC_PROTO, 3, "%s, getaddrinfo error (empty result)", state->ipaddr);
         }
       }
       else
       {
-        Log (3, "%s, getaddrinfo error: %s (%d)", state->ipaddr, gai_strerror(rc), rc);
+        Logc (LOGC_PROTO, 3, "%s, getaddrinfo error: %s (%d)", state->ipaddr, gai_strerror(rc), rc);
 #ifndef VAL_STYLE
           ipok = 2;
 #endif
@@ -1206,17 +1220,17 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
       {
         if (rc == 0)
         {
-          Log (1, "%s: %i: error parsing host list", pn->hosts, i);
+          Logc (LOGC_PROTO, 1, "%s: %i: error parsing host list", pn->hosts, i);
           continue;
         }
         if (strcmp(host, "-") == 0)
           continue;
 
-        Log (5, "resolving `%s'...", host);
+        Logc (LOGC_PROTO, 5, "resolving `%s'...", host);
         aiErr = getaddrinfo(host, NULL, &hints, &aiHead);
         if (aiErr != 0)
         {
-          Log(3, "%s, getaddrinfo error: %s (%d)", host, gai_strerror(aiErr), aiErr);
+          Logc(LOGC_PROTO, 3, "%s, getaddrinfo error: %s (%d)", host, gai_strerror(aiErr), aiErr);
 #ifdef VAL_STYLE
           if (aiErr == EAI_NONAME)
             ip_found |= FOUND_UNKNOWN;
@@ -1262,9 +1276,9 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
         if (pn->pwd && strcmp(pn->pwd, "-") && state->to == 0)
         {
           if (ipok == 0)
-            Log (1, "addr: %s (unresolvable)", szFTNAddr);
+            Logc (LOGC_PROTO, 1, "addr: %s (unresolvable)", szFTNAddr);
           else
-            Log (1, "addr: %s (not from allowed remote address)", szFTNAddr);
+            Logc (LOGC_PROTO, 1, "addr: %s (not from allowed remote address)", szFTNAddr);
           msg_send2 (state, M_ERR, "Bad source IP", 0);
           return 0;
         } else
@@ -1272,9 +1286,9 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
           if (ip_verified == 0)
             ip_verified = -1;
           if (ipok == 0)
-            Log(2, "Addr %s dropped - unresolvable IP", szFTNAddr);
+            Logc(LOGC_PROTO, 2, "Addr %s dropped - unresolvable IP", szFTNAddr);
           else
-            Log(2, "Addr %s dropped - not from allowed IP", szFTNAddr);
+            Logc(LOGC_PROTO, 2, "Addr %s dropped - not from allowed IP", szFTNAddr);
           continue;
         }
       }
@@ -1294,12 +1308,12 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
         ) ip_check = CHECK_WRONG;
       }
       if (ip_check == CHECK_WRONG && !state->to && pn->pwd && strcmp(pn->pwd, "-")) {
-        Log (1, "addr: %s (not from allowed remote IP, aborted)", szFTNAddr);
+        Logc (LOGC_PROTO, 1, "addr: %s (not from allowed remote IP, aborted)", szFTNAddr);
         msg_send2 (state, M_ERR, "Bad source IP", 0);
         return 0;
       }
       else if (ip_check == CHECK_WRONG) {
-        Log (2, "addr: %s (not from allowed remote IP, disabled)", szFTNAddr);
+        Logc (LOGC_PROTO, 2, "addr: %s (not from allowed remote IP, disabled)", szFTNAddr);
         continue;
       }
 #endif
@@ -1319,7 +1333,7 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
       {
         if (strcmp (pwd, "!") == 0 && ftnaddress_cmp (state->remote_fa, &fa) != 0)
         { /* drop session if remote has aka with disabled password */
-          Log (1, "Password authentication disabled for node %s", szFTNAddr);
+          Logc (LOGC_PROTO, 1, "Password authentication disabled for node %s", szFTNAddr);
           state->expected_pwd[0] = '\0';
           continue;
         }
@@ -1333,11 +1347,11 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
         else
         {
           if (state->to)
-            Log (2, "inconsistent pwd settings for this node, aka %s dropped", szFTNAddr);
+            Logc (LOGC_PROTO, 2, "inconsistent pwd settings for this node, aka %s dropped", szFTNAddr);
           else
           { /* drop incoming session with M_ERR "Bad password" */
-            Log (2, "addr: %s", szFTNAddr);
-            Log (1, "inconsistent pwd settings for this node");
+            Logc (LOGC_PROTO, 2, "addr: %s", szFTNAddr);
+            Logc (LOGC_PROTO, 1, "inconsistent pwd settings for this node");
             state->expected_pwd[0] = '\0';
           }
           continue;
@@ -1348,13 +1362,13 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
     if (bsy_add (&fa, F_BSY, config))
     {
 #ifndef VAL_STYLE
-      Log (2, "addr: %s", szFTNAddr);
+      Logc (LOGC_PROTO, 2, "addr: %s", szFTNAddr);
 #else
       char *s;
       if (ip_check == CHECK_OK) s = "remote IP ok";
       else if (ip_check == CHECK_OFF) s = "remote IP unchecked";
       else s = "remote IP can't be verified";
-      Log (2, "addr: %s (%s)", szFTNAddr, s);
+      Logc (LOGC_PROTO, 2, "addr: %s (%s)", szFTNAddr, s);
 #endif
 #ifndef HAVE_THREADS
       if (state->nfa == 0)
@@ -1400,11 +1414,11 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
     }
     else
     {
-      Log (2, "addr: %s (n/a or busy)", szFTNAddr);
+      Logc (LOGC_PROTO, 2, "addr: %s (n/a or busy)", szFTNAddr);
 #if 1
       if (pn && pn->pwd && strcmp(pn->pwd, "-") && state->to == 0)
       {
-        Log (1, "Secure AKA %s busy, drop the session", szFTNAddr);
+        Logc (LOGC_PROTO, 1, "Secure AKA %s busy, drop the session", szFTNAddr);
         msg_sendf (state, M_BSY, "Secure AKA %s busy", szFTNAddr);
         return 0;
       }
@@ -1438,28 +1452,36 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
   }
   if (state->nfa == 0)
   {
-    Log (1, "no AKAs in common domains or all AKAs are busy");
+    Logc (LOGC_PROTO, 1, "no AKAs in common domains or all AKAs are busy");
     msg_send2 (state, M_BSY, "No AKAs in common domains or all AKAs are busy", 0);
     return 0;
   }
+  if (!state->to && config->reserve_servers > 0 &&
+      n_servers > config->max_servers - config->reserve_servers &&
+      (state->expected_pwd[0] == '\0' || strcmp (state->expected_pwd, "-") == 0))
+  {
+    Logc (LOGC_PROTO, 1, "too many servers, the rest is reserved for secure nodes");
+    msg_send2 (state, M_BSY, "Too many servers", 0);
+    return 0;
+  }
   if (state->to != 0 && main_AKA_ok == 0)
   {
     ftnaddress_to_str (szFTNAddr, &state->to->fa);
-    Log (1, "called %s, but remote has no such AKA", szFTNAddr);
+    Logc (LOGC_PROTO, 1, "called %s, but remote has no such AKA", szFTNAddr);
     bad_try (&state->to->fa, "Remote has no needed AKA", BAD_AKA, config);
     return 0;
   }
 #ifndef VAL_STYLE
   if (ip_verified < 0)
   { /* strict IP check and no address resolved */
-    Log (1, "Remote IP check failed");
+    Logc (LOGC_PROTO, 1, "Remote IP check failed");
     msg_send2 (state, M_ERR, "Bad remote IP", 0);
     return 0;
   }
   else if (ip_verified == 2)
-    Log (4, "Remote IP matched");
+    Logc (LOGC_PROTO, 4, "Remote IP matched");
   else if (state->to == 0)
-    Log (5, "Remote IP not checked");
+    Logc (LOGC_PROTO, 5, "Remote IP not checked");
 #endif
 
   if (!state->to)
@@ -1467,7 +1489,7 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
 #ifdef WITH_PERL
     char *s = perl_on_handshake(state);
     if (s && *s) {
-      Log (1, "aborted by Perl on_handshake(): %s", s);
+      Logc (LOGC_PROTO, 1, "aborted by Perl on_handshake(): %s", s);
       msg_send2 (state, M_ERR, s, 0);
       return 0;
     }
@@ -1499,7 +1521,7 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
     else state->bw_send.rel = -pn->bw_send;
   }
   if (state->bw_send.abs || state->bw_send.rel)
-    Log (7, "Session send rate limit is %s cps or %d%%",
+    Logc (LOGC_PROTO, 7, "Session send rate limit is %s cps or %d%%",
             describe_rate(state->bw_send.abs), state->bw_send.rel);
 
   if (bw_recv_unlim) state->bw_recv.abs = state->bw_recv.rel = 0;
@@ -1509,7 +1531,7 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
     else state->bw_recv.rel = -pn->bw_recv;
   }
   if (state->bw_recv.abs || state->bw_recv.rel)
-    Log (7, "Session recv rate limit is %s cps or %d%%",
+    Logc (LOGC_PROTO, 7, "Session recv rate limit is %s cps or %d%%",
             describe_rate(state->bw_recv.abs), state->bw_recv.rel);
 #endif
 
@@ -1521,7 +1543,7 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
       char *tp=MD_buildDigest(state->to->out_pwd ? state->to->out_pwd : "-", state->MD_challenge);
       if (!tp)
       {
-        Log(2, "Unable to build MD5 digest");
+        Logc(LOGC_PROTO, 2, "Unable to build MD5 digest");
         bad_try (&state->to->fa, "Unable to build MD5 digest", BAD_AUTH, config);
         return 0;
       }
@@ -1531,7 +1553,7 @@ static int ADR (STATE *state, char *s, int sz, BINKD_CONFIG *config)
     }
     else if ((state->to->MD_flag == 1) && !no_MD5) /* We do not want to talk without MD5 */
     {
-      Log(2, "CRAM-MD5 is not supported by remote");
+      Logc(LOGC_PROTO, 2, "CRAM-MD5 is not supported by remote");
       bad_try (&state->to->fa, "CRAM-MD5 is not supported by remote", BAD_AUTH, config);
       return 0;
     }
@@ -1561,30 +1583,30 @@ static int complete_login (STATE *state, BINKD_CONFIG *config)
     state->q = q_sort (state->q, state->fa, state->nfa, config);
   state->msgs_in_batch = 0;               /* Forget about login msgs */
   if (state->state == P_SECURE)
-    Log (2, "pwd protected session (%s)",
+    Logc (LOGC_PROTO, 2, "pwd protected session (%s)",
          (state->MD_flag == 1) ? "MD5" : "plain text");
   if (state->ND_flag & WE_ND)
   { state->NR_flag |= WE_NR;
-    Log (3, "we are in ND mode");
+    Logc (LOGC_PROTO, 3, "we are in ND mode");
   }
   if (state->ND_flag & THEY_ND)
-    Log (3, "remote is in ND mode");
+    Logc (LOGC_PROTO, 3, "remote is in ND mode");
   else if (state->NR_flag == WE_NR)
-    Log (3, "we are in NR mode");
+    Logc (LOGC_PROTO, 3, "we are in NR mode");
   if (state->state != P_SECURE)
     state->crypt_flag = NO_CRYPT;
   else if (state->crypt_flag == (WE_CRYPT|THEY_CRYPT) && !state->MD_flag)
   { state->crypt_flag = NO_CRYPT;
-    Log (3, "Crypt allowed only with MD5 authentication");
+    Logc (LOGC_PROTO, 3, "Crypt allowed only with MD5 authentication");
   }
   else if (state->crypt_flag == (WE_CRYPT|THEY_CRYPT) && strcmp (state->expected_pwd, "!") == 0)
   { state->crypt_flag = NO_CRYPT;
-    Log (3, "Crypt allowed only with password authentication");
+    Logc (LOGC_PROTO, 3, "Crypt allowed only with password authentication");
   }
   else if (state->crypt_flag == (WE_CRYPT|THEY_CRYPT))
   { char *p;
     state->crypt_flag = YES_CRYPT;
-    Log (3, "session in CRYPT mode");
+    Logc (LOGC_PROTO, 3, "session in CRYPT mode");
     if (state->to)
     { init_keys(state->keys_out, state->to->out_pwd ? state->to->out_pwd : "-");
       init_keys(state->keys_in,  "-");
@@ -1602,7 +1624,7 @@ static int complete_login (STATE *state, BINKD_CONFIG *config)
   {
     char *s = perl_after_handshake(state);
     if (s && *s) {
-      Log (1, "aborted by Perl after_handshake(): %s", s);
+      Logc (LOGC_PROTO, 1, "aborted by Perl after_handshake(): %s", s);
       msg_send2 (state, M_ERR, s, 0);
       return 0;
     }
@@ -1620,11 +1642,11 @@ static int PWD (STATE *state, char *pwd, int sz, BINKD_CONFIG *config)
   UNUSED_ARG(sz);
 
   if (state->to)
-  { Log (1, "unexpected password from the remote on outgoing call: `%s'", pwd);
+  { Logc (LOGC_PROTO, 1, "unexpected password from the remote on outgoing call: `%s'", pwd);
     return 1;
   }
   if (state->state != P_NULL)
-  { Log (2, "Double M_PWD from remote! Ignored.", pwd);
+  { Logc (LOGC_PROTO, 2, "Double M_PWD from remote! Ignored.", pwd);
     msg_send2 (state, M_NUL, "MSG Warning: double of password is received (M_PWD more one)!", 0);
     return 0;
   }
@@ -1634,7 +1656,7 @@ static int PWD (STATE *state, char *pwd, int sz, BINKD_CONFIG *config)
     do_prescan (state, config);
     state->state = P_NONSECURE;
     if (strcmp (pwd, "-"))
-      Log (1, "unexpected password from the remote: `%s'", pwd);
+      Logc (LOGC_PROTO, 1, "unexpected password from the remote: `%s'", pwd);
   }
   else
   {
@@ -1644,7 +1666,7 @@ static int PWD (STATE *state, char *pwd, int sz, BINKD_CONFIG *config)
       if (bad_pwd && state->MD_flag)
       {
         msg_send2(state, M_ERR, "You must support MD5", 0);
-        Log (1, "Caller does not support MD5");
+        Logc (LOGC_PROTO, 1, "Caller does not support MD5");
         return 0;
       }
       state->MD_flag = 1;
@@ -1658,7 +1680,7 @@ static int PWD (STATE *state, char *pwd, int sz, BINKD_CONFIG *config)
       }
       else
       {
-        Log (2, "Unable to build Digest");
+        Logc (LOGC_PROTO, 2, "Unable to build Digest");
         bad_pwd = 1;
       }
     }
@@ -1672,7 +1694,7 @@ static int PWD (STATE *state, char *pwd, int sz, BINKD_CONFIG *config)
     if (bad_pwd && !no_password) /* I don't check password if we do not need one */
     {
       msg_send2 (state, M_ERR, "Bad password", 0);
-      Log (1, "`%s': incorrect password", pwd);
+      Logc (LOGC_PROTO, 1, "`%s': incorrect password", pwd);
       return 0;
     }
     else
@@ -1682,7 +1704,7 @@ static int PWD (STATE *state, char *pwd, int sz, BINKD_CONFIG *config)
         state->state = P_NONSECURE;
         do_prescan (state, config);
         if (bad_pwd) {
-          Log (1, "unexpected password digest from the remote");
+          Logc (LOGC_PROTO, 1, "unexpected password digest from the remote");
           state->state_ext = P_WE_NONSECURE;
         }
       }
@@ -1698,11 +1720,11 @@ static int PWD (STATE *state, char *pwd, int sz, BINKD_CONFIG *config)
     state->crypt_flag = NO_CRYPT;
   else if (state->crypt_flag == (THEY_CRYPT | WE_CRYPT) && !state->MD_flag)
   { state->crypt_flag = NO_CRYPT;
-    Log (4, "Crypt allowed only with MD5 authorization");
+    Logc (LOGC_PROTO, 4, "Crypt allowed only with MD5 authorization");
   }
   else if (state->crypt_flag == (THEY_CRYPT | WE_CRYPT) && strcmp (state->expected_pwd, "!") == 0)
   { state->crypt_flag = NO_CRYPT;
-    Log (3, "Crypt allowed only with password authentication");
+    Logc (LOGC_PROTO, 3, "Crypt allowed only with password authentication");
   }
 
   if ((state->ND_flag & WE_ND) && (state->ND_flag & CAN_NDA) == 0)
@@ -1713,7 +1735,7 @@ static int PWD (STATE *state, char *pwd, int sz, BINKD_CONFIG *config)
   { /* workaround bug of old binkd */
     /* force symmetric NR-mode with it */
     state->NR_flag |= WE_NR;
-    Log (5, "Turn on NR-mode with this link (remote has buggy NR)");
+    Logc (LOGC_PROTO, 5, "Turn on NR-mode with this link (remote has buggy NR)");
   }
 
   szOpt = xstrdup(" EXTCMD");
@@ -1746,7 +1768,7 @@ static int OK (STATE *state, char *buf, int sz, BINKD_CONFIG *config)
     if (state->state == P_SECURE && strcmp(w, "non-secure") == 0)
     {
       state->crypt_flag=NO_CRYPT; /* some development binkd versions send OPT CRYPT with unsecure session */
-      Log (1, "Warning: remote set UNSECURE session");
+      Logc (LOGC_PROTO, 1, "Warning: remote set UNSECURE session");
       state->state_ext = P_REMOTE_NONSECURE;
     }
     free(w);
@@ -1761,12 +1783,14 @@ struct skipchain *skip_test(STATE *state, BINKD_CONFIG *config)
 {
   struct skipchain *ps;
   addrtype amask = 0;
+  int i;
 
   amask |= (state->listed_flag) ? A_LST : A_UNLST;
   amask |= (state->state == P_SECURE) ? A_PROT : A_UNPROT;
-  for (ps = config->skipmask.first; ps; ps = ps->next)
+  for (i = 0; (i = maskset_next (config->skipmask_set, state->in.netname, i)) >= 0; i++)
   {
-    if ( (ps->atype & amask) && pmatch_ncase(ps->mask, state->in.netname) )
+    ps = maskset_item (config->skipmask_set, i);
+    if (ps->atype & amask)
     {
       if (ps->size >=0 && state->in.size >= ps->size)
         return ps;
@@ -1790,7 +1814,7 @@ static void setup_rate_limit (STATE *state, BINKD_CONFIG *config, BW *bw,
   {
     if ( (ps->atype & amask) && pmatch_ncase(ps->mask, fname) )
     {
-      Log (7, "%s matches rate limit mask %s", fname, ps->mask);
+      Logc (LOGC_PROTO, 7, "%s matches rate limit mask %s", fname, ps->mask);
       rlim = ps->rate;
       break;
     }
@@ -1809,9 +1833,9 @@ static void setup_rate_limit (STATE *state, BINKD_CONFIG *config, BW *bw,
   perl_setup_rlimit(state, bw, fname);
 #endif
   if (bw->rlim)
-    Log (3, "rate limit for %s is %d cps", fname, bw->rlim);
+    Logc (LOGC_PROTO, 3, "rate limit for %s is %d cps", fname, bw->rlim);
   else
-    Log (5, "rate for %s is unlimited", fname);
+    Logc (LOGC_PROTO, 5, "rate for %s is unlimited", fname);
   bw->utime.tv_sec = bw->utime.tv_usec = 0;
 }
 
@@ -1838,7 +1862,7 @@ static int check_rate_limit(BW *bw, struct timeval *tv)
   gettvtime(&ctime);
   if (ctime.tv_sec < bw->utime.tv_sec ||
       (ctime.tv_sec == bw->utime.tv_sec && ctime.tv_usec < bw->utime.tv_usec)) {
-    Log(3, "System time steps back, reset rate-limiting");
+    Logc(LOGC_PROTO, 3, "System time steps back, reset rate-limiting");
     bw->utime.tv_sec = bw->utime.tv_usec = 0;
   }
   if (bw->utime.tv_sec == 0 && bw->utime.tv_usec == 0) {
@@ -1868,7 +1892,8 @@ static int check_rate_limit(BW *bw, struct timeval *tv)
   }
   else if (dt >= BW_TIME_INT) bw->cps = cps;
   else bw->cps = ((BW_TIME_INT - dt) * bw->cps + cps * dt) / BW_TIME_INT;
-  Log (9, "current cps is %u, avg. cps is %u", (int)cps, (int)bw->cps);
+  if (LogOn (LOGC_PROTO, 9))
+    Logc (LOGC_PROTO, 9, "current cps is %u, avg. cps is %u", (int)cps, (int)bw->cps);
   if (bw->cps <= bw->rlim)
     return 0;
   dt = (unsigned long) (bw->cpsN * (bw->cps / bw->rlim - 1) + 1000);
@@ -1931,19 +1956,19 @@ static int start_file_recv (STATE *state, char *args, int sz, BINKD_CONFIG *conf
       errno=0;
       state->in.time = safe_atol (argv[2], &errmesg);
       if (errmesg) {
-          Log ( 1, "File time parsing error: %s! (M_FILE \"%s %s %s %s\")", errmesg, argv[0], argv[1], argv[0], argv[2], argv[3] );
+          Logc (LOGC_PROTO,  1, "File time parsing error: %s! (M_FILE \"%s %s %s %s\")", errmesg, argv[0], argv[1], argv[0], argv[2], argv[3] );
       }
     }
     offset = (boff_t) strtoumax (argv[3], NULL, 10);
     if (!strcmp (argv[3], "-1"))
     {
       off_req = 1;
-      Log (6, "got offset request for %s", state->in.netname);
+      Logc (LOGC_PROTO, 6, "got offset request for %s", state->in.netname);
       if ((state->NR_flag & THEY_NR) == 0)
       {
         state->NR_flag |= THEY_NR;
         if ((state->ND_flag & THEY_ND) == 0)
-          Log (3, "remote is in NR mode");
+          Logc (LOGC_PROTO, 3, "remote is in NR mode");
       }
     }
 
@@ -1955,7 +1980,7 @@ static int start_file_recv (STATE *state, char *args, int sz, BINKD_CONFIG *conf
       int rc;
 
       if ((rc = perl_before_recv(state, offset)) > 0) {
-        Log (1, "skipping %s (%sdestructive, %" PRIuMAX " byte(s), by Perl before_recv)",
+        Logc (LOGC_PROTO, 1, "skipping %s (%sdestructive, %" PRIuMAX " byte(s), by Perl before_recv)",
              state->in.netname, rc == SKIP_D ? "" : "non-",
              (uintmax_t) state->in.size);
         msg_sendf (state, (t_msg)(rc == SKIP_D ? M_GOT : M_SKIP),
@@ -1968,7 +1993,7 @@ static int start_file_recv (STATE *state, char *args, int sz, BINKD_CONFIG *conf
 #endif
       /* val: skip check */
       if ((mask = skip_test(state, config)) != NULL) {
-        Log (1, "skipping %s (%sdestructive, %" PRIuMAX " byte(s), mask %s)",
+        Logc (LOGC_PROTO, 1, "skipping %s (%sdestructive, %" PRIuMAX " byte(s), mask %s)",
              state->in.netname, mask->destr ? "" : "non-",
              (uintmax_t) state->in.size, mask->mask);
         msg_sendf (state, (t_msg)(mask->destr ? M_GOT : M_SKIP),
@@ -1984,7 +2009,7 @@ static int start_file_recv (STATE *state, char *args, int sz, BINKD_CONFIG *conf
                     state->in.time, state->inbound, realname,
                     config->renamestyle))
       {
-        Log (2, "already have %s (%s, %" PRIuMAX " byte(s))",
+        Logc (LOGC_PROTO, 2, "already have %s (%s, %" PRIuMAX " byte(s))",
              state->in.netname, realname, (uintmax_t) state->in.size);
         msg_sendf (state, M_GOT, "%s %" PRIuMAX " %" PRIuMAX,
                    state->in.netname,
@@ -2004,14 +2029,14 @@ static int start_file_recv (STATE *state, char *args, int sz, BINKD_CONFIG *conf
       if (!state->skip_all_flag &&
           (state->n_rcvdlist+1ul) * sizeof(RCVDLIST) > 64535ul)
       {
-        Log (1, "ReceivedList has reached max size 64K");
+        Logc (LOGC_PROTO, 1, "ReceivedList has reached max size 64K");
         state->skip_all_flag = 1;
       }
 #endif
 
       if (state->skip_all_flag)
       {
-        Log (2, "skipping %s (non-destructive)", state->in.netname);
+        Logc (LOGC_PROTO, 2, "skipping %s (non-destructive)", state->in.netname);
         msg_sendf (state, M_SKIP, "%s %" PRIuMAX " %" PRIuMAX,
                    state->in.netname,
                    (uintmax_t) state->in.size,
@@ -2025,7 +2050,7 @@ static int start_file_recv (STATE *state, char *args, int sz, BINKD_CONFIG *conf
 
     if (off_req || offset != ftello (state->in.f))
     {
-      Log (2, "have %" PRIuMAX " byte(s) of %s",
+      Logc (LOGC_PROTO, 2, "have %" PRIuMAX " byte(s) of %s",
            (uintmax_t) ftello (state->in.f), state->in.netname);
       msg_sendf (state, M_GET, "%s %" PRIuMAX " %" PRIuMAX " %" PRIuMAX,
                  state->in.netname,
@@ -2041,7 +2066,7 @@ static int start_file_recv (STATE *state, char *args, int sz, BINKD_CONFIG *conf
       --state->GET_FILE_balance;
     }
 
-    Log (3, "receiving %s (%" PRIuMAX " byte(s), off %" PRIuMAX ")",
+    Logc (LOGC_PROTO, 3, "receiving %s (%" PRIuMAX " byte(s), off %" PRIuMAX ")",
          state->in.netname, (uintmax_t) (state->in.size), (uintmax_t) offset);
 #ifdef BW_LIM
     setup_rate_limit(state, config, &state->bw_recv, state->in.netname);
@@ -2054,7 +2079,7 @@ static int start_file_recv (STATE *state, char *args, int sz, BINKD_CONFIG *conf
       else if (strcmp(w, "GZ") == 0)
       {
         if (state->z_recv == 0)
-          Log (4, "gzip mode is on for %s", state->in.netname);
+          Logc (LOGC_PROTO, 4, "gzip mode is on for %s", state->in.netname);
         state->z_recv |= 1;
       }
 #endif
@@ -2062,18 +2087,18 @@ static int start_file_recv (STATE *state, char *args, int sz, BINKD_CONFIG *conf
       else if (strcmp(w, "BZ2") == 0)
       {
         if (state->z_recv == 0)
-          Log (4, "bzip2 mode is on for %s", state->in.netname);
+          Logc (LOGC_PROTO, 4, "bzip2 mode is on for %s", state->in.netname);
         state->z_recv |= 2;
       }
 #endif
       else
-        Log (4, "Unknown option %s for %s ignored", w, state->in.netname);
+        Logc (LOGC_PROTO, 4, "Unknown option %s for %s ignored", w, state->in.netname);
       free(w);
     }
 
 #if defined(WITH_ZLIB) && defined(WITH_BZLIB2)
     if (state->z_recv == 3) {
-      Log (1, "Both GZ and BZ2 extras are specified for %s", state->in.netname);
+      Logc (LOGC_PROTO, 1, "Both GZ and BZ2 extras are specified for %s", state->in.netname);
       msg_send2 (state, M_ERR, "Can't handle GZ and BZ2 at the same time for ", state->in.netname);
       return 0;
     }
@@ -2081,7 +2106,7 @@ static int start_file_recv (STATE *state, char *args, int sz, BINKD_CONFIG *conf
 
     if (fseeko (state->in.f, offset, SEEK_SET) == -1)
     {
-      Log (1, "fseek: %s", strerror (errno));
+      Logc (LOGC_PROTO, 1, "fseek: %s", strerror (errno));
       return 0;
     }
     else
@@ -2100,7 +2125,7 @@ static int ND_set_status(char *status, FTN_ADDR *fa, STATE *state, BINKD_CONFIG
   UNUSED_ARG(state);
 
   if (fa->z==-1)
-  { Log(8, "ND_set_status: unknown address for '%s'", status);
+  { Logc(LOGC_PROTO, 8, "ND_set_status: unknown address for '%s'", status);
     return 0;
   }
   ftnaddress_to_filename (buf, fa, config);
@@ -2109,24 +2134,24 @@ static int ND_set_status(char *status, FTN_ADDR *fa, STATE *state, BINKD_CONFIG
   if (!status || !*status)
   {
     if (unlink(buf) == 0)
-    { Log(5, "Clean link status for %u:%u/%u.%u",
+    { Logc(LOGC_PROTO, 5, "Clean link status for %u:%u/%u.%u",
           fa->z, fa->net, fa->node, fa->p);
       return 1;
     }
     rc = errno;
     if (access(buf, F_OK) == 0)
-    { Log(1, "Can't unlink %s: %s!", buf, strerror(rc));
+    { Logc(LOGC_PROTO, 1, "Can't unlink %s: %s!", buf, strerror(rc));
       return 0;
     }
     return 1;
   }
   else
   {
-    Log(5, "Set link status for %u:%u/%u.%u to '%s'",
+    Logc(LOGC_PROTO, 5, "Set link status for %u:%u/%u.%u to '%s'",
         fa->z, fa->net, fa->node, fa->p, status);
     f=fopen(buf, "w");
     if (f==NULL)
-    { Log(1, "Can't write to %s: %s", buf, strerror(errno));
+    { Logc(LOGC_PROTO, 1, "Can't write to %s: %s", buf, strerror(errno));
       return 0;
     }
     rc=1;
@@ -2145,23 +2170,23 @@ static void z_send_init(STATE *state, BINKD_CONFIG *config, char **extra)
 
   *extra = "";
   if (state->z_cansend && state->extcmd && state->out.size >= config->zminsize
-      && zrule_test(ZRULE_ALLOW, state->out.netname, config->zrules.first)) {
+      && zrule_test(ZRULE_ALLOW, state->out.netname, config)) {
 #ifdef WITH_BZLIB2
     if (!state->z_send && (state->z_cansend & 2)) {
       *extra = " BZ2"; state->z_send = 2;
-      Log (4, "bzip2 mode is on for %s", state->out.netname);
+      Logc (LOGC_PROTO, 4, "bzip2 mode is on for %s", state->out.netname);
     }
 #endif
 #ifdef WITH_ZLIB
     if (!state->z_send && (state->z_cansend & 1)) {
       *extra = " GZ"; state->z_send = 1;
-      Log (4, "gzip mode is on for %s", state->out.netname);
+      Logc (LOGC_PROTO, 4, "gzip mode is on for %s", state->out.netname);
     }
 #endif
     if (state->z_send)
       if ((rc = compress_init(state->z_send, config->zlevel, &state->z_odata)))
       {
-        Log (1, "compress_init failed (rc=%d), send uncompressed file %s",
+        Logc (LOGC_PROTO, 1, "compress_init failed (rc=%d), send uncompressed file %s",
              rc, state->out.netname);
         *extra = "";
         state->z_send = 0;
@@ -2205,7 +2230,7 @@ static int GET (STATE *state, char *args, int sz, BINKD_CONFIG *config)
       fsize = (boff_t)strtoumax (argv[1], NULL, 10);
       ftime = safe_atol (argv[2], &errmesg);
       if(errmesg){
-        Log ( 1, "File time parsing error: %s! (M_GET \"%s %s %s %s\")", errmesg, argv[0], argv[1], argv[0], argv[2], argv[3] );
+        Logc (LOGC_PROTO,  1, "File time parsing error: %s! (M_GET \"%s %s %s %s\")", errmesg, argv[0], argv[1], argv[0], argv[2], argv[3] );
       }
     }
     /* Check if the file was already sent */
@@ -2229,7 +2254,7 @@ static int GET (STATE *state, char *args, int sz, BINKD_CONFIG *config)
         }
         if ((state->out.f = fopen (state->out.path, "rb")) == 0)
         {
-          Log (1, "GET: %s: %s", state->out.path, strerror (errno));
+          Logc (LOGC_PROTO, 1, "GET: %s: %s", state->out.path, strerror (errno));
           TF_ZERO (&state->out);
         }
         break;
@@ -2251,7 +2276,7 @@ static int GET (STATE *state, char *args, int sz, BINKD_CONFIG *config)
         {
           state->send_eof = 1;
           state->waiting_for_GOT = 1;
-          Log(5, "Waiting for M_GOT");
+          Logc(LOGC_PROTO, 5, "Waiting for M_GOT");
           state->off_req_sent = 0;
           return rc;
         }
@@ -2262,7 +2287,7 @@ static int GET (STATE *state, char *args, int sz, BINKD_CONFIG *config)
       }
       else if ((offset = (boff_t)strtoumax (argv[3], NULL, 10)) > state->out.size)
       {
-        Log (1, "GET: remote requests seeking %s to %" PRIuMAX ", file size " PRIuMAX,
+        Logc (LOGC_PROTO, 1, "GET: remote requests seeking %s to %" PRIuMAX ", file size " PRIuMAX,
              argv[0], (uintmax_t) offset, (uintmax_t) state->out.size);
         msg_sendf(state, M_ERR, "Invalid M_GET violates binkp: offset " PRIuMAX " after end of file, file %s size " PRIuMAX,
                   (uintmax_t)offset, argv[0], (uintmax_t)state->out.size);
@@ -2274,7 +2299,7 @@ static int GET (STATE *state, char *args, int sz, BINKD_CONFIG *config)
       }
       else if (fseeko (state->out.f, offset, SEEK_SET) == -1)
       {
-        Log (1, "GET: error seeking %s to %" PRIuMAX ": %s",
+        Logc (LOGC_PROTO, 1, "GET: error seeking %s to %" PRIuMAX ": %s",
              argv[0], (uintmax_t) offset, strerror (errno));
         msg_sendf(state, M_ERR, "Error seeking: %s size " PRIuMAX " to offset " PRIuMAX,
                   argv[0], (uintmax_t)state->out.size, (uintmax_t)offset);
@@ -2284,13 +2309,13 @@ static int GET (STATE *state, char *args, int sz, BINKD_CONFIG *config)
       }
       else
       {
-        Log (2, "sending %s from %" PRIuMAX, argv[0], (uintmax_t) offset);
+        Logc (LOGC_PROTO, 2, "sending %s from %" PRIuMAX, argv[0], (uintmax_t) offset);
         for (argc = 1; (extra = getwordx (args, argc, 0)) != 0; ++argc)
         {
           if (strcmp(extra, "GZ") == 0 || strcmp(extra, "BZ2") == 0) ;
           else if (strcmp(extra, "NZ") == 0) nz = 1;
           else if (extra[0])
-            Log (4, "Unknown option %s for %s ignored", extra, argv[0]);
+            Logc (LOGC_PROTO, 4, "Unknown option %s for %s ignored", extra, argv[0]);
           free(extra);
         }
         z_send_stop(state);
@@ -2304,13 +2329,13 @@ static int GET (STATE *state, char *args, int sz, BINKD_CONFIG *config)
       }
     }
     else
-      Log (1, "unexpected M_GET for %s", argv[0]);
+      Logc (LOGC_PROTO, 1, "unexpected M_GET for %s", argv[0]);
     ND_set_status("", &state->ND_addr, state, config);
     state->ND_addr.z=-1;
     if (state->ND_flag & WE_ND)
     {
       state->waiting_for_GOT = 0;
-      Log(9, "Don't waiting for M_GOT");
+      Logc(LOGC_PROTO, 9, "Don't waiting for M_GOT");
     }
     state->off_req_sent = 0;
 
@@ -2344,7 +2369,7 @@ static int SKIP (STATE *state, char *args, int sz, BINKD_CONFIG *config)
       ftime = safe_atol (argv[2], &errmesg);
       if (errmesg)
       {
-        Log ( 1, "File time parsing error: %s! (M_SKIP \"%s %s %s\")", errmesg, argv[0], argv[1], argv[0], argv[2] );
+        Logc (LOGC_PROTO,  1, "File time parsing error: %s! (M_SKIP \"%s %s %s\")", errmesg, argv[0], argv[1], argv[0], argv[2] );
       }
     }
     for (n = 0; n < state->n_sent_fls; ++n)
@@ -2352,7 +2377,7 @@ static int SKIP (STATE *state, char *args, int sz, BINKD_CONFIG *config)
       if (!tfile_cmp (state->sent_fls + n, argv[0], fsize, ftime))
       {
         state->r_skipped_flag = 1;
-        Log (2, "%s skipped by remote", state->sent_fls[n].netname);
+        Logc (LOGC_PROTO, 2, "%s skipped by remote", state->sent_fls[n].netname);
         memcpy (&state->ND_addr, &state->sent_fls[n].fa, sizeof(FTN_ADDR));
         remove_from_sent_files_queue (state, n);
       }
@@ -2364,11 +2389,11 @@ static int SKIP (STATE *state, char *args, int sz, BINKD_CONFIG *config)
         fclose (state->out.f);
       else
       {
-        Log (1, "Cannot skip ND-status, session dropped");
+        Logc (LOGC_PROTO, 1, "Cannot skip ND-status, session dropped");
         msg_send2(state, M_ERR, "Cannot skip ND-status", 0);
         return 0;
       }
-      Log (2, "%s skipped by remote", state->out.netname);
+      Logc (LOGC_PROTO, 2, "%s skipped by remote", state->out.netname);
       TF_ZERO (&state->out);
     }
     ND_set_status("", &state->ND_addr, state, config);
@@ -2376,7 +2401,7 @@ static int SKIP (STATE *state, char *args, int sz, BINKD_CONFIG *config)
     if ((state->ND_flag & WE_ND) || (state->NR_flag & WE_NR))
     {
       state->waiting_for_GOT = state->off_req_sent = 0;
-      Log(9, "Don't waiting for M_GOT");
+      Logc(LOGC_PROTO, 9, "Don't waiting for M_GOT");
     }
     return 1;
   }
@@ -2413,11 +2438,11 @@ static int GOT (STATE *state, char *args, int sz, BINKD_CONFIG *config)
     ftime = safe_atol (argv[2], &errmesg);
     if (errmesg)
     {
-      Log ( 1, "File time parsing error: %s! (M_GOT \"%s %s %s\")", errmesg, argv[0], argv[1], argv[0], argv[2] );
+      Logc (LOGC_PROTO,  1, "File time parsing error: %s! (M_GOT \"%s %s %s\")", errmesg, argv[0], argv[1], argv[0], argv[2] );
     }
     if (!tfile_cmp (&state->out, argv[0], fsize, ftime))
     {
-      Log (2, "remote already has %s", state->out.netname);
+      Logc (LOGC_PROTO, 2, "remote already has %s", state->out.netname);
       if (state->out.f)
       {
         fclose (state->out.f);
@@ -2425,7 +2450,7 @@ static int GOT (STATE *state, char *args, int sz, BINKD_CONFIG *config)
       }
       memcpy(&state->ND_addr, &state->out.fa, sizeof(state->out.fa));
       if (state->ND_flag & WE_ND)
-        Log (7, "Set ND_addr to %u:%u/%u.%u",
+        Logc (LOGC_PROTO, 7, "Set ND_addr to %u:%u/%u.%u",
              state->ND_addr.z, state->ND_addr.net, state->ND_addr.node, state->ND_addr.p);
       if (status)
       {
@@ -2435,7 +2460,7 @@ static int GOT (STATE *state, char *args, int sz, BINKD_CONFIG *config)
           rc = ND_set_status(status, &state->ND_addr, state, config);
       }
       state->waiting_for_GOT = state->off_req_sent = 0;
-      Log(9, "Don't waiting for M_GOT");
+      Logc(LOGC_PROTO, 9, "Don't waiting for M_GOT");
       remove_from_spool (state, state->out.flo,
                          state->out.path, state->out.action, config);
       TF_ZERO (&state->out);
@@ -2453,9 +2478,9 @@ static int GOT (STATE *state, char *args, int sz, BINKD_CONFIG *config)
           ++state->files_sent;
           memcpy (&state->ND_addr, &state->sent_fls[n].fa, sizeof(FTN_ADDR));
           if (state->ND_flag & WE_ND)
-             Log (7, "Set ND_addr to %u:%u/%u.%u",
+             Logc (LOGC_PROTO, 7, "Set ND_addr to %u:%u/%u.%u",
                   state->ND_addr.z, state->ND_addr.net, state->ND_addr.node, state->ND_addr.p);
-          Log (2, "sent: %s (%" PRIuMAX ", %.2f CPS, %s)",
+          Logc (LOGC_PROTO, 2, "sent: %s (%" PRIuMAX ", %.2f CPS, %s)",
                state->sent_fls[n].path,
                (uintmax_t) state->sent_fls[n].size,
                (double) (state->sent_fls[n].size) /
@@ -2469,7 +2494,7 @@ static int GOT (STATE *state, char *args, int sz, BINKD_CONFIG *config)
               rc = ND_set_status(status, &state->ND_addr, state, config);
           }
           state->waiting_for_GOT = 0;
-          Log(9, "Don't waiting for M_GOT");
+          Logc(LOGC_PROTO, 9, "Don't waiting for M_GOT");
 #ifdef WITH_PERL
           perl_after_sent(state, n);
 #endif
@@ -2505,10 +2530,10 @@ static int EOB (STATE *state, char *buf, int sz, BINKD_CONFIG *config)
       ftnaddress_to_str (nodestr, state->fa);
       fclose (state->in.f);
       state->in.f = NULL;
-      Log (1, "receiving of %s interrupted", state->in.netname);
-      Log (2, "Remove partially received %s (%" PRIuMAX " of %" PRIuMAX " bytes) due to remote bug",
+      Logc (LOGC_PROTO, 1, "receiving of %s interrupted", state->in.netname);
+      Logc (LOGC_PROTO, 2, "Remove partially received %s (%" PRIuMAX " of %" PRIuMAX " bytes) due to remote bug",
           state->in.netname, (uintmax_t) offset, (uintmax_t) state->in.size);
-      Log (1, "Turn on the NR mode for node %s in config to prevent this error, please", nodestr);
+      Logc (LOGC_PROTO, 1, "Turn on the NR mode for node %s in config to prevent this error, please", nodestr);
       inb_reject (state, config);
       TF_ZERO (&state->in);
     }
@@ -2552,7 +2577,8 @@ static int recv_block (STATE *state, BINKD_CONFIG *config)
       no = read (state->s_in, state->ibuf + state->iread, sz - state->iread);
     else
       no = recv (state->s_in, state->ibuf + state->iread, sz - state->iread, 0);
-    Log (9, "Read %i bytes", no);
+    if (LogOn (LOGC_PROTO, 9))
+      Logc (LOGC_PROTO, 9, "Read %i bytes", no);
     if (no == -1)
     {
       const char *save_err;
@@ -2565,7 +2591,7 @@ static int recv_block (STATE *state, BINKD_CONFIG *config)
       state->io_error = 1;
       if (!binkd_exit)
       {
-        Log (1, "%s: %s", state->pipe ? "read" : "recv", save_err);
+        Logc (LOGC_PROTO, 1, "%s: %s", state->pipe ? "read" : "recv", save_err);
         if (state->to)
           bad_try (&state->to->fa, save_err, BAD_IO, config);
       }
@@ -2586,14 +2612,16 @@ static int recv_block (STATE *state, BINKD_CONFIG *config)
       state->imsg = state->ibuf[0] >> 7;
       state->isize = ((((unsigned char *) state->ibuf)[0] & ~0x80) << 8) +
         ((unsigned char *) state->ibuf)[1];
-      Log (7, "recvd hdr: %i (%s)", state->isize, state->imsg ? "msg" : "data");
+      if (LogOn (LOGC_PROTO, 7))
+        Logc (LOGC_PROTO, 7, "recvd hdr: %i (%s)", state->isize, state->imsg ? "msg" : "data");
       if (state->isize == 0)
         goto DoNotEvenTryToRecvZeroLengthBlock;
     }
     else
     {
   DoNotEvenTryToRecvZeroLengthBlock:
-      Log (7, "got block: %i (%s)", state->isize, state->imsg ? "msg" : "data");
+      if (LogOn (LOGC_PROTO, 7))
+        Logc (LOGC_PROTO, 7, "got block: %i (%s)", state->isize, state->imsg ? "msg" : "data");
       if (state->imsg)
       {
         int rc = 1;
@@ -2604,13 +2632,13 @@ static int recv_block (STATE *state, BINKD_CONFIG *config)
         perl_on_recv(state, state->ibuf, state->isize);
 #endif
         if (state->isize == 0)
-          Log (1, "zero length command from remote (must be at least 1)");
+          Logc (LOGC_PROTO, 1, "zero length command from remote (must be at least 1)");
         else if ((unsigned) (state->ibuf[0]) > M_MAX)
-          Log (1, "unknown msg type from remote: %u", state->ibuf[0]);
+          Logc (LOGC_PROTO, 1, "unknown msg type from remote: %u", state->ibuf[0]);
         else
         {
           state->ibuf[state->isize] = 0;
-          Log (5, "rcvd msg %s %s", scommand[(unsigned char)(state->ibuf[0])], state->ibuf+1);
+          Logc (LOGC_PROTO, 5, "rcvd msg %s %s", scommand[(unsigned char)(state->ibuf[0])], state->ibuf+1);
           rc = commands[(unsigned) (state->ibuf[0])]
             (state, state->ibuf + 1, state->isize - 1, config);
         }
@@ -2634,10 +2662,10 @@ static int recv_block (STATE *state, BINKD_CONFIG *config)
           {
             if (decompress_init(state->z_recv, &state->z_idata))
             {
-              Log (1, "Can't init decompress");
+              Logc (LOGC_PROTO, 1, "Can't init decompress");
               return 0;
             } else
-              Log (8, "decompress_init success");
+              Logc (LOGC_PROTO, 8, "decompress_init success");
           }
           while (nget)
           {
@@ -2647,14 +2675,15 @@ static int recv_block (STATE *state, BINKD_CONFIG *config)
                                state->z_idata);
             if (rc < 0)
             {
-              Log (1, "Decompress %s error %d", state->in.netname, rc);
+              Logc (LOGC_PROTO, 1, "Decompress %s error %d", state->in.netname, rc);
               return 0;
             }
             else
-              Log (10, "%d bytes of data decompressed to %d", nput, zavail);
+              if (LogOn (LOGC_PROTO, 10))
+                Logc (LOGC_PROTO, 10, "%d bytes of data decompressed to %d", nput, zavail);
             if (zavail != 0 && fwrite (zbuf, zavail, 1, state->in.f) < 1)
             {
-              Log (1, "write error: %s", strerror(errno));
+              Logc (LOGC_PROTO, 1, "write error: %s", strerror(errno));
               decompress_abort(state->z_recv, state->z_idata);
               state->z_idata = NULL;
               return 0;
@@ -2666,12 +2695,12 @@ static int recv_block (STATE *state, BINKD_CONFIG *config)
           }
           if (rc == 1)
           { if ((rc = decompress_deinit(state->z_recv, state->z_idata)) < 0)
-              Log (1, "decompress_deinit retcode %d", rc);
+              Logc (LOGC_PROTO, 1, "decompress_deinit retcode %d", rc);
             state->z_idata = NULL;
           }
           if (fflush(state->in.f))
           {
-            Log (1, "write error: %s", strerror(errno));
+            Logc (LOGC_PROTO, 1, "write error: %s", strerror(errno));
             return 0;
           }
         }
@@ -2681,7 +2710,7 @@ static int recv_block (STATE *state, BINKD_CONFIG *config)
             (fwrite (state->ibuf, state->isize, 1, state->in.f) < 1 ||
             fflush (state->in.f)))
         {
-          Log (1, "write error: %s", strerror(errno));
+          Logc (LOGC_PROTO, 1, "write error: %s", strerror(errno));
           return 0;
         }
         if (config->percents && state->in.size > 0)
@@ -2696,7 +2725,7 @@ static int recv_block (STATE *state, BINKD_CONFIG *config)
         {
           if (fclose (state->in.f))
           {
-            Log (1, "Cannot fclose(%s): %s!",
+            Logc (LOGC_PROTO, 1, "Cannot fclose(%s): %s!",
                  state->in.netname, strerror (errno));
             state->in.f = NULL;
             return 0;
@@ -2705,12 +2734,12 @@ static int recv_block (STATE *state, BINKD_CONFIG *config)
 #if defined(WITH_ZLIB) || defined(WITH_BZLIB2)
           if (state->z_recv)
           {
-            Log (4, "File %s compressed size %" PRIuMAX " bytes, compress ratio %.1f%%",
+            Logc (LOGC_PROTO, 4, "File %s compressed size %" PRIuMAX " bytes, compress ratio %.1f%%",
                  state->in.netname, (uintmax_t) state->z_cisize,
                  100.0 * state->z_cisize / state->z_isize);
             if (state->z_idata)
             {
-              Log (1, "Warning: extra compressed data ignored");
+              Logc (LOGC_PROTO, 1, "Warning: extra compressed data ignored");
               decompress_deinit(state->z_recv, state->z_idata);
               state->z_idata = NULL;
             }
@@ -2718,7 +2747,7 @@ static int recv_block (STATE *state, BINKD_CONFIG *config)
 #endif
           if (state->ND_flag & THEY_ND)
           {
-            Log (5, "File %s complete received, waiting for renaming",
+            Logc (LOGC_PROTO, 5, "File %s complete received, waiting for renaming",
                  state->in.netname);
             memcpy(&state->in_complete, &state->in, sizeof(state->in_complete));
           }
@@ -2740,14 +2769,14 @@ static int recv_block (STATE *state, BINKD_CONFIG *config)
         }
         else if (ftello (state->in.f) > state->in.size)
         {
-          Log (1, "rcvd %" PRIuMAX " extra bytes!",
+          Logc (LOGC_PROTO, 1, "rcvd %" PRIuMAX " extra bytes!",
                (uintmax_t) (ftello (state->in.f) - state->in.size));
           return 0;
         }
       }
       else if (state->isize > 0)
       {
-        Log (7, "ignoring data block (%" PRIuMAX " byte(s))",
+        Logc (LOGC_PROTO, 7, "ignoring data block (%" PRIuMAX " byte(s))",
              (uintmax_t) state->isize);
       }
       state->isize = -1;
@@ -2760,7 +2789,7 @@ static int recv_block (STATE *state, BINKD_CONFIG *config)
     if (!binkd_exit)
     {
       char *s_err = "connection closed by foreign host";
-      Log (1, "recv: %s", s_err);
+      Logc (LOGC_PROTO, 1, "recv: %s", s_err);
       if (state->to)
         bad_try (&state->to->fa, s_err, BAD_IO, config);
     }
@@ -2824,7 +2853,7 @@ static int banner (STATE *state, BINKD_CONFIG *config)
   if (state->to) {
     char *s = perl_on_handshake(state);
     if (s && *s) {
-      Log (1, "aborted by Perl on_handshake(): %s", s);
+      Logc (LOGC_PROTO, 1, "aborted by Perl on_handshake(): %s", s);
       msg_send2 (state, M_ERR, s, 0);
       return 0;
     }
@@ -2880,7 +2909,7 @@ static int start_file_transfer (STATE *state, FTNQ *file, BINKD_CONFIG *config)
       if ((f = fopen (file->path, (file->type == 'l') ? "r+b" : "rb")) == 0 ||
           fstat (fileno (f), &sb) == -1)
       {
-        Log (1, "%s: cannot open: %s", file->path, strerror (errno));
+        Logc (LOGC_PROTO, 1, "%s: cannot open: %s", file->path, strerror (errno));
         return 0;
       }
       /* We've opened a .?lo */
@@ -2895,7 +2924,7 @@ static int start_file_transfer (STATE *state, FTNQ *file, BINKD_CONFIG *config)
     memcpy (&state->out.fa, &file->fa, sizeof(FTN_ADDR));
     if ((state->ND_flag & WE_ND) == 0)
       memcpy(&state->ND_addr, &file->fa, sizeof(state->ND_addr));
-    Log (8, "cur remote addr is %u:%u/%u.%u",
+    Logc (LOGC_PROTO, 8, "cur remote addr is %u:%u/%u.%u",
          file->fa.z, file->fa.net, file->fa.node, file->fa.p);
   }
   if (state->flo.f != 0)
@@ -2916,7 +2945,7 @@ static int start_file_transfer (STATE *state, FTNQ *file, BINKD_CONFIG *config)
       }
 
       if ((w = trans_flo_line (state->out.path, config->rf_rules.first)) != 0)
-        Log (5, "%s mapped to %s", state->out.path, w);
+        Logc (LOGC_PROTO, 5, "%s mapped to %s", state->out.path, w);
 
       /* look for the file in not-to-send list */
       for (i = 0; i < state->n_nosendlist; i++)
@@ -2932,7 +2961,7 @@ static int start_file_transfer (STATE *state, FTNQ *file, BINKD_CONFIG *config)
           fstat (fileno (f), &sb) == -1 ||
           (sb.st_mode & S_IFDIR) != 0)
       {
-        Log (1, "start_file_transfer: %s: %s",
+        Logc (LOGC_PROTO, 1, "start_file_transfer: %s: %s",
              w ? w : state->out.path, strerror (errno));
         if (f) fclose(f);
         xfree (w);
@@ -2964,24 +2993,24 @@ static int start_file_transfer (STATE *state, FTNQ *file, BINKD_CONFIG *config)
   state->out.size = sb.st_size;
   state->out.time = sb.st_mtime;
   state->waiting_for_GOT = 0;
-  Log(9, "Dont waiting for M_GOT");
+  Logc(LOGC_PROTO, 9, "Dont waiting for M_GOT");
   state->out.start = safe_time();
   netname (state->out.netname, &state->out, config);
   if ((state->out.type == 'm' || (ispkt(state->out.netname) && config->dontsendempty >= EMPTY_ARCMAIL)) && state->out.size <= 60)
   {
-    Log (3, "skip empty pkt %s, %" PRIuMAX " bytes", state->out.path,
+    Logc (LOGC_PROTO, 3, "skip empty pkt %s, %" PRIuMAX " bytes", state->out.path,
          (uintmax_t) state->out.size);
     dontsend = 1;
   }
   else if (config->dontsendempty >= EMPTY_ARCMAIL &&
       state->out.size == 0 && isarcmail(state->out.netname))
   {
-    Log (3, "skip empty arcmail %s", state->out.path);
+    Logc (LOGC_PROTO, 3, "skip empty arcmail %s", state->out.path);
     dontsend = 1;
   }
   else if (config->dontsendempty == EMPTY_ALL && state->out.size == 0)
   {
-    Log (3, "skip empty attach %s", state->out.path);
+    Logc (LOGC_PROTO, 3, "skip empty attach %s", state->out.path);
     dontsend = 1;
   }
   if (dontsend)
@@ -2994,7 +3023,7 @@ static int start_file_transfer (STATE *state, FTNQ *file, BINKD_CONFIG *config)
   }
 #ifdef WITH_PERL
   if (perl_before_send(state) > 0) {
-    Log(3, "sending %s aborted by Perl before_send()", state->out.path);
+    Logc(LOGC_PROTO, 3, "sending %s aborted by Perl before_send()", state->out.path);
     if (state->out.f) fclose(state->out.f);
     remove_from_spool (state, state->out.flo,
                        state->out.path, state->out.action, config);
@@ -3002,7 +3031,7 @@ static int start_file_transfer (STATE *state, FTNQ *file, BINKD_CONFIG *config)
     return 0;
   }
 #endif
-  Log (2, "sending %s as %s (%" PRIuMAX ")",
+  Logc (LOGC_PROTO, 2, "sending %s as %s (%" PRIuMAX ")",
        state->out.path, state->out.netname, (uintmax_t) state->out.size);
 #ifdef BW_LIM
   setup_rate_limit(state, config, &state->bw_send, state->out.netname);
@@ -3044,13 +3073,69 @@ static void log_end_of_session (int status, STATE *state, BINKD_CONFIG *config)
   else
     strcpy (szFTNAddr, "?");
 
-  Log (2, "done (%s%s, %s, S/R: %i/%i (%" PRIuMAX "/%" PRIuMAX " bytes))",
+  Logc (LOGC_PROTO, 2, "done (%s%s, %s, S/R: %i/%i (%" PRIuMAX "/%" PRIuMAX " bytes))",
        state->to ? "to " : (state->fa ? "from " : ""), szFTNAddr,
        status ? "failed" : "OK",
        state->files_sent, state->files_rcvd,
        state->bytes_sent, state->bytes_rcvd);
 }
 
+/*
+ * Hot standby: with "linger" a secure binkp/1.1 session with nothing
+ * to send doesn't send M_EOB at once, but rescans the outbound each
+ * second for up to config->linger seconds. New files are sent in the
+ * current batch. Returns 1 while M_EOB has to be delayed.
+ */
+static int linger (STATE *state, BINKD_CONFIG *config)
+{
+  time_t now = safe_time ();
+  FTNQ *curr;
+  int i, n = 0;
+
+  /* a file skipped by the remote stays in the outbound, don't offer it again */
+  if (config->linger == 0 || state->state != P_SECURE || binkd_exit ||
+      state->r_skipped_flag ||
+      !OK_SEND_FILES (state, config) || state->major * 100 + state->minor <= 100)
+    return 0;
+  if (state->linger_until == 0)
+  {
+    state->linger_until = now + config->linger;
+    state->linger_scan = now;
+    Logc (LOGC_PROTO, 6, "no files to send, lingering for %i sec", config->linger);
+    return 1;
+  }
+  if (now >= state->linger_until)
+    return 0;
+  if (now == state->linger_scan)
+    return 1;
+
+  state->linger_scan = now;
+  state->q = q_scan_addrs (0, state->fa, state->nfa, state->to ? 1 : 0, config);
+  for (curr = state->q; curr; curr = curr->next)
+  {
+    /* statuses are sent once per session, requests are killed after it */
+    if (curr->type == 's')
+      curr->sent = 1;
+    for (i = 0; i < state->n_killlist && !curr->sent; i++)
+      if (!strcmp (curr->path, state->killlist[i].name))
+        curr->sent = 1;
+    for (i = 0; i < state->n_nosendlist && !curr->sent; i++)
+      if (!strcmp (curr->path, state->nosendlist[i]))
+        curr->sent = 1;
+    if (!curr->sent)
+      n++;
+  }
+  if (n == 0)
+  {
+    q_free (state->q, config);
+    state->q = NULL;
+    return 1;
+  }
+  Logc (LOGC_PROTO, 5, "%i new file(s) in the outbound, continuing the batch", n);
+  state->q = q_sort (state->q, state->fa, state->nfa, config);
+  return 1;
+}
+
 void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
                char *current_addr, char *current_port, char *remote_ip, BINKD_CONFIG *config)
 {
@@ -3074,6 +3159,7 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
 #ifdef BW_LIM
   int limited;
 #endif
+  int lingering;
 
   if (!init_protocol (&state, socket_in, socket_out, to, fa, config))
     return;
@@ -3107,13 +3193,13 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
         {
           status = -1;
           if (!to)
-            Log (1, "%s, getaddrinfo error (empty result)", current_addr);
+            Logc (LOGC_PROTO, 1, "%s, getaddrinfo error (empty result)", current_addr);
         }
       }
       else
       {
         if (!to)
-          Log (1, "%s, getaddrinfo error: %s (%d)", current_addr, gai_strerror(status), status);
+          Logc (LOGC_PROTO, 1, "%s, getaddrinfo error: %s (%d)", current_addr, gai_strerror(status), status);
       }
     }
   }
@@ -3122,7 +3208,7 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
     if ((status = getpeername (socket_in, (struct sockaddr *)&peer_name, &peer_name_len)) != 0)
     {
       if (!binkd_exit)
-        Log (1, "getpeername: %s", TCPERR());
+        Logc (LOGC_PROTO, 1, "getpeername: %s", TCPERR());
     }
     /* verify that output of getpeername() is safe (enough) and resolve
      * IP and hostname if so requested and possible.
@@ -3139,7 +3225,7 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
 		ipaddr, sizeof(ipaddr), service, sizeof(service),
 		NI_NUMERICSERV | NI_NUMERICHOST)) != 0)
       {
-        Log(1, "Error in numeric getnameinfo(): %s (%d)", 
+        Logc(LOGC_PROTO, 1, "Error in numeric getnameinfo(): %s (%d)", 
 	      gai_strerror(status), status);
         strnzcpy(ipaddr, "unknown", BINKD_FQDNLEN);
       }
@@ -3152,7 +3238,7 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
     status = getnameinfo((struct sockaddr *)&peer_name, peer_name_len, 
 		host, sizeof(host), NULL, 0, NI_NAMEREQD);
     if (status != 0 && status != EAI_NONAME)
-      Log(2, "Error in getnameinfo(): %s (%d)", 
+      Logc(LOGC_PROTO, 2, "Error in getnameinfo(): %s (%d)", 
 	  gai_strerror(status), status);
   }
 
@@ -3165,13 +3251,13 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
   setproctitle ("%c [%s]", to ? 'o' : 'i', state.peer_name);
 #endif
   if (strcmp(state.ipaddr, state.peer_name))
-    Log (2, "%s session with %s%s%s [%s]",
+    Logc (LOGC_PROTO, 2, "%s session with %s%s%s [%s]",
        to ? "outgoing" : "incoming",
        state.peer_name,
        current_port ? ":" : "", current_port ? current_port : "",
        state.ipaddr);
   else
-    Log (2, "%s session with %s%s%s",
+    Logc (LOGC_PROTO, 2, "%s session with %s%s%s",
        to ? "outgoing" : "incoming",
        state.peer_name,
        current_port ? ":" : "", current_port ? current_port : "");
@@ -3179,7 +3265,7 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
   if (state.pipe || getsockname (socket_in, (struct sockaddr *)&peer_name, &peer_name_len) == -1)
   {
     if (!state.pipe && !binkd_exit)
-      Log (1, "getsockname: %s", TCPERR ());
+      Logc (LOGC_PROTO, 1, "getsockname: %s", TCPERR ());
     memset(&peer_name, 0, sizeof (peer_name));
   }
   else
@@ -3193,13 +3279,13 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
       state.our_port=atoi(ownserv);
     }
     else
-      Log(2, "Error in getnameinfo(): %s (%d)", gai_strerror(status), status);
+      Logc(LOGC_PROTO, 2, "Error in getnameinfo(): %s (%d)", gai_strerror(status), status);
   }
 
   if (banner (&state, config) == 0) ;
   else if (n_servers > config->max_servers && !to)
   {
-    Log (1, "too many servers");
+    Logc (LOGC_PROTO, 1, "too many servers");
     msg_send2 (&state, M_BSY, "Too many servers", 0);
   }
   else
@@ -3231,10 +3317,17 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
       }
 
       /* No more files to send in this batch, so send EOB */
+      lingering = 0;
       if (!state.out.f && !state.q && !state.local_EOB && state.state != P_NULL && state.sent_fls == 0)
       {
+        if (linger (&state, config))
+        {
+          if (state.q)
+            continue;
+          lingering = 1;
+        }
         /* val: don't send EOB for binkp/1.0 if delay_EOB is set */
-        if (!state.delay_EOB || (state.major * 100 + state.minor > 100)) {
+        else if (!state.delay_EOB || (state.major * 100 + state.minor > 100)) {
           state.local_EOB = 1;
           msg_send2 (&state, M_EOB, 0, 0);
         }
@@ -3244,6 +3337,8 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
       FD_ZERO (&w);
       tv.tv_sec = config->nettimeout;               /* Set up timeout for select() */
       tv.tv_usec = 0;
+      if (lingering)
+        tv.tv_sec = 1;                              /* rescan the outbound */
 #ifdef BW_LIM
       limited = 0;
       if (check_rate_limit(&state.bw_recv, &tv))
@@ -3272,7 +3367,7 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
           q_to_killlist (&state.killlist, &state.n_killlist, state.q);
           free_rcvdlist (&state.rcvdlist, &state.n_rcvdlist);
         }
-        Log (6, "there were %i msgs in this batch", state.msgs_in_batch);
+        Logc (LOGC_PROTO, 6, "there were %i msgs in this batch", state.msgs_in_batch);
         if (state.msgs_in_batch <= 2 || (state.major * 100 + state.minor <= 100))
         { /* Only M_EOBs in last batch (binkp 1.1) or protocol is binkp 1.0 (or lower), close session */
           ND_set_status("", &state.ND_addr, &state, config);
@@ -3284,6 +3379,7 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
           /* Start the next batch */
           state.msgs_in_batch = 0;
           state.remote_EOB = state.local_EOB = 0;
+          state.linger_until = 0;
           if (OK_SEND_FILES (&state, config))
           {
             state.q = q_scan_boxes (state.q, state.fa, state.nfa, state.to ? 1 : 0, config);
@@ -3296,13 +3392,13 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
 #if defined(WIN32) /* workaround winsock bug */
       if (t_out >= u_nettimeout)
       {
-        Log (8, "win timeout detected (nettimeout=%u sec, t_out=%lu sec)", config->nettimeout, t_out/1000000);
+        Logc (LOGC_PROTO, 8, "win timeout detected (nettimeout=%u sec, t_out=%lu sec)", config->nettimeout, t_out/1000000);
         no = 0;
       }
       else
 #endif
       {
-        Log (8, "tv.tv_sec=%lu, tv.tv_usec=%lu",
+        Logc (LOGC_PROTO, 8, "tv.tv_sec=%lu, tv.tv_usec=%lu",
            (unsigned long) tv.tv_sec, (unsigned long) tv.tv_usec);
 #ifdef WIN32
         if (state.pipe)
@@ -3322,7 +3418,7 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
             if (!PeekNamedPipe((HANDLE)_get_osfhandle(socket_in), NULL, 0, NULL, &avail, NULL))
             {
               if (!binkd_exit)
-                Log (1, "PeekNamedPipe error, errcode %lu", GetLastError());
+                Logc (LOGC_PROTO, 1, "PeekNamedPipe error, errcode %lu", GetLastError());
             }
             else if (!avail)
               FD_CLR (socket_in, &r);
@@ -3334,17 +3430,18 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
           no = SELECT ((socket_in > socket_out ? socket_in : socket_out) + 1, &r, &w, 0, &tv);
         if (no < 0)
           save_err = TCPERR ();
-        Log (8, "selected %i (r=%i, w=%i)", no, FD_ISSET (socket_in, &r), FD_ISSET (socket_out, &w));
+        if (LogOn (LOGC_PROTO, 8))
+          Logc (LOGC_PROTO, 8, "selected %i (r=%i, w=%i)", no, FD_ISSET (socket_in, &r), FD_ISSET (socket_out, &w));
       }
       bsy_touch (config);                       /* touch *.bsy's */
-      if (no == 0
+      if (no == 0 && !lingering
 #ifdef BW_LIM
           && !limited
 #endif
           )
       {
         state.io_error = 1;
-        Log (1, "timeout!");
+        Logc (LOGC_PROTO, 1, "timeout!");
         if (to)
           bad_try (&to->fa, "Timeout!", BAD_IO, config);
         break;
@@ -3354,7 +3451,7 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
         state.io_error = 1;
         if (!binkd_exit)
         {
-          Log (1, "select: %s (args: %i %i)", save_err, socket_in, tv.tv_sec);
+          Logc (LOGC_PROTO, 1, "select: %s (args: %i %i)", save_err, socket_in, tv.tv_sec);
           if (to)
             bad_try (&to->fa, save_err, BAD_IO, config);
         }
@@ -3391,7 +3488,8 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
 #endif
             FD_SET (socket_in, &r);
         }
-        Log (9, "select for giveup cpu, r=%i, w=0, tv_sec=%lu, tv_usec=%lu", FD_ISSET(socket_in, &r), (unsigned long) tv.tv_sec, (unsigned long) tv.tv_usec);
+        if (LogOn (LOGC_PROTO, 9))
+          Logc (LOGC_PROTO, 9, "select for giveup cpu, r=%i, w=0, tv_sec=%lu, tv_usec=%lu", FD_ISSET(socket_in, &r), (unsigned long) tv.tv_sec, (unsigned long) tv.tv_usec);
         if (!SELECT (socket_in + 1, &r, 0, 0, &tv)
 #ifdef BW_LIM
             && !limited
@@ -3424,7 +3522,8 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
       break;
     }
     else
-      Log (9, "Purged %d bytes from input queue", no);
+      if (LogOn (LOGC_PROTO, 9))
+        Logc (LOGC_PROTO, 9, "Purged %d bytes from input queue", no);
   }
 
   /* Still have something to send */
@@ -3453,7 +3552,7 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
       /* We called and there were still files in transfer -- restore poll */
       if (tolower (state.maxflvr) != 'h')
       {
-        Log (4, "restoring poll with `%c' flavour", state.maxflvr);
+        Logc (LOGC_PROTO, 4, "restoring poll with `%c' flavour", state.maxflvr);
         create_poll (&state.to->fa, state.maxflvr, config);
       }
     }
@@ -3461,7 +3560,7 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
 
   if (to && state.r_skipped_flag && config->hold_skipped > 0)
   {
-    Log (2, "holding skipped mail for %lu sec",
+    Logc (LOGC_PROTO, 2, "holding skipped mail for %lu sec",
          (unsigned long) config->hold_skipped);
     hold_node (&to->fa, safe_time() + config->hold_skipped, config);
   }
@@ -3469,5 +3568,5 @@ void protocol (SOCKET socket_in, SOCKET socket_out, FTN_NODE *to, FTN_ADDR *fa,
   deinit_protocol (&state, config, status);
   evt_set (state.evt_queue);
   state.evt_queue = NULL;
-  Log (4, "session closed, quitting...");
+  Logc (LOGC_PROTO, 4, "session closed, quitting...");
 }
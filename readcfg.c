@@ -14,8 +14,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stddef.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#ifdef HAVE_INOTIFY_INIT1
+#include <sys/inotify.h>
+#endif
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #if defined (HAVE_VSYSLOG) && defined (HAVE_FACILITYNAMES)
 #define SYSLOG_NAMES
 #include <syslog.h>
@@ -94,6 +101,9 @@ void simplelist_free(struct list_linkpoint *lp, void (*destructor)(void *))
   l->linkpoint.last = NULL;
 }
 
+static void compile_masks (BINKD_CONFIG *c);
+static void maskset_free (MASKSET *ms);
+
 /*
  * Destructors for list entries
  */
@@ -203,6 +213,8 @@ static void destroy_proxy(void *p)
  */
 void lock_config_structure(BINKD_CONFIG *c)
 {
+  int i;
+
   if (++(c->usageCount) == 1)
   {
     /* First-time call: init default values */
@@ -223,9 +235,13 @@ void lock_config_structure(BINKD_CONFIG *c)
     c->minfree_nonsecure = -1;
     c->loglevel          = 4;
     c->conlog            = 1;
+    for (i = 0; i < LOGC_MAX; i++)
+      c->logcat[i]       = -1;
     c->inboundcase       = INB_SAVE;
     c->renamestyle       = RENAME_POSTFIX;
     c->hold_skipped      = 60 * 60;
+    c->dns_cache_ttl     = 5 * 60;
+    c->dns_negative_ttl  = 60;
     c->tzoff             = -1; /* autodetect */
 
     strcpy(c->inbound, ".");
@@ -249,6 +265,18 @@ void unlock_config_structure(BINKD_CONFIG *c, int on_exit)
   {
     /* Free all dynamic data here */
 
+    if (c->base)
+    { /* only nodes and config_list are our own */
+      BINKD_CONFIG *base = c->base;
+
+      free_nodes(c);
+      simplelist_free(&c->config_list.linkpoint, destroy_configlist);
+      if (c != &work_config && !binkd_exit)
+        free(c);
+      unlock_config_structure(base, on_exit);
+      return;
+    }
+
     if (c != &work_config && !binkd_exit)
       Log(4, "previous config is no longer in use, unloading");
 
@@ -282,6 +310,14 @@ void unlock_config_structure(BINKD_CONFIG *c, int on_exit)
     simplelist_free(&c->perl_vars.linkpoint,   destroy_perlvars);
 #endif
 
+    maskset_free(c->overwrite_set);
+    maskset_free(c->nolog_set);
+    maskset_free(c->skipmask_set);
+    maskset_free(c->evt_set);
+#if defined(WITH_ZLIB) || defined(WITH_BZLIB2)
+    maskset_free(c->zrules_set);
+#endif
+
 /*
 #ifdef HTTPS
     simplelist_free(&c->proxylist,   destroy_proxy);
@@ -365,6 +401,7 @@ static int read_shares (KEYWORD *key, int wordcount, char **words);
 #if defined (HAVE_VSYSLOG) && defined (HAVE_FACILITYNAMES)
 static int read_syslog_facility (KEYWORD *key, int wordcount, char **words);
 #endif
+static int read_logcat (KEYWORD *key, int wordcount, char **words);
 
 #define DONT_CHECK 0x7fffffffl
 
@@ -375,9 +412,13 @@ static KEYWORD keywords[] =
   {"log", read_log_string, work_config.logpath, 'f', 0},
   {"loglevel", read_log_int, &work_config.loglevel, 0, DONT_CHECK},
   {"conlog", read_log_int, &work_config.conlog, 0, DONT_CHECK},
+  {"log-category", read_logcat, work_config.logcat, 0, 0},
   {"binlog", read_string, work_config.binlogpath, 'f', 0},
   {"fdinhist", read_string, work_config.fdinhist, 'f', 0},
   {"fdouthist", read_string, work_config.fdouthist, 'f', 0},
+  {"history", read_string, work_config.history, 'f', 0},
+  {"binlog-flush", read_time, &work_config.binlog_flush, 0, 3600},
+  {"binlog-fsync", read_bool, &work_config.binlog_fsync, 0, 0},
   {"tzoff", read_time, &work_config.tzoff, -12*60*60, 12*60*60},
   {"domain", read_domain_info, NULL, 0, 0},
   {"address", read_aka_list, NULL, 0, 0},
@@ -395,6 +436,14 @@ static KEYWORD keywords[] =
   {"oblksize", read_int, &work_config.oblksize, MIN_BLKSIZE, MAX_BLKSIZE},
   {"maxservers", read_int, &work_config.max_servers, 0, DONT_CHECK},
   {"maxclients", read_int, &work_config.max_clients, 0, DONT_CHECK},
+  {"reserve-servers", read_int, &work_config.reserve_servers, 0, DONT_CHECK},
+  {"accept-rate", read_int, &work_config.accept_rate, 0, DONT_CHECK},
+  {"accept-net-rate", read_int, &work_config.accept_net_rate, 0, DONT_CHECK},
+#ifdef HAVE_THREADS
+  {"scan-threads", read_int, &work_config.scan_threads, 0, 64},
+  {"listen-shards", read_int, &work_config.listen_shards, 0, 8},
+#endif
+  {"listen-backlog", read_int, &work_config.listen_backlog, 0, 65535},
   {"inbound", read_string, work_config.inbound, 'd', 0},
   {"inbound-nonsecure", read_string, work_config.inbound_nonsecure, 'd', 0},
   {"temp-inbound", read_string, work_config.temp_inbound, 'd', 0},
@@ -406,12 +455,16 @@ static KEYWORD keywords[] =
   {"percents", read_bool, &work_config.percents, 0, 0},
   {"minfree", read_int, &work_config.minfree, 0, DONT_CHECK},
   {"minfree-nonsecure", read_int, &work_config.minfree_nonsecure, 0, DONT_CHECK},
+  {"preallocate", read_int, &work_config.preallocate, 0, DONT_CHECK},
   {"flag", read_flag_exec_info, NULL, 'f', 0},
   {"exec", read_flag_exec_info, NULL, 'e', 0},
   {"printq", read_bool, &work_config.printq, 0, 0},
   {"try", read_int, &work_config.tries, 0, 0xffff},
   {"hold", read_time, &work_config.hold, 0, DONT_CHECK},
   {"hold-skipped", read_time, &work_config.hold_skipped, 0, DONT_CHECK},
+  {"hold-max", read_time, &work_config.hold_max, 0, DONT_CHECK},
+  {"call-journal", read_string, work_config.call_journal, 'f', 0},
+  {"linger", read_time, &work_config.linger, 0, DONT_CHECK},
   {"backresolv", read_bool, &work_config.backresolv, 0, 0},
   {"pid-file", read_string, work_config.pid_file, 'f', 0},
 #ifdef HTTPS
@@ -426,6 +479,8 @@ static KEYWORD keywords[] =
   {"root-domain", read_string, work_config.root_domain, 0, BINKD_FQDNLEN},
   {"prescan", read_bool, &work_config.prescan, 0, 0},
   {"connect-timeout", read_time, &work_config.connect_timeout, 0, DONT_CHECK},
+  {"dns-cache-ttl", read_time, &work_config.dns_cache_ttl, 0, DONT_CHECK},
+  {"dns-negative-ttl", read_time, &work_config.dns_negative_ttl, 0, DONT_CHECK},
 #ifdef MAILBOX
   {"filebox", read_string, work_config.tfilebox, 'd', 0},
   {"brakebox", read_string, work_config.bfilebox, 'd', 0},
@@ -555,6 +610,67 @@ static int isDefined(char *value, char *name)
   return 1;
 }
 
+/*
+ * Compiled config image (-k). It keeps the keyword stream of all config
+ * files after include and %VAR% processing, and the passwords file already
+ * parsed to addresses. Replaying it calls the same keyword callbacks as
+ * readcfg0(), but without reading and tokenizing the text files.
+ * The image is bound to the binary which wrote it.
+ */
+#define MAX_WORDS_ON_LINE 64
+
+#define IMG_MAGIC  "binkdimg"
+#define IMG_FILE   -1     /* config file: mtime, path */
+#define IMG_PATH   -2     /* back to the including file: path */
+#define IMG_PASSWD -3     /* passwords file entry: address, password */
+
+struct img_hdr
+{
+  char   magic[8];
+  char   version[32];
+  long   cfgsize, addrsize;
+  int    nkeywords;
+  long   size;            /* of the records after the header */
+};
+
+struct img_rec
+{
+  int    type;            /* IMG_* or keyword index */
+  int    line;
+  int    argc;            /* strings after the data */
+};
+
+static char  *img_buf;    /* records being written, NULL if not compiling */
+static size_t img_len, img_size;
+
+static void img_put(const void *p, size_t n)
+{
+  if (img_len + n > img_size)
+  {
+    img_size = (img_len + n) * 2;
+    img_buf = xrealloc(img_buf, img_size);
+  }
+  memcpy(img_buf + img_len, p, n);
+  img_len += n;
+}
+
+static void img_record(int type, int line, int argc, char **argv, void *data, size_t n)
+{
+  struct img_rec r;
+  int i;
+
+  if (!img_buf)
+    return;
+  r.type = type;
+  r.line = line;
+  r.argc = argc;
+  img_put(&r, sizeof(r));
+  if (n)
+    img_put(data, n);
+  for (i = 0; i < argc; i++)
+    img_put(argv[i], strlen(argv[i]) + 1);
+}
+
 static void add_to_config_list(const char *path, FILE *f)
 {
   struct  conflist_type new_entry;
@@ -569,6 +685,7 @@ static void add_to_config_list(const char *path, FILE *f)
     new_entry.mtime = 0;
   }
   simplelist_add(&work_config.config_list.linkpoint, &new_entry, sizeof(new_entry));
+  img_record(IMG_FILE, 0, 1, &new_entry.path, &new_entry.mtime, sizeof(new_entry.mtime));
 }
 
 static int check_boxes(FTN_NODE *node, void *arg)
@@ -637,44 +754,111 @@ static void split_passwords(char *password, char **pkt_pwd, char **out_pwd)
   }
 }
 
+/*
+ * Passwords file entries are collected and applied to the nodes at once
+ */
+static FTN_PWD *pwd_list;
+static int      pwd_count, pwd_alloc;
+static int      pwd_loaded;             /* entries, for -d */
+static long     pwd_usec;               /* load time, for -d */
+
+static void pwd_collect(FTN_ADDR *fa, char *password)
+{
+  FTN_PWD *e;
+
+  if (pwd_count == pwd_alloc)
+  {
+    pwd_alloc = pwd_alloc ? pwd_alloc * 2 : 256;
+    pwd_list = xrealloc(pwd_list, pwd_alloc * sizeof(FTN_PWD));
+  }
+  e = pwd_list + pwd_count++;
+  memcpy(&e->fa, fa, sizeof(FTN_ADDR));
+  e->pwd = password;
+  split_passwords(password, &e->pkt_pwd, &e->out_pwd);
+}
+
+static void pwd_apply(struct timeval *start)
+{
+  struct timeval tv;
+
+  add_pwd_nodes(pwd_list, pwd_count, &work_config);
+  pwd_loaded = pwd_count;
+  xfree(pwd_list);
+  pwd_list = NULL;
+  pwd_count = pwd_alloc = 0;
+  gettvtime(&tv);
+  pwd_usec = (tv.tv_sec - start->tv_sec) * 1000000L + (tv.tv_usec - start->tv_usec);
+}
+
+/* strtok(p, spaces) for one line without the static state */
+static char *pwd_token(char **p)
+{
+  char *s = *p + strspn(*p, spaces);
+
+  if (*s == '\0')
+    return NULL;
+  *p = s + strcspn(s, spaces);
+  if (**p)
+    *(*p)++ = '\0';
+  return s;
+}
+
+/*
+ * Reads the whole passwords file at once and parses it in place
+ */
 static int read_passwords(char *filename)
 {
   FILE *in;
   FTN_ADDR fa;
+  struct stat st;
+  struct timeval start;
+  char *buf, *line, *next;
+  size_t len;
 
+  gettvtime(&start);
   if ((in = fopen(filename, "rt")) == NULL)
     return ConfigError("unable to open password file (%s)", filename);
 
   add_to_config_list(filename, in);
-  while (fgets (linebuf, sizeof (linebuf), in))
+  if (fstat(fileno(in), &st) == 0 && st.st_size > 0)
+  {
+    buf = xalloc((size_t)st.st_size + 1);
+    len = fread(buf, 1, (size_t)st.st_size, in);
+  }
+  else
+  {
+    buf = xalloc(1);
+    len = 0;
+  }
+  fclose(in);
+  buf[len] = '\0';
+
+  for (line = buf; *line; line = next)
   {
     char *node, *password;
 
-    node = strtok(linebuf, spaces);
+    if ((next = strchr(line, '\n')) != NULL)
+      *next++ = '\0';
+    else
+      next = line + strlen(line);
+
+    node = pwd_token(&line);
     if(node && STRICMP(node,"password")==0 )
-      node = strtok(NULL, spaces); /* ifcico/qico passwords file detected */
+      node = pwd_token(&line); /* ifcico/qico passwords file detected */
 
     if (node)
     {
-      password = strtok(NULL, spaces);
+      password = pwd_token(&line);
       if (password && parse_ftnaddress (node, &fa, work_config.pDomains.first)) /* Do not process if any garbage found */
       {
-        FTN_NODE *pn;
-        char *pkt_pwd, *out_pwd;
-        split_passwords(password, &pkt_pwd, &out_pwd);
         exp_ftnaddress (&fa, work_config.pAddr, work_config.nAddr, work_config.pDomains.first);
-        pn = add_node (&fa, NULL, password, pkt_pwd, out_pwd, '-', NULL, NULL,
-                  NR_USE_OLD, ND_USE_OLD, MD_USE_OLD, RIP_USE_OLD, 
-		  HC_USE_OLD, NP_USE_OLD, NULL, AF_USE_OLD,
-#ifdef BW_LIM
-                  BW_DEF, BW_DEF,
-#endif
-                  &work_config);
-        if (pn && !pn->listed) pn->listed = NL_PASSWORDS;
+        img_record(IMG_PASSWD, 0, 1, &password, &fa, sizeof(fa));
+        pwd_collect(&fa, password);
       }
     }
   }
-  fclose(in);
+  pwd_apply(&start);
+  free(buf);
 
   return 1;
 }
@@ -684,8 +868,6 @@ static int read_passwords(char *filename)
  */
 static int readcfg0 (char *path)
 {
-#define MAX_WORDS_ON_LINE 64
-
   FILE   *in;
   char   *words[MAX_WORDS_ON_LINE];
   int     success;
@@ -721,7 +903,11 @@ static int readcfg0 (char *path)
         if (!STRICMP (k->key, words[0]))
           break;
       if (k->key)
+      {
+        if (k->callback != include)
+          img_record((int)(k - keywords), current_line, wordcount-1, words+1, NULL, 0);
         success = k->callback(k, wordcount-1, words+1);
+      }
       else
         success = ConfigError("%s: unknown keyword", words[0]);
     }
@@ -733,18 +919,272 @@ static int readcfg0 (char *path)
   return success;
 }
 
+static char *img_name(char *path)
+{
+  char *s = xalloc(strlen(path) + 5);
+
+  strcpy(s, path);
+  strcat(s, ".img");
+  return s;
+}
+
+/* Parses one image record, returns the next one or NULL if it is broken */
+static char *img_next(char *p, char *end, struct img_rec *r, char **data, char **argv)
+{
+  size_t n;
+  int i;
+
+  if ((size_t)(end - p) < sizeof(*r))
+    return NULL;
+  memcpy(r, p, sizeof(*r));
+  p += sizeof(*r);
+  if (r->type == IMG_FILE)
+    n = sizeof(time_t);
+  else if (r->type == IMG_PASSWD)
+    n = sizeof(FTN_ADDR);
+  else
+    n = 0;
+  if (r->type < IMG_PASSWD || r->type >= (int)(sizeof(keywords) / sizeof(*keywords)) - 1 ||
+      r->argc < 0 || r->argc >= MAX_WORDS_ON_LINE || (r->type < 0 && r->argc != 1) ||
+      (size_t)(end - p) < n)
+    return NULL;
+  *data = p;
+  p += n;
+  for (i = 0; i < r->argc; i++)
+  {
+    char *z = memchr(p, 0, end - p);
+
+    if (z == NULL)
+      return NULL;
+    argv[i] = p;
+    p = z + 1;
+  }
+  return p;
+}
+
+static void img_close(char *img, size_t size)
+{
+  if (img == NULL)
+    return;
+#ifdef HAVE_MMAP
+  munmap(img, size);
+#else
+  UNUSED_ARG(size);
+  free(img);
+#endif
+}
+
+/*
+ * Loads the image of config path. Returns NULL if there is no usable
+ * image: it is broken, was written by another binkd build, or one of
+ * the config files is changed or not older than the image.
+ */
+static char *img_open(char *path, size_t *psize)
+{
+  struct img_hdr h;
+  struct img_rec r;
+  struct stat st, sf;
+  char *imgpath, *img, *p, *end, *data, *argv[MAX_WORDS_ON_LINE];
+  char *why = NULL;
+  time_t mtime;
+  int fd;
+
+  imgpath = img_name(path);
+  if ((fd = open(imgpath, O_RDONLY | O_BINARY)) == -1)
+  {
+    if (cfgimg_flag)
+      Log(0, "cannot open %s: %s", imgpath, strerror(errno));
+    free(imgpath);
+    return NULL;
+  }
+  img = NULL;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(h))
+  {
+    *psize = (size_t)st.st_size;
+#ifdef HAVE_MMAP
+    /* private writable mapping: keyword callbacks may modify their words */
+    img = mmap(NULL, *psize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (img == MAP_FAILED)
+      img = NULL;
+#else
+    img = xalloc(*psize);
+    if (read(fd, img, *psize) != (int)*psize)
+    {
+      free(img);
+      img = NULL;
+    }
+#endif
+  }
+  close(fd);
+
+  if (img == NULL)
+    why = "cannot read it";
+  else
+  {
+    memcpy(&h, img, sizeof(h));
+    if (memcmp(h.magic, IMG_MAGIC, sizeof(h.magic)) ||
+        h.size != (long)(*psize - sizeof(h)))
+      why = "bad format";
+    else if (strncmp(h.version, MYVER, sizeof(h.version)) ||
+        h.cfgsize != (long)sizeof(BINKD_CONFIG) ||
+        h.addrsize != (long)sizeof(FTN_ADDR) ||
+        h.nkeywords != (int)(sizeof(keywords) / sizeof(*keywords)) - 1)
+      why = "written by another binkd build";
+  }
+  if (why == NULL)
+    for (p = img + sizeof(h), end = img + *psize; why == NULL && p < end; )
+    {
+      if ((p = img_next(p, end, &r, &data, argv)) == NULL)
+        why = "bad format";
+      else if (r.type == IMG_FILE)
+      {
+        memcpy(&mtime, data, sizeof(mtime));
+        if (stat(argv[0], &sf) || sf.st_mtime != mtime || sf.st_mtime >= st.st_mtime)
+          why = "config files changed";
+      }
+    }
+
+  if (why)
+  {
+    Log(cfgimg_flag ? 0 : 2, "config image %s is not used: %s", imgpath, why);
+    img_close(img, *psize);
+    img = NULL;
+  }
+  else
+    Log(5, "using config image %s", imgpath);
+  free(imgpath);
+  return img;
+}
+
+/*
+ * Replays the keywords of an image, the same as readcfg0(). Stops at the
+ * passwords file entries, which are always the last ones, and stores
+ * their position to *pw: the callbacks may modify their words, so the
+ * records before *pw cannot be parsed again.
+ */
+static int img_replay(char *img, size_t size, char **pw)
+{
+  struct img_rec r;
+  struct conflist_type *pc;
+  char *p, *end, *data, *argv[MAX_WORDS_ON_LINE];
+  int success = 1;
+
+  end = img + size;
+  for (p = img + sizeof(struct img_hdr); success && p < end; )
+  {
+    *pw = p;
+    p = img_next(p, end, &r, &data, argv);
+    if (r.type == IMG_PASSWD)
+      return success;
+    if (r.type == IMG_FILE || r.type == IMG_PATH)
+    {
+      if (r.type == IMG_FILE)
+      {
+        struct conflist_type new_entry;
+
+        new_entry.path = xstrdup(argv[0]);
+        memcpy(&new_entry.mtime, data, sizeof(new_entry.mtime));
+        simplelist_add(&work_config.config_list.linkpoint, &new_entry, sizeof(new_entry));
+      }
+      for (pc = work_config.config_list.first; pc; pc = pc->next)
+        if (!strcmp(pc->path, argv[0]))
+          current_path = pc->path;
+      current_line = 0;
+    }
+    else if (r.type >= 0)
+    {
+      current_line = r.line;
+      success = keywords[r.type].callback(keywords + r.type, r.argc, argv);
+    }
+  }
+  *pw = end;
+  return success;
+}
+
+/* Replays the passwords file entries of an image starting from pw */
+static int img_passwords(char *pw, char *img, size_t size)
+{
+  struct img_rec r;
+  struct timeval start;
+  FTN_ADDR fa;
+  char *p, *end, *data, *argv[MAX_WORDS_ON_LINE];
+
+  gettvtime(&start);
+  for (p = pw, end = img + size; p < end; )
+  {
+    p = img_next(p, end, &r, &data, argv);
+    if (r.type == IMG_PASSWD)
+    {
+      memcpy(&fa, data, sizeof(fa));
+      pwd_collect(&fa, argv[0]);
+    }
+  }
+  pwd_apply(&start);
+  return 1;
+}
+
+static int img_write(char *path)
+{
+  struct img_hdr h;
+  char *imgpath, *tmppath;
+  FILE *f;
+  int ok;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, IMG_MAGIC, sizeof(h.magic));
+  strnzcpy(h.version, MYVER, sizeof(h.version));
+  h.cfgsize = sizeof(BINKD_CONFIG);
+  h.addrsize = sizeof(FTN_ADDR);
+  h.nkeywords = (int)(sizeof(keywords) / sizeof(*keywords)) - 1;
+  h.size = (long)img_len;
+
+  imgpath = img_name(path);
+  tmppath = img_name(imgpath);
+  ok = (f = fopen(tmppath, "wb")) != NULL &&
+       fwrite(&h, sizeof(h), 1, f) == 1 &&
+       (img_len == 0 || fwrite(img_buf, img_len, 1, f) == 1);
+  if (f && fclose(f))
+    ok = 0;
+  if (ok && rename(tmppath, imgpath))
+  { /* the target exists and rename() does not replace it */
+    delete(imgpath);
+    ok = rename(tmppath, imgpath) == 0;
+  }
+  if (ok)
+    Log(3, "config image %s written, %lu bytes", imgpath, (unsigned long)(sizeof(h) + img_len));
+  else
+  {
+    Log(1, "cannot write %s: %s", imgpath, strerror(errno));
+    delete(tmppath);
+  }
+  free(tmppath);
+  free(imgpath);
+  return ok;
+}
+
 /*
  * Parses and reads _path as config.file
  */
 BINKD_CONFIG *readcfg (char *path)
 {
   BINKD_CONFIG *new_config = NULL;
+  char   *img = NULL, *img_pw = NULL;
+  size_t  img_mapsize = 0;
 
   memset(&work_config, 0, sizeof(work_config));
   lock_config_structure(&work_config);
 
+  if (cfgimg_flag == 1)
+  { /* compile the image (-k) */
+    img_size = 4096;
+    img_len = 0;
+    img_buf = xalloc(img_size);
+  }
+  else
+    img = img_open(path, &img_mapsize);
+
   if (
-      readcfg0(path)                               &&
+      (img ? img_replay(img, img_mapsize, &img_pw) : readcfg0(path)) &&
       isDefined(work_config.sysname,  "sysname")   &&
       isDefined(work_config.sysop,    "sysop")     &&
       isDefined(work_config.location, "location")  &&
@@ -809,12 +1249,14 @@ BINKD_CONFIG *readcfg (char *path)
         strcpy (work_config.inbound_nonsecure, work_config.inbound);
 
       if (work_config.passwords[0])
-        if (!read_passwords(work_config.passwords))
+        if (!(img ? img_passwords(img_pw, img, img_mapsize) : read_passwords(work_config.passwords)))
           break;
 
       if (!check_config())
         break;
 
+      compile_masks(&work_config);
+
       /* All checks passed! */
 
       new_config = xalloc(sizeof(work_config));
@@ -823,6 +1265,15 @@ BINKD_CONFIG *readcfg (char *path)
     } while (0);
   }
 
+  img_close(img, img_mapsize);
+  if (img_buf)
+  {
+    if (new_config && !img_write(path))
+      Log(0, "config image is not written");
+    free(img_buf);
+    img_buf = NULL;
+  }
+
   if (!new_config)
   {
     /* Config error. Abort or continue? */
@@ -836,6 +1287,123 @@ BINKD_CONFIG *readcfg (char *path)
   return new_config;
 }
 
+/*
+ * Re-reads the passwords file only. The new config has its own nodes
+ * and config_list and shares everything else with the old one.
+ */
+static BINKD_CONFIG *reload_passwords (BINKD_CONFIG *old)
+{
+  BINKD_CONFIG *new_config = NULL, *base = old->base ? old->base : old;
+  struct conflist_type *pc, new_entry;
+
+  memcpy(&work_config, old, sizeof(work_config));
+  work_config.usageCount = 1;
+  work_config.base       = base;
+  work_config.nNod       = work_config.nNodAlloc = work_config.nNodHash = 0;
+  work_config.nNodSorted = 0;
+  work_config.pNodArray  = work_config.pNodHash = NULL;
+  work_config.pNodSnap   = NULL;
+  work_config.q_present  = 0;
+  memset(&work_config.config_list, 0, sizeof(work_config.config_list));
+  for (pc = old->config_list.first; pc; pc = pc->next)
+    if (strcmp(pc->path, old->passwords))
+    {
+      new_entry.path  = xstrdup(pc->path);
+      new_entry.mtime = pc->mtime;
+      simplelist_add(&work_config.config_list.linkpoint, &new_entry, sizeof(new_entry));
+    }
+
+  copy_listed_nodes(&work_config, old);
+  if (read_passwords(work_config.passwords))
+  {
+    LockSem(&config_sem);
+    lock_config_structure(base);
+    ReleaseSem(&config_sem);
+    new_config = xalloc(sizeof(work_config));
+    memcpy(new_config, &work_config, sizeof(work_config));
+  }
+  else
+  {
+    Log(1, "error in passwords file, using old config");
+    free_nodes(&work_config);
+    simplelist_free(&work_config.config_list.linkpoint, destroy_configlist);
+  }
+  return new_config;
+}
+
+#ifdef HAVE_INOTIFY_INIT1
+/*
+ * Watches the directories of config files, so the files are only
+ * stat()'ed after something has changed there
+ */
+static int inotify_fd = -1;
+static BINKD_CONFIG *inotify_config;
+
+/* Watches the directory of path, returns -1 on error */
+static int watch_dir (char *path)
+{
+  char dir[MAXPATHLEN + 1], *p;
+
+  strnzcpy(dir, path, sizeof(dir));
+  if ((p = strrchr(dir, '/')) == NULL)
+    strcpy(dir, ".");
+  else if (p == dir)
+    dir[1] = '\0';
+  else
+    *p = '\0';
+  if (inotify_add_watch(inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO |
+                        IN_CREATE | IN_DELETE | IN_ATTRIB) < 0)
+  {
+    Log(2, "inotify_add_watch(%s): %s", dir, strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+static int config_touched (BINKD_CONFIG *config)
+{
+  char buf[4096], *real;
+  struct conflist_type *pc;
+  int n, rc, touched = 0;
+
+  if (inotify_config == config)
+  {
+    if (inotify_fd < 0)
+      return 1;
+    while ((n = read(inotify_fd, buf, sizeof(buf))) > 0)
+      touched = 1;
+    return touched;
+  }
+  /* new config: set up watches for its files */
+  if (inotify_fd >= 0)
+    close(inotify_fd);
+  inotify_config = config;
+  if ((inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+  {
+    Log(2, "inotify_init1: %s", strerror(errno));
+    return 1;
+  }
+  for (pc = config->config_list.first; pc; pc = pc->next)
+  {
+    rc = watch_dir(pc->path);
+    /* a symlinked file is changed where it really lives */
+    if (rc == 0 && (real = realpath(pc->path, NULL)) != NULL)
+    {
+      if (strcmp(real, pc->path))
+        rc = watch_dir(real);
+      free(real);
+    }
+    if (rc < 0)
+    {
+      close(inotify_fd);
+      inotify_fd = -1;
+      break;
+    }
+  }
+  return 1;
+}
+#endif
+
 /*
  * Check for change in configuration files
  * !!! Must be called from "main" thread only !!!
@@ -845,7 +1413,7 @@ int checkcfg(void)
 {
   struct stat sb;
   struct conflist_type *pc;
-  int need_reload;
+  int need_reload, pwd_changed = 0;
   BINKD_CONFIG *new_config, *old_config;
 
 #ifdef HAVE_FORK
@@ -858,6 +1426,10 @@ int checkcfg(void)
 #endif
   if (!checkcfg_flag && !need_reload)
     return 0;
+#ifdef HAVE_INOTIFY_INIT1
+  if (!config_touched(current_config) && !need_reload)
+    return 0;
+#endif
 
   for (pc = current_config->config_list.first; pc; pc = pc->next)
   {
@@ -871,23 +1443,37 @@ int checkcfg(void)
       pc->mtime = sb.st_mtime;
 
       Log(2, "%s changed!", pc->path);
-      need_reload = 1;
+      if (strcmp(pc->path, current_config->passwords) == 0)
+        pwd_changed = 1;
+      else
+        need_reload = 1;
     }
   }
 
 #ifdef WITH_PERL
+  if (pwd_changed && current_config->perl_script[0])
+    need_reload = 1;
   switch (perl_need_reload(current_config, current_config->config_list.first, need_reload))
   { case 1: need_reload = 1; break;
-    case 2: need_reload = 0; break;
+    case 2: need_reload = pwd_changed = 0; break;
   }
 #endif
 
-  if (!need_reload)
+  if (!need_reload && !pwd_changed)
     return 0;
-  /* Reload starting from first file in list */
-  Log(2, "Reloading configuration...");
-  pc = current_config->config_list.first;
-  new_config = readcfg(pc->path);
+  if (!need_reload)
+  {
+    /* Only nodes from the passwords file have to be rebuilt */
+    Log(2, "Reloading passwords...");
+    new_config = reload_passwords(current_config);
+  }
+  else
+  {
+    /* Reload starting from first file in list */
+    Log(2, "Reloading configuration...");
+    pc = current_config->config_list.first;
+    new_config = readcfg(pc->path);
+  }
 
 #ifdef WITH_PERL
 #if defined(HAVE_THREADS) || defined(PERL_MULTIPLICITY)
@@ -919,7 +1505,7 @@ int checkcfg(void)
   if (new_config)
   {
     InitLog(new_config->loglevel, new_config->conlog,
-            new_config->logpath, new_config->nolog.first);
+            new_config->logpath, new_config->nolog_set, new_config->logcat);
 
 #ifdef WITH_PERL
     /* before change current_config,
@@ -932,6 +1518,9 @@ int checkcfg(void)
     old_config = current_config;
     current_config = new_config;
     ReleaseSem(&config_sem);
+#ifdef HAVE_INOTIFY_INIT1
+    inotify_config = NULL;
+#endif
 
     if (old_config)
       unlock_config_structure(old_config, 0);
@@ -1001,6 +1590,7 @@ static int include (KEYWORD *key, int wordcount, char **words)
   success  = readcfg0(words[0]);
   current_path = old_path;
   current_line = old_line;
+  img_record(IMG_PATH, 0, 1, &current_path, NULL, 0);
   --level;
 
   return success;
@@ -1382,7 +1972,7 @@ static void log_bootstrap(void)
      * will config (and their memory) be accepted or free'd.
      * We can duplicate them in InitLog() but it'll be overkill.
      */
-    InitLog(work_config.loglevel, work_config.conlog, work_config.logpath, NULL);
+    InitLog(work_config.loglevel, work_config.conlog, work_config.logpath, NULL, work_config.logcat);
   }
 }
 
@@ -1517,6 +2107,28 @@ static int read_renamestyle (KEYWORD *key, int wordcount, char **words)
 }
 
 
+static int read_logcat (KEYWORD *key, int wordcount, char **words)
+{
+  int *target = (int *) (key->var);
+  char *s;
+  int i;
+
+  if (!isArgCount(2, wordcount))
+    return 0;
+
+  for (i = 0; i < LOGC_MAX; i++)
+    if (!STRICMP (log_categories[i], words[0]))
+      break;
+  if (i == LOGC_MAX)
+    return ConfigError("%s: unknown log category", words[0]);
+  for (s = words[1]; *s; s++)
+    if (!isdigit(*s))
+      return ConfigNeedNumber(words[1]);
+  target[i] = atoi (words[1]);
+  log_bootstrap();
+  return 1;
+}
+
 #if defined (HAVE_VSYSLOG) && defined (HAVE_FACILITYNAMES)
 static int read_syslog_facility (KEYWORD *key, int wordcount, char **words)
 {
@@ -1552,14 +2164,228 @@ static int read_rfrule (KEYWORD *key, int wordcount, char **words)
   return 1;
 }
 
-char *mask_test(char *s, struct maskchain *chain)
+/*
+ * Mask sets. Every mask is split into tokens as pmatch() does; its
+ * literal head and tail and the number of chars it matches are used to
+ * reject most strings without calling pmatch(). Masks are bucketed by
+ * their last literal char, so only masks ending with this char of the
+ * string or with a wildcard are tried.
+ */
+#define MS_ANY 256                    /* bucket of masks ending with a wildcard */
+
+typedef struct {
+    char *mask;
+    void *item;                       /* list element */
+    char *head, *tail;                /* literal head and tail, upper case */
+    int   nhead, ntail;
+    int   minlen;                     /* chars matched except by '*' */
+    int   star;                       /* has '*' */
+    int   literal;                    /* no wildcards at all */
+  } MASKENT;
+
+struct _MASKSET
+{
+  int      n;
+  MASKENT *ent;
+  int     *bucket[MS_ANY + 1];        /* mask numbers, -1 terminated */
+};
+
+static int ms_none[1] = { -1 };
+
+/*
+ * Returns the length of the token at p. *c is set to its literal char
+ * (upper case), -1 for '?', '[...]' or an escaped char, -2 for '*'
+ */
+static int mask_token (char *p, int *c)
+{
+  char *endp;
+
+  switch (*p)
+  {
+    case '\\':
+      *c = -1;
+      return p[1] ? 2 : 1;
+    case '?':
+      *c = -1;
+      return 1;
+    case '*':
+      *c = -2;
+      return 1;
+    case '[':
+      endp = p + 1;
+      if (*endp == '!')
+        endp++;
+      for (;;)
+      {
+        if (*endp == '\0' || (*endp == '\\' && endp[1] == '\0'))
+        { /* no matching ], '[' is a plain char */
+          *c = toupper ((unsigned char) *p);
+          return 1;
+        }
+        if (*endp == '\\')
+          endp++;
+        if (*++endp == ']')
+          break;
+      }
+      *c = -1;
+      return endp - p + 1;
+  }
+  *c = toupper ((unsigned char) *p);
+  return 1;
+}
+
+static void maskent_init (MASKENT *e, char *mask, void *item)
+{
+  char *p;
+  int c, len, inhead = 1;
+
+  e->mask = mask;
+  e->item = item;
+  len = strlen (mask);
+  e->head = xalloc (len + 1);
+  e->tail = xalloc (len + 1);
+  e->nhead = e->ntail = e->minlen = e->star = 0;
+  e->literal = 1;
+  for (p = mask; *p; p += len)
+  {
+    len = mask_token (p, &c);
+    if (c >= 0)
+    {
+      if (inhead)
+        e->head[e->nhead++] = (char) c;
+      e->tail[e->ntail++] = (char) c;
+    }
+    else
+    {
+      inhead = e->literal = e->ntail = 0;
+      if (c == -2)
+        e->star = 1;
+    }
+    if (c != -2)
+      e->minlen++;
+  }
+}
+
+static int upcmp (char *up, char *s, int n)
 {
-  struct maskchain *ps;
+  while (n-- > 0)
+    if (*up++ != toupper ((unsigned char) *s++))
+      return 0;
+  return 1;
+}
 
-  for (ps = chain; ps; ps = ps->next)
-    if (pmatch_ncase(ps->mask, s))
-      return ps->mask;
-  return NULL;
+static int maskent_match (MASKENT *e, char *s, int n)
+{
+  if (n < e->minlen || (!e->star && n != e->minlen))
+    return 0;
+  if (!upcmp (e->head, s, e->nhead) || !upcmp (e->tail, s + n - e->ntail, e->ntail))
+    return 0;
+  return e->literal || pmatch_ncase (e->mask, s);
+}
+
+/*
+ * Compiles a list, each element of it starts with the next pointer and
+ * has the mask at offset off
+ */
+static MASKSET *maskset_compile (void *first, size_t off)
+{
+  MASKSET *ms;
+  void *p;
+  int i, c, n[MS_ANY + 1];
+
+  for (i = 0, p = first; p; p = *(void **) p)
+    i++;
+  if (i == 0)
+    return NULL;
+  ms = xalloc (sizeof (MASKSET));
+  ms->n = i;
+  ms->ent = xalloc (i * sizeof (MASKENT));
+  memset (n, 0, sizeof (n));
+  for (i = 0, p = first; p; p = *(void **) p, i++)
+  {
+    maskent_init (ms->ent + i, *(char **) ((char *) p + off), p);
+    n[ms->ent[i].ntail ? (unsigned char) ms->ent[i].tail[ms->ent[i].ntail - 1] : MS_ANY]++;
+  }
+  for (c = 0; c <= MS_ANY; c++)
+  {
+    ms->bucket[c] = n[c] ? xalloc ((n[c] + 1) * sizeof (int)) : ms_none;
+    n[c] = 0;
+  }
+  for (i = 0; i < ms->n; i++)
+  {
+    c = ms->ent[i].ntail ? (unsigned char) ms->ent[i].tail[ms->ent[i].ntail - 1] : MS_ANY;
+    ms->bucket[c][n[c]++] = i;
+  }
+  for (c = 0; c <= MS_ANY; c++)
+    if (n[c])
+      ms->bucket[c][n[c]] = -1;
+  return ms;
+}
+
+static void maskset_free (MASKSET *ms)
+{
+  int i;
+
+  if (ms == NULL)
+    return;
+  for (i = 0; i < ms->n; i++)
+  {
+    free (ms->ent[i].head);
+    free (ms->ent[i].tail);
+  }
+  for (i = 0; i <= MS_ANY; i++)
+    if (ms->bucket[i] != ms_none)
+      free (ms->bucket[i]);
+  free (ms->ent);
+  free (ms);
+}
+
+int maskset_next (MASKSET *ms, char *s, int from)
+{
+  int *a, *b, n;
+
+  if (ms == NULL)
+    return -1;
+  n = strlen (s);
+  a = ms->bucket[MS_ANY];
+  b = n ? ms->bucket[toupper ((unsigned char) s[n - 1])] : ms_none;
+  while (*a >= 0 && *a < from)
+    a++;
+  while (*b >= 0 && *b < from)
+    b++;
+  /* merge both buckets in mask order */
+  while (*a >= 0 || *b >= 0)
+  {
+    if (*b < 0 || (*a >= 0 && *a < *b))
+    {
+      if (maskent_match (ms->ent + *a, s, n))
+        return *a;
+      a++;
+    }
+    else
+    {
+      if (maskent_match (ms->ent + *b, s, n))
+        return *b;
+      b++;
+    }
+  }
+  return -1;
+}
+
+void *maskset_item (MASKSET *ms, int i)
+{
+  return ms->ent[i].item;
+}
+
+static void compile_masks (BINKD_CONFIG *c)
+{
+  c->overwrite_set = maskset_compile (c->overwrite.first, offsetof (struct maskchain, mask));
+  c->nolog_set     = maskset_compile (c->nolog.first, offsetof (struct maskchain, mask));
+  c->skipmask_set  = maskset_compile (c->skipmask.first, offsetof (struct skipchain, mask));
+  c->evt_set       = maskset_compile (c->evt_flags.first, offsetof (EVT_FLAG, pattern));
+#if defined(WITH_ZLIB) || defined(WITH_BZLIB2)
+  c->zrules_set    = maskset_compile (c->zrules.first, offsetof (struct zrule, mask));
+#endif
 }
 
 static int read_mask (KEYWORD *key, int wordcount, char **words)
@@ -1646,15 +2472,21 @@ static int read_listen (KEYWORD *key, int wordcount, char **words)
 }
 
 #if defined(WITH_ZLIB) || defined(WITH_BZLIB2)
-struct zrule *zrule_test(int type, char *s, struct zrule *root)
+struct zrule *zrule_test(int type, char *s, BINKD_CONFIG *config)
 {
-  struct zrule *ps = root;
+  struct zrule *ps;
+  int i;
 
-  while (ps)
-    if (s == NULL && type == ps->type) return ps;
-    else if (pmatch_ncase(ps->mask, s)) return (type == ps->type ? ps : NULL);
-    else ps = ps->next;
-  return NULL;
+  if (s == NULL)
+  {
+    for (ps = config->zrules.first; ps; ps = ps->next)
+      if (type == ps->type) return ps;
+    return NULL;
+  }
+  if ((i = maskset_next(config->zrules_set, s, 0)) < 0)
+    return NULL;
+  ps = maskset_item(config->zrules_set, i);
+  return (type == ps->type ? ps : NULL);
 }
 
 static int read_zrule (KEYWORD *key, int wordcount, char **words)
@@ -2063,6 +2895,20 @@ void debug_readcfg (void)
       if (i > 0 || *(int *)(k->var) == 0)
         printf("%ds", i);
     }
+    else if (k->callback == read_logcat)
+    {
+      int i;
+
+      for (i = 0; i < LOGC_MAX; i++)
+        if (work_config.logcat[i] >= 0)
+          printf("\n    %s %d", log_categories[i], work_config.logcat[i]);
+    }
+    else if (k->callback == passwords)
+    {
+      printf("\"%s\"", (char *)k->var);
+      if (work_config.passwords[0])
+        printf(", %d entries loaded in %ld.%03ld ms", pwd_loaded, pwd_usec / 1000, pwd_usec % 1000);
+    }
     else if (k->callback == include)
     {
       struct conflist_type *c;
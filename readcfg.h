@@ -19,6 +19,7 @@
 #include "Config.h"
 #include "btypes.h"
 #include "iphdr.h"
+#include "tools.h"
 
 typedef struct _BINKD_CONFIG BINKD_CONFIG;
 
@@ -93,13 +94,18 @@ struct perl_var
 struct _BINKD_CONFIG
 {
   int        usageCount;               /* when it reaches zero, config can be freed */
+  BINKD_CONFIG *base;        /* config sharing all but nodes with this one */
 
   int        nAddr;          /* total addresses defined */
   FTN_ADDR  *pAddr;          /* array of adresses */
 
   int        nNod;           /* number of nodes */
   FTN_NODE   **pNodArray;    /* array of pointers to nodes  */
+  int        nNodAlloc;      /* allocated size of pNodArray */
   int        nNodSorted;     /* internal flag   */
+  FTN_NODE   **pNodHash;     /* open addressing hash of nodes by address */
+  int        nNodHash;       /* size of pNodHash, power of 2 */
+  struct _NODE_SNAP *pNodSnap; /* sorted copy of pNodArray for foreach_node() */
   int        q_present;      /* BSO scan: queue not empty */
 
   char       iport[MAXSERVNAME + 1];
@@ -111,23 +117,37 @@ struct _BINKD_CONFIG
 #endif
   int        nettimeout;
   int        connect_timeout;
+  int        dns_cache_ttl;
+  int        dns_negative_ttl;
   int        rescan_delay;
   int        call_delay;
   int        max_servers;
   int        max_clients;
+  int        reserve_servers;
+  int        accept_rate;
+  int        accept_net_rate;
+#ifdef HAVE_THREADS
+  int        scan_threads;
+  int        listen_shards;
+#endif
+  int        listen_backlog;
   int        kill_dup_partial_files;
   int        kill_old_partial_files;
   int        kill_old_bsy;
   int        minfree;
   int        minfree_nonsecure;
+  int        preallocate;
   int        tries;
   int        hold;
   int        hold_skipped;
+  int        hold_max;
+  int        linger;
   int        backresolv;
   int        send_if_pwd;
   int        debugcfg;
   int        loglevel;
   int        conlog;
+  int        logcat[LOGC_MAX];  /* per category loglevel, -1 = loglevel */
   int        printq;
   int        percents;
   int        tzoff;
@@ -162,6 +182,12 @@ struct _BINKD_CONFIG
   DEFINE_LIST(perl_var)      perl_vars;
 #endif
 
+  /* compiled masks of the lists above */
+  MASKSET   *overwrite_set, *nolog_set, *skipmask_set, *evt_set;
+#if defined(WITH_ZLIB) || defined(WITH_BZLIB2)
+  MASKSET   *zrules_set;
+#endif
+
   /*
    #ifdef HTTPS
    struct simplelistheader  proxylist;
@@ -186,6 +212,10 @@ struct _BINKD_CONFIG
   char       binlogpath[MAXPATHLEN + 1];
   char       fdinhist[MAXPATHLEN + 1];
   char       fdouthist[MAXPATHLEN + 1];
+  char       history[MAXPATHLEN + 1];
+  int        binlog_flush;
+  int        binlog_fsync;
+  char       call_journal[MAXPATHLEN + 1];
   char       pid_file[MAXPATHLEN + 1];
   char       passwords[MAXPATHLEN + 1];
 #ifdef MAILBOX
@@ -263,10 +293,19 @@ void destroy_maskchain(void *p);
 
 int  get_host_and_port (int n, char *host, char **port, char *src, FTN_ADDR *fa, BINKD_CONFIG *config);
 
-char *mask_test(char *s, struct maskchain *chain);
+/*
+ * Returns the number of the first mask in ms (in config order) matching
+ * s case-insensitively, starting from the mask number from; -1 if none
+ */
+int maskset_next(MASKSET *ms, char *s, int from);
+
+/*
+ * Returns the list element of the mask number i
+ */
+void *maskset_item(MASKSET *ms, int i);
 
 #if defined(WITH_ZLIB) || defined(WITH_BZLIB2)
-struct zrule *zrule_test(int type, char *s, struct zrule *root);
+struct zrule *zrule_test(int type, char *s, BINKD_CONFIG *config);
 #endif
 
 #ifdef BW_LIM
@@ -40,4 +40,15 @@
 #include "dos/dirent.h"
 #endif
 
+#include <stdio.h>
+#include <sys/stat.h>
+
+/*
+ * Directory entry helpers (tools.c). They use d_type and the *at()
+ * calls where the system has them and fall back to the full path.
+ */
+int de_stat (DIR *dp, struct dirent *de, char *path, struct stat *st);
+int de_isdir (DIR *dp, struct dirent *de, char *path);
+FILE *de_fopen (DIR *dp, struct dirent *de, char *path);
+
 #endif
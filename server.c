@@ -11,6 +11,9 @@
  *  (at your option) any later version. See COPYING.
  */
 
+#ifdef HAVE_ACCEPT4
+#define _GNU_SOURCE
+#endif
 #include <stdlib.h>
 #include <string.h>
 #ifdef HAVE_SYS_TIME_H
@@ -31,6 +34,7 @@
 #include "iptools.h"
 #include "tools.h"
 #include "protocol.h"
+#include "protoco2.h"
 #include "assert.h"
 #include "setpttl.h"
 #include "sem.h"
@@ -44,6 +48,16 @@ int ext_rand = 0;
 
 SOCKET sockfd[MAX_LISTENSOCK];
 int sockfd_used = 0;
+/* listen address of the socket, kept to reuse the socket after reload */
+static struct listenchain sockfd_listen[MAX_LISTENSOCK];
+static int listen_nshards, listen_backlog;
+
+#if defined(HAVE_THREADS) && defined(SO_REUSEPORT)
+#define LISTEN_SHARDS
+static int sockfd_shard[MAX_LISTENSOCK];   /* acceptor of the socket */
+static volatile int shards_stop;
+static int shards_running;
+#endif
 
 static void serv (void *arg)
 {
@@ -65,7 +79,7 @@ static void serv (void *arg)
   cperl = perl_init_clone(config);
 #endif
   protocol (h, h, NULL, NULL, NULL, NULL, NULL, config);
-  Log (5, "downing server...");
+  Logc (LOGC_NET, 5, "downing server...");
 #if defined(WITH_PERL) && defined(HAVE_THREADS)
   perl_done_clone(cperl);
 #endif
@@ -77,26 +91,444 @@ static void serv (void *arg)
 #ifdef HAVE_THREADS
   threadsafe(--n_servers);
   PostSem(&eothread);
-  ENDTHREAD();
 #elif defined(DOS) || defined(DEBUGCHILD)
   --n_servers;
 #endif
 }
 
 /*
- * Server manager.
+ * Admission control: incoming connection rate per source address and
+ * per network is limited with token buckets (kept as the theoretical
+ * arrival time of the next connection, GCRA)
  */
+#define ADMIT_HASH 1024
 
-static int do_server(BINKD_CONFIG *config)
+typedef struct {
+    unsigned char key[17];      /* kind, address masked by prefix */
+    double tat;
+  } ADMIT_BUCKET;
+
+static ADMIT_BUCKET admit_tab[ADMIT_HASH];
+#if defined(HAVE_THREADS) || defined(AMIGA)
+static MUTEXSEM ASem;
+#endif
+
+void admit_init (void)
+{
+  InitSem (&ASem);
+}
+
+void admit_deinit (void)
+{
+  CleanSem (&ASem);
+}
+
+/*
+ * Finds the bucket for key. Returns NULL if the rate (per minute)
+ * is exceeded
+ */
+static ADMIT_BUCKET *admit_bucket (unsigned char *key, int rate, double now)
+{
+  ADMIT_BUCKET *b;
+  unsigned long h = 2166136261UL;
+  unsigned i;
+
+  for (i = 0; i < sizeof (b->key); i++)
+    h = ((h ^ key[i]) * 16777619UL) & 0xffffffffUL;
+  b = admit_tab + h % ADMIT_HASH;
+  if (memcmp (b->key, key, sizeof (b->key)) || b->tat < now)
+  {
+    memcpy (b->key, key, sizeof (b->key));
+    b->tat = now;
+  }
+  /* allow a burst of rate connections */
+  if (b->tat - now > 60.0 - 60.0 / rate)
+    return NULL;
+  return b;
+}
+
+/*
+ * Returns NULL if the connection may be served, or the reason to
+ * refuse it
+ */
+static char *admit (struct sockaddr *sa, BINKD_CONFIG *config)
+{
+  unsigned char key[17], netkey[17];
+  ADMIT_BUCKET *b = NULL, *nb = NULL;
+  struct timeval tv;
+  double now;
+  char *reason = NULL;
+
+  if (n_servers >= config->max_servers)
+    return "Too many servers";
+  if (config->accept_rate <= 0 && config->accept_net_rate <= 0)
+    return NULL;
+
+  memset (key, 0, sizeof (key));
+  memset (netkey, 0, sizeof (netkey));
+  if (sa->sa_family == AF_INET)
+  {
+    key[0] = 4;
+    memcpy (key + 1, &((struct sockaddr_in *)sa)->sin_addr, 4);
+    memcpy (netkey, key, 4);    /* /24 */
+  }
+#ifdef AF_INET6
+  else if (sa->sa_family == AF_INET6)
+  {
+    unsigned char *a = (unsigned char *)&((struct sockaddr_in6 *)sa)->sin6_addr;
+    static unsigned char v4mapped[12] = {0,0,0,0,0,0,0,0,0,0,0xff,0xff};
+
+    if (memcmp (a, v4mapped, sizeof (v4mapped)) == 0)
+    {
+      key[0] = 4;
+      memcpy (key + 1, a + 12, 4);
+      memcpy (netkey, key, 4);
+    }
+    else
+    {
+      key[0] = 6;
+      memcpy (key + 1, a, 16);
+      memcpy (netkey, key, 9);  /* /64 */
+    }
+  }
+#endif
+  else
+    return NULL;
+  netkey[0] |= 0x80;
+
+  gettvtime (&tv);
+  now = tv.tv_sec + tv.tv_usec / 1000000.0;
+  LockSem (&ASem);
+  if (config->accept_rate > 0 &&
+      (b = admit_bucket (key, config->accept_rate, now)) == NULL)
+    reason = "Too many connections from your address";
+  else if (config->accept_net_rate > 0 &&
+           (nb = admit_bucket (netkey, config->accept_net_rate, now)) == NULL)
+    reason = "Too many connections from your network";
+  else
+  {
+    if (b)
+      b->tat += 60.0 / config->accept_rate;
+    if (nb)
+      nb->tat += 60.0 / config->accept_net_rate;
+  }
+  ReleaseSem (&ASem);
+  return reason;
+}
+
+/*
+ * Sends M_BSY to the just accepted socket, bypassing the session setup
+ */
+static void send_busy (SOCKET s, char *reason)
+{
+  char buf[BLK_HDR_SIZE + 1 + 64];
+  int sz = strlen (reason) + 1;
+
+  buf[0] = (char) (0x80 | (sz >> 8));
+  buf[1] = (char) (sz & 0xff);
+  buf[2] = M_BSY;
+  memcpy (buf + BLK_HDR_SIZE + 1, reason, sz - 1);
+  send (s, buf, BLK_HDR_SIZE + sz, 0);
+}
+
+/*
+ * Accepts a connection on the listen socket ls and starts a server
+ * for it. Returns -1 if the server manager has to stop.
+ */
+static int accept_client (SOCKET ls, int *save_errno)
 {
-  struct addrinfo *ai, *aiHead, hints;
-  int aiErr;
   SOCKET new_sockfd;
   int pid;
   socklen_t client_addr_len;
   struct sockaddr_storage client_addr;
+  char host[BINKD_FQDNLEN + 1];
+  char service[MAXSERVNAME + 1];
+  int aiErr;
+  char *reason;
+  BINKD_CONFIG *config;
+
+  client_addr_len = sizeof (client_addr);
+#ifdef HAVE_ACCEPT4
+  new_sockfd = accept4 (ls, (struct sockaddr *)&client_addr, &client_addr_len,
+                        SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+  new_sockfd = accept (ls, (struct sockaddr *)&client_addr, &client_addr_len);
+#endif
+  if (new_sockfd == INVALID_SOCKET)
+  {
+    *save_errno = TCPERRNO;
+    if (*save_errno == EINVAL || *save_errno == EINTR)
+      return 0;
+    if (!binkd_exit)
+      Logc (LOGC_NET, 1, "servmgr accept(): %s", TCPERR ());
+#ifdef UNIX
+    if (*save_errno == ECONNRESET ||
+        *save_errno == ETIMEDOUT ||
+        *save_errno == ECONNABORTED ||
+        *save_errno == EHOSTUNREACH)
+      return 0;
+#endif
+    return -1;
+  }
+
+  add_socket(new_sockfd);
+  /* Was the socket created after close_sockets loop in exitfunc()? */
+  if (binkd_exit)
+  {
+    del_socket(new_sockfd);
+    soclose(new_sockfd);
+    return 0;
+  }
+  /* never resolve name in here, will be done during session */
+  aiErr = getnameinfo((struct sockaddr *)&client_addr, client_addr_len,
+      host, sizeof(host), service, sizeof(service),
+      NI_NUMERICHOST | NI_NUMERICSERV);
+  if (aiErr != 0)
+  {
+    Logc(LOGC_NET, 2, "Error in getnameinfo(): %s (%d)", gai_strerror(aiErr), aiErr);
+    strcpy (host, "unknown");
+    *service = '\0';
+  }
+
+  config = lock_current_config();
+  reason = admit ((struct sockaddr *)&client_addr, config);
+  unlock_config_structure(config, 0);
+  if (reason)
+  {
+    Logc (LOGC_NET, 3, "incoming from %s refused: %s", host, reason);
+    send_busy (new_sockfd, reason);
+    del_socket(new_sockfd);
+    soclose(new_sockfd);
+    return 0;
+  }
+  rel_grow_handles (6);
+  ext_rand=rand();
+  if (aiErr == 0)
+    Logc (LOGC_NET, 3, "incoming from %s (%s)", host, service);
+  else
+    Logc(LOGC_NET, 3, "incoming from unknown");
+
+  /* Creating a new process for the incoming connection */
+  threadsafe(++n_servers);
+  if ((pid = pool_branch (serv, (void *) &new_sockfd, sizeof (new_sockfd))) < 0)
+  {
+    del_socket(new_sockfd);
+    soclose(new_sockfd);
+    rel_grow_handles (-6);
+    threadsafe(--n_servers);
+    PostSem(&eothread);
+    Logc (LOGC_NET, 1, "servmgr branch(): cannot branch out");
+    sleep(1);
+  }
+  else
+  {
+    if (pid)
+      Logc (LOGC_NET, 5, "started server #%i, id=%i", n_servers, pid);
+    else
+      Logc (LOGC_NET, 5, "started server #%i in pool", n_servers);
+#if defined(HAVE_FORK) && !defined(HAVE_THREADS)
+    soclose (new_sockfd);
+#endif
+  }
+  return 0;
+}
+
+#ifdef LISTEN_SHARDS
+/*
+ * Acceptor thread: serves the listen sockets of its shard. The server
+ * manager itself serves shard 0.
+ */
+static void acceptor (void *arg)
+{
+  int shard = *(int *) arg;
+  int curfd, maxfd, n, save_errno;
+  struct timeval tv;
+  fd_set r;
+
+  free (arg);
+  Logc (LOGC_NET, 5, "acceptor #%i started", shard);
+  while (!shards_stop && !binkd_exit)
+  {
+    FD_ZERO (&r);
+    for (maxfd = curfd = 0; curfd < sockfd_used; curfd++)
+      if (sockfd_shard[curfd] == shard)
+      {
+        FD_SET (sockfd[curfd], &r);
+        if (sockfd[curfd] > maxfd)
+          maxfd = sockfd[curfd];
+      }
+    tv.tv_usec = 0;
+    tv.tv_sec  = 1;
+    if ((n = select (maxfd + 1, &r, NULL, NULL, &tv)) < 0)
+    {
+      if (TCPERRNO == EINTR)
+        continue;
+      if (!shards_stop && !binkd_exit)
+        Logc (LOGC_NET, 1, "acceptor #%i select(): %s", shard, TCPERR ());
+      break;
+    }
+    for (curfd = 0; n > 0 && curfd < sockfd_used; curfd++)
+      if (sockfd_shard[curfd] == shard && FD_ISSET (sockfd[curfd], &r) &&
+          accept_client (sockfd[curfd], &save_errno) < 0)
+      {
+        n = -1;
+        break;
+      }
+    if (n < 0)
+      break;
+  }
+  /* let the server manager handle (or fail on) the sockets left */
+  for (curfd = 0; curfd < sockfd_used; curfd++)
+    if (sockfd_shard[curfd] == shard)
+      sockfd_shard[curfd] = 0;
+  Logc (LOGC_NET, 5, "acceptor #%i finished", shard);
+  threadsafe(--shards_running);
+  ENDTHREAD();
+}
+
+static void shards_down (void)
+{
+  int n;
+
+  shards_stop = 1;
+  for (;;)
+  {
+    threadsafe(n = shards_running);
+    if (n <= 0)
+      break;
+    sleep (1);
+  }
+}
+#endif
+
+static void close_listen (void)
+{
+  int curfd;
+
+#ifdef LISTEN_SHARDS
+  shards_down ();
+#endif
+  for (curfd=0; curfd<sockfd_used; curfd++)
+    soclose(sockfd[curfd]);
+  sockfd_used = 0;
+}
+
+static int listen_eq (struct listenchain *a, struct listenchain *b)
+{
+  return strcmp (a->addr, b->addr) == 0 && strcmp (a->port, b->port) == 0;
+}
+
+/*
+ * Returns 1 if the sockets for lc are open already
+ */
+static int listen_opened (struct listenchain *lc)
+{
+  int curfd;
+
+  for (curfd = 0; curfd < sockfd_used; curfd++)
+    if (listen_eq (sockfd_listen + curfd, lc))
+      return 1;
+  return 0;
+}
+
+/*
+ * Closes the listen sockets of addresses removed from config
+ */
+static void close_removed (BINKD_CONFIG *config)
+{
+  struct listenchain *lc;
+  int curfd, n;
+
+  for (curfd = 0; curfd < sockfd_used; curfd++)
+  {
+    for (lc = config->listen.first; lc; lc = lc->next)
+      if (listen_eq (sockfd_listen + curfd, lc))
+        break;
+    if (lc)
+      continue;
+    if (curfd == 0 || !listen_eq (sockfd_listen + curfd - 1, sockfd_listen + curfd))
+      Logc (LOGC_NET, 3, "servmgr stop listening on %s:%s",
+           sockfd_listen[curfd].addr[0] ? sockfd_listen[curfd].addr : "*",
+           sockfd_listen[curfd].port);
+    soclose (sockfd[curfd]);
+    sockfd[curfd] = INVALID_SOCKET;
+  }
+  for (curfd = n = 0; curfd < sockfd_used; curfd++)
+    if (sockfd[curfd] != INVALID_SOCKET)
+    {
+      sockfd[n] = sockfd[curfd];
+      sockfd_listen[n] = sockfd_listen[curfd];
+#ifdef LISTEN_SHARDS
+      sockfd_shard[n] = sockfd_shard[curfd];
+#endif
+      n++;
+    }
+  sockfd_used = n;
+}
+
+/*
+ * Opens a listen socket for ai
+ */
+static SOCKET open_listen (struct addrinfo *ai, int reuseport, BINKD_CONFIG *config)
+{
+  SOCKET s;
   int opt = 1;
-  int save_errno;
+
+  s = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+  if (s < 0)
+  {
+    Logc(LOGC_NET, 1, "servmgr socket(): %s", TCPERR ());
+    return INVALID_SOCKET;
+  }
+#ifdef UNIX /* Not sure how to set NOINHERIT flag for socket on Windows and OS/2 */
+  if (fcntl(s, F_SETFD, FD_CLOEXEC) != 0)
+    Logc(LOGC_NET, 1, "servmgr fcntl set FD_CLOEXEC error: %s", strerror(errno));
+#endif
+#ifdef IPV6_V6ONLY
+  if (ai->ai_family == PF_INET6)
+  {
+    int v6only = 1;
+    if (setsockopt(s, IPPROTO_IPV6, IPV6_V6ONLY, 
+             (char *) &v6only, sizeof(v6only)) == SOCKET_ERROR)
+      Logc(LOGC_NET, 1, "servmgr setsockopt (IPV6_V6ONLY): %s", TCPERR());
+  }
+#endif
+  if (setsockopt (s, SOL_SOCKET, SO_REUSEADDR,
+                (char *) &opt, sizeof opt) == SOCKET_ERROR)
+    Logc (LOGC_NET, 1, "servmgr setsockopt (SO_REUSEADDR): %s", TCPERR ());
+#ifdef SO_REUSEPORT
+  if (reuseport && setsockopt (s, SOL_SOCKET, SO_REUSEPORT,
+                               (char *) &opt, sizeof opt) == SOCKET_ERROR)
+    Logc (LOGC_NET, 1, "servmgr setsockopt (SO_REUSEPORT): %s", TCPERR ());
+#else
+  UNUSED_ARG(reuseport);
+#endif
+
+  if (bind (s, ai->ai_addr, ai->ai_addrlen) != 0)
+  {
+    Logc(LOGC_NET, 1, "servmgr bind(): %s", TCPERR ());
+    soclose(s);
+    return INVALID_SOCKET;
+  }
+  if (listen (s, config->listen_backlog > 0 ? config->listen_backlog : SOMAXCONN) != 0)
+  {
+    Logc(LOGC_NET, 1, "servmgr listen(): %s", TCPERR ());
+    soclose(s);
+    return INVALID_SOCKET;
+  }
+  return s;
+}
+
+/*
+ * Server manager.
+ */
+
+static int do_server(BINKD_CONFIG *config)
+{
+  struct addrinfo *ai, *aiHead, hints;
+  int aiErr;
+  int save_errno = 0;
+  int shard, nshards = 1, curfd;
   struct listenchain *listen_list;
 
   /* setup hints for getaddrinfo */
@@ -106,78 +538,109 @@ static int do_server(BINKD_CONFIG *config)
   hints.ai_socktype = SOCK_STREAM;
   hints.ai_protocol = IPPROTO_TCP;
 
+#ifdef HAVE_THREADS
+  if (config->listen_shards > 1)
+  {
+#ifdef LISTEN_SHARDS
+    nshards = config->listen_shards;
+#else
+    Logc (LOGC_NET, 2, "listen-shards: SO_REUSEPORT is not supported, ignored");
+#endif
+  }
+#endif
+  pool_resize ((server_flag ? config->max_servers : 0) +
+               (client_flag && !poll_flag ? config->max_clients : 0));
+
+  /* Reload: keep the sockets of unchanged listen addresses open, so no
+   * incoming call is refused while the new config takes over */
+#ifdef LISTEN_SHARDS
+  shards_down ();
+#endif
+  if (nshards != listen_nshards)
+    close_listen ();
+  else
+    close_removed (config);
+  listen_nshards = nshards;
+  if (sockfd_used && config->listen_backlog != listen_backlog)
+    for (curfd = 0; curfd < sockfd_used; curfd++)
+      listen (sockfd[curfd], config->listen_backlog > 0 ? config->listen_backlog : SOMAXCONN);
+  listen_backlog = config->listen_backlog;
+
   for (listen_list = config->listen.first; listen_list; listen_list = listen_list->next)
   {
+    if (listen_opened (listen_list))
+      continue;
     if ((aiErr = getaddrinfo(listen_list->addr[0] ? listen_list->addr : NULL, 
                              listen_list->port, &hints, &aiHead)) != 0)
     {
-      Log(1, "servmgr getaddrinfo: %s (%d)", gai_strerror(aiErr), aiErr);
+      Logc(LOGC_NET, 1, "servmgr getaddrinfo: %s (%d)", gai_strerror(aiErr), aiErr);
       return -1;
     }
 
     for (ai = aiHead; ai != NULL && sockfd_used < MAX_LISTENSOCK; ai = ai->ai_next)
-    {
-      sockfd[sockfd_used] = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
-      if (sockfd[sockfd_used] < 0)
+      for (shard = 0; shard < nshards && sockfd_used < MAX_LISTENSOCK; shard++)
       {
-        Log(1, "servmgr socket(): %s", TCPERR ());
-        return -1;
-      }
-#ifdef UNIX /* Not sure how to set NOINHERIT flag for socket on Windows and OS/2 */
-      if (fcntl(sockfd[sockfd_used], F_SETFD, FD_CLOEXEC) != 0)
-        Log(1, "servmgr fcntl set FD_CLOEXEC error: %s", strerror(errno));
-#endif
-#ifdef IPV6_V6ONLY
-      if (ai->ai_family == PF_INET6)
-      {
-        int v6only = 1;
-        if (setsockopt(sockfd[sockfd_used], IPPROTO_IPV6, IPV6_V6ONLY, 
-                 (char *) &v6only, sizeof(v6only)) == SOCKET_ERROR)
-          Log(1, "servmgr setsockopt (IPV6_V6ONLY): %s", TCPERR());
-      }
-#endif
-      if (setsockopt (sockfd[sockfd_used], SOL_SOCKET, SO_REUSEADDR,
-                    (char *) &opt, sizeof opt) == SOCKET_ERROR)
-        Log (1, "servmgr setsockopt (SO_REUSEADDR): %s", TCPERR ());
-    
-      if (bind (sockfd[sockfd_used], ai->ai_addr, ai->ai_addrlen) != 0)
-      {
-        Log(1, "servmgr bind(): %s", TCPERR ());
-        soclose(sockfd[sockfd_used]);
-        return -1;
-      }
-      if (listen (sockfd[sockfd_used], 5) != 0)
-      {
-        Log(1, "servmgr listen(): %s", TCPERR ());
-        soclose(sockfd[sockfd_used]);
-        return -1;
+        if ((sockfd[sockfd_used] = open_listen (ai, nshards > 1, config)) == INVALID_SOCKET)
+        {
+          freeaddrinfo(aiHead);
+          return -1;
+        }
+        sockfd_listen[sockfd_used] = *listen_list;
+        sockfd_used++;
       }
 
-      sockfd_used++;
-    }
-
-    Log (3, "servmgr listen on %s:%s", listen_list->addr[0] ? listen_list->addr : "*", listen_list->port);
+    Logc (LOGC_NET, 3, "servmgr listen on %s:%s", listen_list->addr[0] ? listen_list->addr : "*", listen_list->port);
   
     freeaddrinfo(aiHead);
   }
 
   if (sockfd_used == 0) {
-    Log(1, "servmgr: No listen socket open");
+    Logc(LOGC_NET, 1, "servmgr: No listen socket open");
     return -1;
   }
 
+#ifdef LISTEN_SHARDS
+  /* (Re)assign the shards: the sockets of an address are opened one per
+   * shard in turn, the ones kept from the previous config included (an
+   * acceptor which gave up has moved its sockets to shard 0) */
+  for (curfd = shard = 0; curfd < sockfd_used; curfd++)
+  {
+    if (curfd == 0 || !listen_eq (sockfd_listen + curfd - 1, sockfd_listen + curfd))
+      shard = 0;
+    sockfd_shard[curfd] = shard;
+    shard = (shard + 1) % nshards;
+  }
+  shards_stop = 0;
+  for (shard = 1; shard < nshards; shard++)
+  {
+    threadsafe(++shards_running);
+    if (branch (acceptor, &shard, sizeof (shard)) < 0)
+    {
+      threadsafe(--shards_running);
+      Logc (LOGC_NET, 1, "servmgr branch(): cannot start acceptor #%i", shard);
+      for (curfd = 0; curfd < sockfd_used; curfd++)
+        if (sockfd_shard[curfd] == shard)
+          sockfd_shard[curfd] = 0;
+    }
+  }
+#endif
+
   setproctitle ("server manager (listen %s)", config->listen.first->port);
 
   for (;;)
   {
     struct timeval tv;
     int n;
-    int curfd, maxfd = 0;
+    int maxfd = 0;
     fd_set r;
 
     FD_ZERO (&r);
     for (curfd=0; curfd<sockfd_used; curfd++)
     {
+#ifdef LISTEN_SHARDS
+      if (sockfd_shard[curfd])
+        continue;
+#endif
       FD_SET (sockfd[curfd], &r);
       if (sockfd[curfd] > maxfd)
         maxfd = sockfd[curfd];
@@ -191,12 +654,7 @@ static int do_server(BINKD_CONFIG *config)
     switch (n)
     { case 0: /* timeout */
         if (checkcfg()) 
-        {
-          for (curfd=0; curfd<sockfd_used; curfd++)
-            soclose(sockfd[curfd]);
-          sockfd_used = 0;
           return 0;
-        }
         unblocksig();
         check_child(&n_servers);
         blocksig();
@@ -211,98 +669,38 @@ static int do_server(BINKD_CONFIG *config)
           check_child(&n_servers);
           blocksig();
           if (checkcfg())
-          {
-            for (curfd=0; curfd<sockfd_used; curfd++)
-              soclose(sockfd[curfd]);
-            sockfd_used = 0;
             return 0;
-          }
           continue;
         }
-        Log (1, "servmgr select(): %s", TCPERR ());
+        Logc (LOGC_NET, 1, "servmgr select(): %s", TCPERR ());
         goto accepterr;
     }
  
     for (curfd=0; curfd<sockfd_used; curfd++)
     {
-      if (!FD_ISSET(sockfd[curfd], &r))
+#ifdef LISTEN_SHARDS
+      if (sockfd_shard[curfd])
         continue;
+#endif
+      if (FD_ISSET(sockfd[curfd], &r) &&
+          accept_client (sockfd[curfd], &save_errno) < 0)
+        goto accepterr;
+    }
+  }
 
-      client_addr_len = sizeof (client_addr);
-      if ((new_sockfd = accept (sockfd[curfd], (struct sockaddr *)&client_addr,
-                                &client_addr_len)) == INVALID_SOCKET)
-      {
-        save_errno = TCPERRNO;
-        if (save_errno != EINVAL && save_errno != EINTR)
-        {
-          if (!binkd_exit)
-            Log (1, "servmgr accept(): %s", TCPERR ());
-#ifdef UNIX
-          if (save_errno == ECONNRESET ||
-              save_errno == ETIMEDOUT ||
-              save_errno == ECONNABORTED ||
-              save_errno == EHOSTUNREACH)
-            continue;
+accepterr:
+#ifdef LISTEN_SHARDS
+  shards_down ();
 #endif
-        accepterr:
 #ifdef OS2
-          /* Buggy external process closed our socket? Or OS/2 bug? */
-          if (save_errno == ENOTSOCK)
-            return 0;  /* will force socket re-creation */
-#endif
-          return -1;
-        }
-      }
-      else
-      {
-        char host[BINKD_FQDNLEN + 1];
-        char service[MAXSERVNAME + 1];
-        int aiErr;
-  
-        add_socket(new_sockfd);
-        /* Was the socket created after close_sockets loop in exitfunc()? */
-        if (binkd_exit)
-        {
-          del_socket(new_sockfd);
-          soclose(new_sockfd);
-          continue;
-        }
-        rel_grow_handles (6);
-        ext_rand=rand();
-        /* never resolve name in here, will be done during session */
-        aiErr = getnameinfo((struct sockaddr *)&client_addr, client_addr_len,
-            host, sizeof(host), service, sizeof(service),
-            NI_NUMERICHOST | NI_NUMERICSERV);
-        if (aiErr == 0) 
-          Log (3, "incoming from %s (%s)", host, service);
-        else
-        {
-          Log(2, "Error in getnameinfo(): %s (%d)", gai_strerror(aiErr), aiErr);
-          Log(3, "incoming from unknown");
-        }
-  
-        /* Creating a new process for the incoming connection */
-        threadsafe(++n_servers);
-        if ((pid = branch (serv, (void *) &new_sockfd, sizeof (new_sockfd))) < 0)
-        {
-          del_socket(new_sockfd);
-          soclose(new_sockfd);
-          rel_grow_handles (-6);
-          threadsafe(--n_servers);
-          PostSem(&eothread);
-          Log (1, "servmgr branch(): cannot branch out");
-          sleep(1);
-        }
-        else
-        {
-          Log (5, "started server #%i, id=%i", n_servers, pid);
-#if defined(HAVE_FORK) && !defined(HAVE_THREADS)
-          soclose (new_sockfd);
-#endif
-        }
-      }
-    }
+  /* Buggy external process closed our socket? Or OS/2 bug? */
+  if (save_errno == ENOTSOCK)
+  {
+    close_listen ();
+    return 0;  /* will force socket re-creation */
   }
+#endif
+  return -1;
 }
 
 void servmgr (void)
@@ -312,7 +710,7 @@ void servmgr (void)
 
   srand(time(0));
   setproctitle ("server manager");
-  Log (4, "servmgr started");
+  Logc (LOGC_NET, 4, "servmgr started");
 
 #if defined(HAVE_FORK) && !defined(HAVE_THREADS)
   blocksig();
@@ -328,7 +726,7 @@ void servmgr (void)
     status = do_server(config);
     unlock_config_structure(config, 0);
   } while (status == 0 && !binkd_exit);
-  Log(4, "downing servmgr...");
+  Logc(LOGC_NET, 4, "downing servmgr...");
   pidsmgr = 0;
   PostSem(&eothread);
 }
@@ -1,7 +1,7 @@
 #ifndef _servmgr_h
 #define _servmgr_h
 
-#define MAX_LISTENSOCK 16
+#define MAX_LISTENSOCK 64
 
 extern SOCKET sockfd[MAX_LISTENSOCK];
 extern int sockfd_used;
@@ -11,6 +11,12 @@ extern int sockfd_used;
  */
 void servmgr(void);
 
+/*
+ * Init and deinit for the admission control of incoming connections
+ */
+void admit_init(void);
+void admit_deinit(void);
+
 extern int ext_rand;
 
 #endif
@@ -45,31 +45,29 @@ static EVTQ *evt_queue(EVTQ *eq, char evt_type, char *path)
 /*
  * Tests if filename matches any of EVT_FLAG's patterns.
  */
-int evt_test (EVTQ **eq, char *filename, EVT_FLAG *evt_flags)
+int evt_test (EVTQ **eq, char *filename, MASKSET *evt_set)
 {
   EVT_FLAG *curr;
-  int rc=0;
+  int rc=0, i;
 
-  for (curr = evt_flags; curr; curr = curr->next)
+  for (i = 0; (i = maskset_next (evt_set, filename, i)) >= 0; i++)
   {
-    if (pmatch_ncase(curr->pattern, filename))
+    curr = maskset_item (evt_set, i);
+    if (curr->path)
     {
-      if (curr->path)
+      Log (4, "got %s, %screating %s", curr->pattern, curr->imm ? "" : "delayed ", curr->path);
+      if (curr->imm)
       {
-	Log (4, "got %s, %screating %s", curr->pattern, curr->imm ? "" : "delayed ", curr->path);
-	if (curr->imm)
-	{
-	  if (create_empty_sem_file (curr->path) == 0)
-	    touch (curr->path, time(NULL));
-	}
-	else
-	  *eq = evt_queue(*eq, 'f', curr->path);
-      }
-      else if (curr->command)
-      {
-	Log (4, "got %s, %sstarting %s", curr->pattern, curr->imm ? "" : "delayed ", curr->command);
-	rc=1;
+	if (create_empty_sem_file (curr->path) == 0)
+	  touch (curr->path, time(NULL));
       }
+      else
+	*eq = evt_queue(*eq, 'f', curr->path);
+    }
+    else if (curr->command)
+    {
+      Log (4, "got %s, %sstarting %s", curr->pattern, curr->imm ? "" : "delayed ", curr->command);
+      rc=1;
     }
   }
   return rc;
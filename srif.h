@@ -27,7 +27,7 @@ struct _EVT_FLAG
 /*
  * Tests if filename matches any of EVT_FLAG's patterns.
  */
-int evt_test (EVTQ **eq, char *filename, EVT_FLAG *evt_flags);
+int evt_test (EVTQ **eq, char *filename, MASKSET *evt_set);
 
 /*
  * Runs external programs using S.R.I.F. interface
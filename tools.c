@@ -42,10 +42,15 @@
  * We can call Log() even when we have no config ready. So, we must keep
  * internal variables which will be updated when config is loaded
  */
-static int  current_loglevel = 1;
 static int  current_conlog   = 1;
 static char *current_logpath; /* This is malloc'ed string and can be NULL */
-static struct maskchain *current_nolog = NULL;
+static MASKSET *current_nolog = NULL;
+static int  current_catlevel[LOGC_MAX] = { 1, 1, 1, 1, 1, 1 };
+static int  log_hooked;       /* perl on_log() may change the level */
+
+const char *log_categories[LOGC_MAX] =
+  { "main", "proto", "queue", "inbound", "net", "perl" };
+int log_max[LOGC_MAX] = { 1, 1, 1, 1, 1, 1 };
 
 /*
  * Lowercase the string
@@ -270,19 +275,254 @@ struct tm *safe_localtime(time_t *t, struct tm *tm)
 #endif
 #endif
 
-void InitLog(int loglevel, int conlog, char *logpath, void *first)
+#ifdef UNIX
+/*
+ * The log file is kept open. It is reopened when InitLog() is called
+ * (on config reload and SIGHUP), when the file is renamed or deleted
+ * (logrotate), and after a write error.
+ */
+static int    logfd = -1;
+static char  *logfd_path;               /* the file logfd is opened for */
+static time_t logfd_checked;            /* last rename check */
+static int    logfd_reopen;
+
+/*
+ * Writes to the log file. Must be called with lsem locked, or with logio
+ * locked when the writer thread is running.
+ */
+static void log_write (const char *path, const char *s, size_t len)
+{
+  struct stat sp, sf;
+  time_t now = time(NULL);
+  int i;
+
+  for (i = 0; i < 2; i++)
+  {
+    if (logfd != -1 && !logfd_reopen && !strcmp(logfd_path, path))
+    {
+      if (now == logfd_checked ||
+          (stat(path, &sp) == 0 && fstat(logfd, &sf) == 0 &&
+           sp.st_ino == sf.st_ino && sp.st_dev == sf.st_dev))
+      {
+        logfd_checked = now;
+        if (write(logfd, s, len) == (int) len)
+          return;
+      }
+    }
+    /* (re)open */
+    if (logfd != -1)
+      close(logfd);
+    xfree(logfd_path);
+    logfd_path = xstrdup(path);
+    logfd_reopen = 0;
+    logfd_checked = now;
+    if ((logfd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0666)) == -1)
+      break;
+    fcntl(logfd, F_SETFD, FD_CLOEXEC);
+  }
+  fprintf (stderr, "Cannot write %s: %s!\n", path, strerror (errno));
+}
+
+#ifdef HAVE_THREADS
+/*
+ * Threaded builds queue the lines into a ring buffer. A writer thread
+ * writes it out with one write() per batch. logio is held while the
+ * batch is written, so a caller which finds the ring full can wait
+ * for it and write directly without reordering the lines.
+ */
+#define LOGRING_SIZE 65536
+
+static char     logring[LOGRING_SIZE], logout[LOGRING_SIZE];
+static size_t   logring_len;
+static int      log_writer;             /* 1 running, 2 stopped */
+static MUTEXSEM logio;
+static EVENTSEM logwake;
+
+static void log_thread (void *arg)
+{
+  char path[MAXPATHLEN + 1], *p;
+  size_t n;
+  int stop;
+
+  UNUSED_ARG(arg);
+  for (;;)
+  {
+    LockSem(&logio);
+    LockSem(&lsem);
+    n = logring_len;
+    memcpy(logout, logring, n);
+    logring_len = 0;
+    stop = log_writer != 1;
+    p = (current_logpath && *current_logpath) ? current_logpath : getenv(BINKD_LOGPATH_ENVIRON);
+    strnzcpy(path, p ? p : "", sizeof(path));
+    ReleaseSem(&lsem);
+    if (n && path[0])
+      log_write(path, logout, n);
+    ReleaseSem(&logio);
+    if (stop)
+      break;
+    if (n == 0)
+      WaitSem(&logwake, 1);
+  }
+}
+
+/*
+ * Writes the queued lines out. Must be called with logio and lsem locked.
+ */
+static void log_drain (void)
+{
+  char *path = (current_logpath && *current_logpath) ? current_logpath :
+               getenv(BINKD_LOGPATH_ENVIRON);
+
+  if (logring_len && path)
+    log_write(path, logring, logring_len);
+  logring_len = 0;
+}
+#endif
+#endif
+
+/*
+ * Starts the log writer thread. Call it after daemonizing.
+ */
+void log_start (void)
+{
+#if defined(UNIX) && defined(HAVE_THREADS)
+  if (log_writer)
+    return;
+  InitSem(&logio);
+  InitEventSem(&logwake);
+  log_writer = 1;
+  if (branch(log_thread, NULL, 0) < 0)
+  {
+    LockSem(&lsem);
+    log_writer = 0;
+    log_drain();
+    ReleaseSem(&lsem);
+  }
+#endif
+}
+
+/*
+ * Stops queueing and writes the queue out, call it on exit
+ */
+void log_stop (void)
+{
+#if defined(UNIX) && defined(HAVE_THREADS)
+  if (log_writer != 1)
+    return;
+  LockSem(&logio);
+  LockSem(&lsem);
+  log_writer = 2;
+  log_drain();
+  ReleaseSem(&lsem);
+  ReleaseSem(&logio);
+  PostSem(&logwake);
+#endif
+}
+
+static void log_file (const char *path, const char *s, size_t len)
+{
+#ifdef UNIX
+  LockSem(&lsem);
+#ifdef HAVE_THREADS
+  if (log_writer == 1)
+  {
+    int wake;
+
+    if (logring_len + len <= sizeof(logring))
+    {
+      wake = logring_len == 0;
+      memcpy(logring + logring_len, s, len);
+      logring_len += len;
+      ReleaseSem(&lsem);
+      if (wake)
+        PostSem(&logwake);
+      return;
+    }
+    /* the ring is full, wait for the writer and write directly */
+    ReleaseSem(&lsem);
+    LockSem(&logio);
+    LockSem(&lsem);
+    log_drain();
+    log_write(path, s, len);
+    ReleaseSem(&lsem);
+    ReleaseSem(&logio);
+    return;
+  }
+#endif
+  log_write(path, s, len);
+  ReleaseSem(&lsem);
+#else
+  FILE *logfile = 0;
+  int i;
+
+  LockSem(&lsem);
+  for (i = 0; logfile == 0 && i < 10; ++i)
+    logfile = fopen (path, "a");
+  if (logfile)
+  {
+    fwrite (s, len, 1, logfile);
+    fclose (logfile);
+  }
+  else
+    fprintf (stderr, "Cannot open %s: %s!\n", path, strerror (errno));
+  ReleaseSem(&lsem);
+#endif
+}
+
+static void log_max_update (void)
 {
+  int i;
+
+  for (i = 0; i < LOGC_MAX; i++)
+    log_max[i] = log_hooked ? 0x7fff : max (max (current_catlevel[i], current_conlog), 0);
+}
+
+/*
+ * Called when a perl on_log() hook is loaded. The hook may change the
+ * level, so any message can get to the log.
+ */
+void log_hook (void)
+{
+  log_hooked = 1;
+  log_max_update ();
+}
+
+void InitLog(int loglevel, int conlog, char *logpath, void *first, int *logcat)
+{
+  int i;
+
+#if defined(UNIX) && defined(HAVE_THREADS)
+  if (log_writer == 1)
+  { /* queued lines go to the old file */
+    LockSem(&logio);
+    LockSem(&lsem);
+    log_drain();
+    ReleaseSem(&lsem);
+    ReleaseSem(&logio);
+  }
+#endif
   LockSem(&lsem);
+#ifdef UNIX
+  logfd_reopen = 1;
+#endif
   xfree(current_logpath);
   current_logpath  = NULL;   /* just in case if xstrdup() fails */
-  current_loglevel = loglevel;
   current_conlog   = conlog;
   current_logpath  = xstrdup(logpath);
-  current_nolog    = (struct maskchain *)first;
+  current_nolog    = (MASKSET *)first;
+  for (i = 0; i < LOGC_MAX; i++)
+    current_catlevel[i] = (logcat && logcat[i] >= 0) ? logcat[i] : loglevel;
+  log_max_update ();
   ReleaseSem(&lsem);
 }
 
 void vLog (int lev, char *s, va_list ap)
+{
+  vLogc (LOGC_MAIN, lev, s, ap);
+}
+
+void vLogc (int cat, int lev, char *s, va_list ap)
 {
   static int first_time = 1;
   static const char *month[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
@@ -290,6 +530,8 @@ void vLog (int lev, char *s, va_list ap)
   char buf[1024];
   int ok = 1;
 
+  if (lev > log_max[cat])
+    return;
   /* make string in buffer */
   vsnprintf(buf, sizeof(buf), s, ap);
   /* do perl hooks */
@@ -297,7 +539,7 @@ void vLog (int lev, char *s, va_list ap)
   if (!perl_on_log(buf, sizeof(buf), &lev)) ok = 0;
 #endif
   /* match against nolog */
-  if (mask_test(buf, current_nolog) != NULL ) ok = 0;
+  if (maskset_next(current_nolog, buf, 0) >= 0) ok = 0;
   /* log output */
   if (ok)
   { /* if (ok) */
@@ -323,26 +565,19 @@ void vLog (int lev, char *s, va_list ap)
 
     using_logpath = (current_logpath && *current_logpath) ?
                                  current_logpath : getenv(BINKD_LOGPATH_ENVIRON);
-    if (lev <= current_loglevel && using_logpath)
+    if (lev <= current_catlevel[cat] && using_logpath)
     {
-      FILE *logfile = 0;
-      int i;
-
-      LockSem(&lsem);
-      for (i = 0; logfile == 0 && i < 10; ++i)
-        logfile = fopen (using_logpath, "a");
-      if (logfile)
-      {
-        fprintf (logfile, "%s%c %02d %s %02d:%02d:%02d [%u] %s\n",
-               first_time ? "\n" : "", ch,
-               tm.tm_mday, month[tm.tm_mon], tm.tm_hour, tm.tm_min, tm.tm_sec,
-               (unsigned) PID (), buf);
-        fclose (logfile);
-        first_time = 0;
-      }
-      else
-        fprintf (stderr, "Cannot open %s: %s!\n", using_logpath, strerror (errno));
-      ReleaseSem(&lsem);
+      char line[sizeof(buf) + 64];
+      int n;
+
+      n = snprintf (line, sizeof(line), "%s%c %02d %s %02d:%02d:%02d [%u] %s\n",
+             first_time ? "\n" : "", ch,
+             tm.tm_mday, month[tm.tm_mon], tm.tm_hour, tm.tm_min, tm.tm_sec,
+             (unsigned) PID (), buf);
+      if (n < 0 || n >= (int) sizeof(line))
+        n = sizeof(line) - 1;
+      first_time = 0;
+      log_file (using_logpath, line, n);
     }
 #ifdef WIN32
 #ifdef BINKD9X
@@ -354,7 +589,7 @@ void vLog (int lev, char *s, va_list ap)
 #endif
 
 #if defined (HAVE_VSYSLOG) && defined (HAVE_FACILITYNAMES)
-    if (lev <= current_loglevel && syslog_facility >= 0)
+    if (lev <= current_catlevel[cat] && syslog_facility >= 0)
     {
       static int opened = 0;
       static int log_levels[] =
@@ -399,8 +634,21 @@ void Log (int lev, char *s, ...)
 {
   va_list ap;
 
+  if (lev > log_max[LOGC_MAIN])
+    return;
+  va_start(ap, s);
+  vLogc(LOGC_MAIN, lev, s, ap);
+  va_end(ap);
+}
+
+void Logc (int cat, int lev, char *s, ...)
+{
+  va_list ap;
+
+  if (lev > log_max[cat])
+    return;
   va_start(ap, s);
-  vLog(lev, s, ap);
+  vLogc(cat, lev, s, ap);
   va_end(ap);
 }
 
@@ -605,6 +853,65 @@ int touch (char *file, time_t t)
 #endif
 }
 
+/*
+ * Stats a directory entry returned by readdir(dp). path is the full
+ * name of the entry, used where stat() relative to dp is not available.
+ * 0 == success, -1 == error
+ */
+int de_stat (DIR *dp, struct dirent *de, char *path, struct stat *st)
+{
+#ifdef AT_FDCWD
+  UNUSED_ARG(path);
+  return fstatat (dirfd (dp), de->d_name, st, 0);
+#else
+  UNUSED_ARG(dp);
+  UNUSED_ARG(de);
+  return stat (path, st);
+#endif
+}
+
+/*
+ * Is the directory entry a directory? Trusts d_type if the file system
+ * filled it, so no stat() is done in most cases.
+ * 1 == directory, 0 == not a directory, -1 == error
+ */
+int de_isdir (DIR *dp, struct dirent *de, char *path)
+{
+  struct stat st;
+
+#if defined(DT_DIR) && defined(DT_REG)
+  if (de->d_type == DT_DIR)
+    return 1;
+  if (de->d_type == DT_REG)
+    return 0;
+#endif
+  if (de_stat (dp, de, path, &st) != 0)
+    return -1;
+  return (st.st_mode & S_IFDIR) ? 1 : 0;
+}
+
+/*
+ * Opens a directory entry for reading, relative to dp if possible.
+ */
+FILE *de_fopen (DIR *dp, struct dirent *de, char *path)
+{
+#ifdef AT_FDCWD
+  int h;
+  FILE *f;
+
+  UNUSED_ARG(path);
+  if ((h = openat (dirfd (dp), de->d_name, O_RDONLY)) == -1)
+    return NULL;
+  if ((f = fdopen (h, "r")) == NULL)
+    close (h);
+  return f;
+#else
+  UNUSED_ARG(dp);
+  UNUSED_ARG(de);
+  return fopen (path, "r");
+#endif
+}
+
 /*
  * Replaces all entries of a in s for b, returns edited line.
  * Returned value must be free()'d. Ignores case.
@@ -34,9 +34,36 @@
 #define max(x,y) ((x) > (y) ? (x) : (y))
 #endif
 
+/*
+ * Log categories, see log-category keyword
+ */
+#define LOGC_MAIN    0
+#define LOGC_PROTO   1
+#define LOGC_QUEUE   2
+#define LOGC_INBOUND 3
+#define LOGC_NET     4
+#define LOGC_PERL    5
+#define LOGC_MAX     6
+
+extern const char *log_categories[LOGC_MAX];
+
+/*
+ * The highest level which can get to any log of the category. Debug
+ * messages in hot paths check it before the call, so their arguments
+ * are not even evaluated:
+ *   if (LogOn (LOGC_PROTO, 9)) Logc (LOGC_PROTO, 9, "Read %i bytes", no);
+ */
+extern int log_max[LOGC_MAX];
+#define LogOn(cat, lev) ((lev) <= log_max[cat])
+
 void vLog (int lev, char *s, va_list ap);
+void vLogc (int cat, int lev, char *s, va_list ap);
 void Log (int lev, char *s, ...);
-void InitLog(int loglevel, int conlog, char *logpath, void *first);
+void Logc (int cat, int lev, char *s, ...);
+void InitLog(int loglevel, int conlog, char *logpath, void *first, int *logcat);
+void log_hook (void);
+void log_start (void);
+void log_stop (void);
 
 #define LOGINT(v) Log(6, "%s=%i\n", #v, (int)(v))
 